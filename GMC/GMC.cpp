@@ -9,9 +9,18 @@ See the README file in the top-level RNMC directory.
 
 #include "sql_types.h"
 #include "linear_solver.h"
+#include "tree_solver.h"
+#include "sparse_solver.h"
+#include "composition_rejection_solver.h"
+#include "next_reaction_solver.h"
+#include "wide_tree_solver.h"
+#include "partial_propensity_solver.h"
 #include "../core/dispatcher.h"
 #include "../core/reaction_network_simulation.h"
 #include "../core/energy_reaction_network_simulation.h"
+#include "../core/partial_propensity_simulation.h"
+#include "../core/tau_leaping_simulation.h"
+#include "../core/slow_scale_simulation.h"
 
 void print_usage()
 {
@@ -23,15 +32,283 @@ void print_usage()
               << "--thread_count\n"
               << "--step_cutoff|time_cutoff\n"
               << "--energy_budget\n"
-              << "--checkpoint\n";
+              << "--checkpoint\n"
+              << "--solver=linear|tree|wide_tree|sparse|composition_rejection|next_reaction|partial_propensity|auto (optional)\n"
+              << "--history_chunk_size (optional)\n"
+              << "--max_history_mb (optional)\n"
+              << "--journal_mode=delete|truncate|persist|memory|wal|off (optional)\n"
+              << "--synchronous=off|normal|full|extra (optional)\n"
+              << "--output_format=sqlite|binary (optional)\n"
+              << "--max_dependency_graph_mb (optional)\n"
+              << "--tau_leaping=epsilon (optional)\n"
+              << "--slow_scale=ratio (optional)\n"
+              << "--model_cache=path (optional)\n"
+              << "--rng=gsl|philox (optional)\n";
 } // print_usage()
 
 /* ---------------------------------------------------------------------- */
 
+enum SolverType
+{
+    default_solver,
+    linear_solver,
+    tree_solver,
+    wide_tree_solver,
+    sparse_solver,
+    composition_rejection_solver,
+    next_reaction_solver,
+    partial_propensity_solver,
+    auto_solver
+};
+
+// networks with at most this many reactions are cheap enough to scan
+// linearly on every step
+constexpr unsigned long int linear_solver_max_reactions = 1024;
+
+// if at most this fraction of the initial propensities are non-zero, the
+// sparse solver only ever touches a small part of the network
+constexpr double sparse_solver_max_active_fraction = 0.01;
+
+/* ---------------------------------------------------------------------- */
+
+SolverType parse_solver_type(char *name)
+{
+    std::string solver_name(name);
+
+    if (solver_name == "linear")
+        return linear_solver;
+    else if (solver_name == "tree")
+        return tree_solver;
+    else if (solver_name == "wide_tree")
+        return wide_tree_solver;
+    else if (solver_name == "sparse")
+        return sparse_solver;
+    else if (solver_name == "composition_rejection")
+        return composition_rejection_solver;
+    else if (solver_name == "next_reaction")
+        return next_reaction_solver;
+    else if (solver_name == "partial_propensity")
+        return partial_propensity_solver;
+    else if (solver_name == "auto")
+        return auto_solver;
+
+    std::cerr << "unknown solver " << solver_name << '\n';
+    print_usage();
+    exit(EXIT_FAILURE);
+} // parse_solver_type()
+
+/* ---------------------------------------------------------------------- */
+
+// pick a solver from the shape of the network: the number of reactions
+// and the fraction of reactions which can fire from the initial state.
+// Large networks with many active reactions use composition-rejection,
+// whose cost doesn't grow with the number of reactions.
+SolverType choose_solver_type(std::vector<double> &initial_propensities)
+{
+    unsigned long int number_of_reactions = initial_propensities.size();
+    unsigned long int number_of_active_reactions = 0;
+    for (double propensity : initial_propensities)
+    {
+        if (propensity > 0.0)
+            number_of_active_reactions++;
+    }
+
+    SolverType solver_type;
+    if (number_of_reactions <= linear_solver_max_reactions)
+        solver_type = linear_solver;
+    else if (number_of_active_reactions <=
+             sparse_solver_max_active_fraction * number_of_reactions)
+        solver_type = sparse_solver;
+    else
+        solver_type = composition_rejection_solver;
+
+    std::cerr << time::time_stamp()
+              << number_of_active_reactions << " of "
+              << number_of_reactions
+              << " reactions are initially active, using the "
+              << (solver_type == linear_solver ? "linear"
+                  : solver_type == sparse_solver ? "sparse"
+                                                  : "composition rejection")
+              << " solver\n";
+
+    return solver_type;
+} // choose_solver_type()
+
+/* ---------------------------------------------------------------------- */
+
+// older databases have no count column in their trajectories table.
+// It is added with a default of 1, which is what every exact row means.
+void add_count_column(SqlConnection &initial_state_database)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(initial_state_database.connection,
+                                "SELECT count FROM trajectories LIMIT 0;",
+                                -1, &stmt, nullptr);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_OK)
+        initial_state_database.exec(
+            "ALTER TABLE trajectories ADD COLUMN count INTEGER NOT NULL DEFAULT 1;");
+} // add_count_column()
+
+/* ---------------------------------------------------------------------- */
+
+template <typename Solver>
+void run_tau_leaping_reaction_network(
+    SqlConnection &&reaction_network_database,
+    SqlConnection &&initial_state_database,
+    GillespieReactionNetwork &&model,
+    int number_of_simulations,
+    int base_seed,
+    int thread_count,
+    Cutoff cutoff,
+    HistoryParameters history_parameters)
+{
+    Dispatcher<
+        Solver,
+        GillespieReactionNetwork,
+        ReactionNetworkParameters,
+        ReactionNetworkWriteLeapTrajectoriesSql,
+        ReactionNetworkReadLeapTrajectoriesSql,
+        ReactionNetworkWriteStateSql,
+        ReactionNetworkReadStateSql,
+        WriteCutoffSql,
+        ReadCutoffSql,
+        ReactionNetworkStateHistoryElement,
+        ReactionNetworkLeapHistoryElement,
+        CutoffHistoryElement,
+        TauLeapingSimulation<Solver>,
+        std::vector<int>>
+
+        dispatcher(
+            std::move(reaction_network_database),
+            std::move(initial_state_database),
+            std::move(model),
+            number_of_simulations,
+            base_seed,
+            thread_count,
+            cutoff,
+            history_parameters);
+
+    dispatcher.run_dispatcher();
+} // run_tau_leaping_reaction_network()
+
+/* ---------------------------------------------------------------------- */
+
+template <typename Solver, typename Sim = ReactionNetworkSimulation<Solver>>
+void run_reaction_network(
+    SqlConnection &&reaction_network_database,
+    SqlConnection &&initial_state_database,
+    GillespieReactionNetwork &&model,
+    int number_of_simulations,
+    int base_seed,
+    int thread_count,
+    Cutoff cutoff,
+    HistoryParameters history_parameters)
+{
+    // leaps are recorded with a firing count, so tau leaping writes a
+    // different trajectory type. The slow scale simulation writes the
+    // same type as the exact one.
+    if constexpr (std::is_same_v<Sim, ReactionNetworkSimulation<Solver>>)
+    {
+        if (model.tau_leaping_epsilon > 0.0)
+        {
+            run_tau_leaping_reaction_network<Solver>(
+                std::move(reaction_network_database),
+                std::move(initial_state_database), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            return;
+        }
+
+        if (model.fast_pairs.size() > 0)
+        {
+            run_reaction_network<Solver, SlowScaleSimulation<Solver>>(
+                std::move(reaction_network_database),
+                std::move(initial_state_database), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            return;
+        }
+    }
+
+    Dispatcher<
+        Solver,
+        GillespieReactionNetwork,
+        ReactionNetworkParameters,
+        ReactionNetworkWriteTrajectoriesSql,
+        ReactionNetworkReadTrajectoriesSql,
+        ReactionNetworkWriteStateSql,
+        ReactionNetworkReadStateSql,
+        WriteCutoffSql,
+        ReadCutoffSql,
+        ReactionNetworkStateHistoryElement,
+        ReactionNetworkTrajectoryHistoryElement,
+        CutoffHistoryElement,
+        Sim,
+        std::vector<int>>
+
+        dispatcher(
+            std::move(reaction_network_database),
+            std::move(initial_state_database),
+            std::move(model),
+            number_of_simulations,
+            base_seed,
+            thread_count,
+            cutoff,
+            history_parameters);
+
+    dispatcher.run_dispatcher();
+} // run_reaction_network()
+
+/* ---------------------------------------------------------------------- */
+
+template <typename Solver>
+void run_energy_reaction_network(
+    SqlConnection &&reaction_network_database,
+    SqlConnection &&initial_state_database,
+    EnergyReactionNetwork &&model,
+    int number_of_simulations,
+    int base_seed,
+    int thread_count,
+    Cutoff cutoff,
+    HistoryParameters history_parameters)
+{
+    Dispatcher<
+        Solver,
+        EnergyReactionNetwork,
+        EnergyReactionNetworkParameters,
+        ReactionNetworkWriteTrajectoriesSql,
+        ReactionNetworkReadTrajectoriesSql,
+        ReactionNetworkWriteStateSql,
+        ReactionNetworkReadStateSql,
+        EnergyNetworkWriteCutoffSql,
+        EnergyNetworkReadCutoffSql,
+        ReactionNetworkStateHistoryElement,
+        ReactionNetworkTrajectoryHistoryElement,
+        EnergyNetworkCutoffHistoryElement,
+        EnergyReactionNetworkSimulation<Solver>,
+        EnergyState>
+
+        dispatcher(
+            std::move(reaction_network_database),
+            std::move(initial_state_database),
+            std::move(model),
+            number_of_simulations,
+            base_seed,
+            thread_count,
+            cutoff,
+            history_parameters);
+
+    dispatcher.run_dispatcher();
+} // run_energy_reaction_network()
+
+/* ---------------------------------------------------------------------- */
+
 int main(int argc, char **argv)
 {
     // Print options if incorrect number of args are supplied
-    if (argc < 8 || argc > 9)
+    if (argc < 8 || argc > 20)
     {
         print_usage();
         exit(EXIT_FAILURE);
@@ -47,6 +324,17 @@ int main(int argc, char **argv)
         {"time_cutoff", optional_argument, NULL, 7},
         {"energy_budget", optional_argument, NULL, 8},
         {"checkpoint", required_argument, NULL, 9},
+        {"solver", required_argument, NULL, 10},
+        {"history_chunk_size", required_argument, NULL, 11},
+        {"max_history_mb", required_argument, NULL, 12},
+        {"journal_mode", required_argument, NULL, 13},
+        {"synchronous", required_argument, NULL, 14},
+        {"output_format", required_argument, NULL, 15},
+        {"max_dependency_graph_mb", required_argument, NULL, 16},
+        {"tau_leaping", required_argument, NULL, 17},
+        {"slow_scale", required_argument, NULL, 18},
+        {"model_cache", required_argument, NULL, 19},
+        {"rng", required_argument, NULL, 20},
         {NULL, 0, NULL, 0}};
 
     int c;
@@ -59,6 +347,19 @@ int main(int argc, char **argv)
     int thread_count = 0;
     double energy_budget = 0;
     bool isCheckpoint = false;
+    unsigned long int max_dependency_graph_bytes = default_max_dependency_graph_bytes;
+    double tau_leaping_epsilon = 0.0;
+    double slow_scale_ratio = 0.0;
+    std::string model_cache;
+    SolverType solver_type = default_solver;
+
+    HistoryParameters history_parameters = {
+        .history_chunk_size = default_history_chunk_size,
+        .max_bytes_in_flight = 0,
+        .journal_mode = "",
+        .synchronous = "",
+        .output_format = sqlite_output,
+        .trajectory_directory = ""};
 
     Cutoff cutoff = {
         .bound = {.step = 0},
@@ -111,6 +412,88 @@ int main(int argc, char **argv)
             isCheckpoint = atof(optarg);
             break;
 
+        case 10:
+            solver_type = parse_solver_type(optarg);
+            break;
+
+        case 11:
+            history_parameters.history_chunk_size = atol(optarg);
+            break;
+
+        case 12:
+            history_parameters.max_bytes_in_flight = atol(optarg) * 1024 * 1024;
+            break;
+
+        case 13:
+            history_parameters.journal_mode = optarg;
+            if (!is_journal_mode(history_parameters.journal_mode))
+            {
+                std::cerr << "unknown journal mode " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 14:
+            history_parameters.synchronous = optarg;
+            if (!is_synchronous_mode(history_parameters.synchronous))
+            {
+                std::cerr << "unknown synchronous mode " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 15:
+            if (std::string(optarg) == "sqlite")
+                history_parameters.output_format = sqlite_output;
+            else if (std::string(optarg) == "binary")
+                history_parameters.output_format = binary_output;
+            else
+            {
+                std::cerr << "unknown output format " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 16:
+            max_dependency_graph_bytes = atol(optarg) * 1024 * 1024;
+            break;
+
+        case 17:
+            tau_leaping_epsilon = atof(optarg);
+            if (tau_leaping_epsilon <= 0.0 || tau_leaping_epsilon >= 1.0)
+            {
+                std::cerr << "tau_leaping epsilon must be between 0 and 1\n";
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 18:
+            slow_scale_ratio = atof(optarg);
+            if (slow_scale_ratio <= 1.0)
+            {
+                std::cerr << "slow_scale ratio must be greater than 1\n";
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 19:
+            model_cache = optarg;
+            break;
+
+        case 20:
+            if (!parse_sampler_backend(optarg, sampler_backend))
+            {
+                std::cerr << "unknown rng " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
         default:
             // if an unexpected argument is passed, exit
             print_usage();
@@ -119,73 +502,220 @@ int main(int argc, char **argv)
         }
     }
 
+    if (history_parameters.history_chunk_size == 0)
+    {
+        std::cerr << "history_chunk_size must be positive\n";
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+
+    // reject options which can't be combined before any database is
+    // opened, let alone modified
+    if (tau_leaping_epsilon > 0.0 && slow_scale_ratio > 0.0)
+    {
+        std::cerr << "slow_scale and tau_leaping can't be combined\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (energy_budget != 0 && (tau_leaping_epsilon > 0.0 || slow_scale_ratio > 0.0))
+    {
+        std::cerr << "tau_leaping and slow_scale do not support an energy budget\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (solver_type == partial_propensity_solver)
+    {
+        // leaps need the propensity of every reaction, which this solver
+        // doesn't keep. Reactions above the energy budget are switched
+        // off one by one, which doesn't fit the grouping of reactions by
+        // reactants.
+        if (tau_leaping_epsilon > 0.0)
+        {
+            std::cerr << "the partial_propensity solver does not support tau_leaping\n";
+            exit(EXIT_FAILURE);
+        }
+
+        if (slow_scale_ratio > 0.0)
+        {
+            std::cerr << "the partial_propensity solver does not support slow_scale\n";
+            exit(EXIT_FAILURE);
+        }
+
+        if (energy_budget != 0)
+        {
+            std::cerr << "the partial_propensity solver does not support an energy budget\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // binary trajectories go next to the initial state database, which
+    // still holds the checkpoint tables
+    if (history_parameters.output_format == binary_output)
+        history_parameters.trajectory_directory =
+            std::string(initial_state_database) + ".trajectories";
+
+    SqlConnection reaction_network_connection(reaction_database,
+                                              SQLITE_OPEN_READWRITE);
+    SqlConnection initial_state_connection(initial_state_database,
+                                           SQLITE_OPEN_READWRITE);
+
     // Normal GMC if no energy budget is specified
     if (energy_budget == 0)
     {
+        // leaps are written with a firing count. The insert statement is
+        // prepared for binary output too, so the column is needed either way.
+        if (tau_leaping_epsilon > 0.0)
+            add_count_column(initial_state_connection);
+
         ReactionNetworkParameters parameters{
-            .isCheckpoint = isCheckpoint};
-
-        Dispatcher<
-            LinearSolver,
-            GillespieReactionNetwork,
-            ReactionNetworkParameters,
-            ReactionNetworkWriteTrajectoriesSql,
-            ReactionNetworkReadTrajectoriesSql,
-            ReactionNetworkWriteStateSql,
-            ReactionNetworkReadStateSql,
-            WriteCutoffSql,
-            ReadCutoffSql,
-            ReactionNetworkStateHistoryElement,
-            ReactionNetworkTrajectoryHistoryElement,
-            CutoffHistoryElement,
-            ReactionNetworkSimulation<LinearSolver>,
-            std::vector<int>>
-
-            dispatcher(
-                reaction_database,
-                initial_state_database,
-                number_of_simulations,
-                base_seed,
-                thread_count,
-                cutoff,
-                parameters);
-
-        dispatcher.run_dispatcher();
+            .isCheckpoint = isCheckpoint,
+            .max_dependency_graph_bytes = max_dependency_graph_bytes,
+            .tau_leaping_epsilon = tau_leaping_epsilon,
+            .thread_count = thread_count,
+            .model_cache = model_cache,
+            .per_reaction_propensities = solver_type != partial_propensity_solver};
+
+        GillespieReactionNetwork model(reaction_network_connection,
+                                       initial_state_connection,
+                                       parameters);
+
+        if (slow_scale_ratio > 0.0)
+            model.compute_fast_pairs(slow_scale_ratio);
+
+        if (solver_type == default_solver)
+            solver_type = linear_solver;
+        else if (solver_type == auto_solver)
+            solver_type = choose_solver_type(model.initial_state_propensities);
+
+        switch (solver_type)
+        {
+        case tree_solver:
+            run_reaction_network<TreeSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        case wide_tree_solver:
+            run_reaction_network<WideTreeSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        case sparse_solver:
+            run_reaction_network<SparseSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        case composition_rejection_solver:
+            run_reaction_network<CompositionRejectionSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        case next_reaction_solver:
+            run_reaction_network<NextReactionSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        case partial_propensity_solver:
+            model.compute_reactant_groups();
+            run_reaction_network<PartialPropensitySolver, PartialPropensitySimulation>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        default:
+            run_reaction_network<LinearSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+        }
     }
     else
     {
         // Include energy budget in MC
         EnergyReactionNetworkParameters parameters{
             .energy_budget = energy_budget,
-            .isCheckpoint = isCheckpoint};
-
-        Dispatcher<
-            LinearSolver,
-            EnergyReactionNetwork,
-            EnergyReactionNetworkParameters,
-            ReactionNetworkWriteTrajectoriesSql,
-            ReactionNetworkReadTrajectoriesSql,
-            ReactionNetworkWriteStateSql,
-            ReactionNetworkReadStateSql,
-            EnergyNetworkWriteCutoffSql,
-            EnergyNetworkReadCutoffSql,
-            ReactionNetworkStateHistoryElement,
-            ReactionNetworkTrajectoryHistoryElement,
-            EnergyNetworkCutoffHistoryElement,
-            EnergyReactionNetworkSimulation<TreeSolver>,
-            EnergyState>
-
-            dispatcher(
-                reaction_database,
-                initial_state_database,
-                number_of_simulations,
-                base_seed,
-                thread_count,
-                cutoff,
-                parameters);
-
-        // run the simulation
-        dispatcher.run_dispatcher();
+            .isCheckpoint = isCheckpoint,
+            .max_dependency_graph_bytes = max_dependency_graph_bytes,
+            .thread_count = thread_count,
+            .model_cache = model_cache};
+
+        EnergyReactionNetwork model(reaction_network_connection,
+                                    initial_state_connection,
+                                    parameters);
+
+        if (solver_type == default_solver)
+            solver_type = tree_solver;
+        else if (solver_type == auto_solver)
+            solver_type = choose_solver_type(model.initial_state_propensities);
+
+        switch (solver_type)
+        {
+        case linear_solver:
+            run_energy_reaction_network<LinearSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        case wide_tree_solver:
+            run_energy_reaction_network<WideTreeSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        case sparse_solver:
+            run_energy_reaction_network<SparseSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        case composition_rejection_solver:
+            run_energy_reaction_network<CompositionRejectionSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        case next_reaction_solver:
+            run_energy_reaction_network<NextReactionSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+
+        default:
+            run_energy_reaction_network<TreeSolver>(
+                std::move(reaction_network_connection),
+                std::move(initial_state_connection), std::move(model),
+                number_of_simulations, base_seed, thread_count, cutoff,
+                history_parameters);
+            break;
+        }
     }
 
     exit(EXIT_SUCCESS);
@@ -0,0 +1,218 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include <vector>
+#include <optional>
+#include <cmath>
+
+#include "composition_rejection_solver.h"
+
+// std::frexp returns exponents in [-1073, 1024] for positive finite
+// doubles, so offsetting by 1074 gives a non negative table index.
+constexpr int exponent_offset = 1074;
+constexpr int number_of_exponents = 2100;
+
+CompositionRejectionSolver::CompositionRejectionSolver(
+    SamplerSeed seed,
+    std::vector<double> &initial_propensities) : sampler(Sampler(seed)),
+                                                 propensities(initial_propensities.size(), 0.0),
+                                                 group_exponent(initial_propensities.size(), -1),
+                                                 member_index(initial_propensities.size(), 0),
+                                                 groups(),
+                                                 exponent_to_group(number_of_exponents, -1),
+                                                 number_of_active_indices(0),
+                                                 propensity_sum(0.0)
+{
+    for (unsigned long int i = 0; i < initial_propensities.size(); i++)
+    {
+        if (initial_propensities[i] > 0.0)
+            insert(i, initial_propensities[i]);
+    }
+} // CompositionRejectionSolver()
+
+/*---------------------------------------------------------------------------*/
+
+int CompositionRejectionSolver::find_or_create_group(int exponent)
+{
+    int offset_exponent = exponent + exponent_offset;
+    if (exponent_to_group[offset_exponent] >= 0)
+        return exponent_to_group[offset_exponent];
+
+    // keep groups sorted by decreasing exponent. New groups only appear
+    // when a propensity moves into a previously unseen binade, which is
+    // rare once a simulation is running.
+    unsigned long int slot = 0;
+    while (slot < groups.size() && groups[slot].exponent > exponent)
+        slot++;
+
+    groups.insert(groups.begin() + slot, CompositionRejectionGroup{
+                                             .exponent = exponent,
+                                             .bound = std::ldexp(1.0, exponent),
+                                             .propensity_sum = 0.0,
+                                             .members = {}});
+
+    for (unsigned long int i = slot; i < groups.size(); i++)
+        exponent_to_group[groups[i].exponent + exponent_offset] = i;
+
+    return slot;
+} // find_or_create_group()
+
+/*---------------------------------------------------------------------------*/
+
+void CompositionRejectionSolver::insert(unsigned long int index, double propensity)
+{
+    int exponent;
+    std::frexp(propensity, &exponent);
+
+    CompositionRejectionGroup &group = groups[find_or_create_group(exponent)];
+
+    group_exponent[index] = exponent + exponent_offset;
+    member_index[index] = group.members.size();
+    group.members.push_back(index);
+    group.propensity_sum += propensity;
+
+    propensities[index] = propensity;
+    number_of_active_indices++;
+} // insert()
+
+/*---------------------------------------------------------------------------*/
+
+void CompositionRejectionSolver::remove(unsigned long int index)
+{
+    CompositionRejectionGroup &group =
+        groups[exponent_to_group[group_exponent[index]]];
+
+    // swap the last member into the vacated position
+    unsigned long int position = member_index[index];
+    unsigned long int last = group.members.back();
+    group.members[position] = last;
+    member_index[last] = position;
+    group.members.pop_back();
+
+    // reset the sum of an empty group so rounding errors from the
+    // running sum don't accumulate over the simulation
+    if (group.members.empty())
+        group.propensity_sum = 0.0;
+    else
+        group.propensity_sum -= propensities[index];
+
+    group_exponent[index] = -1;
+    propensities[index] = 0.0;
+    number_of_active_indices--;
+} // remove()
+
+/*---------------------------------------------------------------------------*/
+
+void CompositionRejectionSolver::update(Update update)
+{
+    double old_propensity = propensities[update.index];
+
+    if (old_propensity > 0.0 && update.propensity > 0.0)
+    {
+        int exponent;
+        std::frexp(update.propensity, &exponent);
+
+        // staying in the same group only changes the group sum
+        if (exponent + exponent_offset == group_exponent[update.index])
+        {
+            groups[exponent_to_group[group_exponent[update.index]]]
+                .propensity_sum += update.propensity - old_propensity;
+            propensities[update.index] = update.propensity;
+            return;
+        }
+    }
+
+    if (old_propensity > 0.0)
+        remove(update.index);
+
+    if (update.propensity > 0.0)
+        insert(update.index, update.propensity);
+} // update()
+
+/*---------------------------------------------------------------------------*/
+
+void CompositionRejectionSolver::update(std::vector<Update> &updates)
+{
+    for (Update u : updates)
+    {
+        update(u);
+    }
+} // update()
+
+/*---------------------------------------------------------------------------*/
+
+std::optional<Event> CompositionRejectionSolver::event()
+{
+    if (number_of_active_indices == 0)
+    {
+        propensity_sum = 0.0;
+        return std::optional<Event>();
+    }
+
+    // the total is recomputed from the group sums on every event, which
+    // is cheap since there are only as many groups as binades in use
+    propensity_sum = get_propensity_sum();
+
+    double r1 = sampler.generate();
+    double fraction = propensity_sum * r1;
+    double partial = 0.0;
+
+    // composition: pick a group proportional to its propensity sum.
+    // If rounding pushes us past the end, fall back to the last
+    // non-empty group.
+    CompositionRejectionGroup *selected_group = nullptr;
+    for (CompositionRejectionGroup &group : groups)
+    {
+        if (group.members.empty())
+            continue;
+
+        selected_group = &group;
+        partial += group.propensity_sum;
+        if (partial > fraction)
+            break;
+    }
+
+    // rejection: pick a member uniformly and accept it with probability
+    // propensity / bound. A single uniform supplies both the member and
+    // the acceptance test.
+    unsigned long int number_of_members = selected_group->members.size();
+    unsigned long int m;
+    while (true)
+    {
+        double r = sampler.generate() * number_of_members;
+        unsigned long int k = static_cast<unsigned long int>(r);
+        if (k >= number_of_members)
+            k = number_of_members - 1;
+
+        m = selected_group->members[k];
+        if ((r - k) * selected_group->bound < propensities[m])
+            break;
+    }
+
+    double waiting_time = sampler.exponential();
+    sampler.next_step();
+    double dt = waiting_time / propensity_sum;
+    return std::optional<Event>(Event{.index = m, .dt = dt});
+} // event()
+
+/*---------------------------------------------------------------------------*/
+
+double CompositionRejectionSolver::get_propensity(int index)
+{
+    return propensities[index];
+} // get_propensity()
+
+/*---------------------------------------------------------------------------*/
+
+double CompositionRejectionSolver::get_propensity_sum()
+{
+    propensity_sum = 0.0;
+    for (CompositionRejectionGroup &group : groups)
+        propensity_sum += group.propensity_sum;
+
+    return propensity_sum;
+} // get_propensity_sum()
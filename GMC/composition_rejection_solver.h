@@ -0,0 +1,74 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_COMPOSITION_REJECTION_SOLVER_H
+#define RNMC_COMPOSITION_REJECTION_SOLVER_H
+
+#include <vector>
+#include <optional>
+#include <cmath>
+
+#include "../core/sampler.h"
+#include "../core/RNMC_types.h"
+
+// composition-rejection solver from Slepoy et al., J. Chem. Phys. 128,
+// 205101 (2008). Reactions are binned into groups by the power of two
+// bounding their propensity. An event is drawn by first picking a group
+// with probability proportional to its propensity sum (composition) and
+// then picking uniformly inside the group, accepting with probability
+// propensity / group bound (rejection). Since every propensity in a group
+// is within a factor of two of the bound, at most two draws are needed
+// on average. Both updates and events are O(1) in the number of
+// reactions, only the number of groups (which is set by the range of
+// propensities, not the size of the network) enters the event cost.
+
+struct CompositionRejectionGroup
+{
+    int exponent;                       // propensities lie in [2^(exponent-1), 2^exponent)
+    double bound;                       // 2^exponent
+    double propensity_sum;
+    std::vector<unsigned long int> members;
+};
+
+class CompositionRejectionSolver
+{
+private:
+    Sampler sampler;
+    std::vector<double> propensities;
+
+    // group_exponent[i] is the exponent (offset by exponent_offset) of
+    // the group containing reaction i, or -1 if the reaction has zero
+    // propensity. member_index[i] is the position of reaction i within
+    // that group.
+    std::vector<int> group_exponent;
+    std::vector<unsigned long int> member_index;
+
+    // groups are created lazily and never removed. They are kept sorted
+    // by decreasing exponent so the composition step usually terminates
+    // in the first few groups. exponent_to_group maps an offset exponent
+    // to its slot in groups, or -1.
+    std::vector<CompositionRejectionGroup> groups;
+    std::vector<int> exponent_to_group;
+
+    int number_of_active_indices;
+    double propensity_sum;
+
+    int find_or_create_group(int exponent);
+    void insert(unsigned long int index, double propensity);
+    void remove(unsigned long int index);
+
+public:
+    CompositionRejectionSolver() : sampler(Sampler(0)){};
+    CompositionRejectionSolver(SamplerSeed seed, std::vector<double> &initial_propensities);
+    void update(Update update);
+    void update(std::vector<Update> &updates);
+    std::optional<Event> event();
+    double get_propensity(int index);
+    double get_propensity_sum();
+};
+
+#endif
@@ -8,6 +8,9 @@ See the README file in the top-level RNMC directory.
 #ifndef ENERGY_REACTION_NETWORK_H
 #define ENERGY_REACTION_NETWORK_H
 
+#include <algorithm>
+#include <chrono>
+
 #include "reaction_network.h"
 #include "sql_types.h"
 
@@ -30,6 +33,13 @@ struct EnergyReactionNetworkParameters
 {
     double energy_budget;
     bool isCheckpoint;
+    unsigned long int max_dependency_graph_bytes = default_max_dependency_graph_bytes;
+
+    // threads used to load the network and build the dependency graphs
+    int thread_count = 1;
+
+    // see ReactionNetworkParameters
+    std::string model_cache = "";
 };
 
 struct EnergyState
@@ -44,6 +54,11 @@ public:
     bool isCheckpoint;
     EnergyState initial_state;
 
+    // reaction ids sorted by increasing dG. Lowering the energy budget
+    // only switches off the reactions whose dG lies between the old and
+    // the new budget, which form a contiguous range of this list.
+    std::vector<int> reactions_by_dG;
+
     EnergyReactionNetwork(
         SqlConnection &reaction_network_database,
         SqlConnection &initial_state_database,
@@ -54,10 +69,20 @@ public:
         int reaction,
         double energy_budget);
 
+    void compute_initial_propensities(
+        std::vector<int> &state,
+        double energy_budget,
+        std::vector<double> &initial_propensities,
+        int thread_count = 1);
+
+    // append the propensity updates caused by next_reaction, which
+    // lowered the energy budget from previous_energy_budget to
+    // energy_budget, to updates
     void update_propensities(
-        std::function<void(Update update)> update_function,
+        std::vector<Update> &updates,
         std::vector<int> &state,
         int next_reaction,
+        double previous_energy_budget,
         double energy_budget);
 
     void update_energy_budget(
@@ -67,9 +92,8 @@ public:
     void checkpoint(SqlReader<ReactionNetworkReadStateSql> state_reader,
                     SqlReader<EnergyNetworkReadCutoffSql> cutoff_reader,
                     SqlReader<ReactionNetworkReadTrajectoriesSql> trajectory_reader,
-                    std::map<int, EnergyState> &temp_seed_state_map,
+                    SeedStateStore<EnergyState> &temp_seed_state_map,
                     std::map<int, int> &temp_seed_step_map,
-                    SeedQueue &temp_seed_queue,
                     std::map<int, double> &temp_seed_time_map,
                     EnergyReactionNetwork &model);
 
@@ -91,6 +115,8 @@ EnergyReactionNetwork::EnergyReactionNetwork(
     SqlConnection &initial_state_database,
     EnergyReactionNetworkParameters parameters)
 {
+    auto startup_begin = std::chrono::steady_clock::now();
+
     isCheckpoint = parameters.isCheckpoint;
 
     // collecting reaction network metadata
@@ -134,48 +160,93 @@ EnergyReactionNetwork::EnergyReactionNetwork(
         initial_state.homogeneous[species_id] = initial_state_row.count;
     }
 
-    // loading reactions
-    // vectors are default initialized to empty.
-    // it is "cleaner" to resize the default vector than to
-    // drop it and reinitialize a new vector.
-    reactions.resize(metadata_row.number_of_reactions);
-
     // Get the energy_budget from parameters
     initial_state.energy_budget = parameters.energy_budget;
 
-    SqlStatement<EnergyReactionSql> reaction_statement(reaction_network_database);
-    SqlReader<EnergyReactionSql> reaction_reader(reaction_statement);
+    // loading reactions, from the model cache when there is a valid one
+    uint64_t fingerprint = database_fingerprint(
+        reaction_network_database.database_file_path,
+        parameters.max_dependency_graph_bytes);
+
+    ModelCacheReader cache_reader;
+    bool from_cache = !parameters.model_cache.empty() &&
+                      cache_reader.open(parameters.model_cache,
+                                        energy_model_cache, fingerprint) &&
+                      read_cache(cache_reader) &&
+                      cache_reader.read(reactions_by_dG) &&
+                      reactions.size() == metadata_row.number_of_reactions &&
+                      dependents.size() == metadata_row.number_of_species;
+
+    if (from_cache)
+        std::cerr << time::time_stamp() << "read " << reactions.size()
+                  << " reactions from model cache " << parameters.model_cache << '\n';
+    else
+    {
+        // vectors are default initialized to empty.
+        // it is "cleaner" to resize the default vector than to
+        // drop it and reinitialize a new vector.
+        reactions.resize(metadata_row.number_of_reactions,
+                         metadata_row.number_of_species);
+
+        load_reactions<EnergyReactionSql>(
+            reaction_network_database, parameters.thread_count,
+            [](EnergyReactionSql &reaction_row)
+            {
+                return EnergyReaction{
+                    .number_of_reactants = (uint8_t)reaction_row.number_of_reactants,
+                    .number_of_products = (uint8_t)reaction_row.number_of_products,
+                    .reactants = {reaction_row.reactant_1, reaction_row.reactant_2},
+                    .products = {reaction_row.product_1, reaction_row.product_2},
+                    .rate = reaction_row.rate,
+                    .dG = reaction_row.dG};
+            });
 
-    unsigned long int reaction_id = 0;
+        std::cerr << time::time_stamp() << "loaded " << reactions.size()
+                  << " reactions\n";
 
-    while (std::optional<EnergyReactionSql> maybe_reaction_row = reaction_reader.next())
-    {
+        reactions_by_dG.resize(reactions.size());
+        for (unsigned long int i = 0; i < reactions.size(); i++)
+            reactions_by_dG[i] = i;
 
-        EnergyReactionSql reaction_row = maybe_reaction_row.value();
-        uint8_t number_of_reactants = reaction_row.number_of_reactants;
-        uint8_t number_of_products = reaction_row.number_of_products;
-        reaction_id = reaction_row.reaction_id;
+        std::stable_sort(reactions_by_dG.begin(), reactions_by_dG.end(),
+                         [&](int a, int b)
+                         { return reactions.dG[a] < reactions.dG[b]; });
 
-        EnergyReaction reaction = {
-            .number_of_reactants = number_of_reactants,
-            .number_of_products = number_of_products,
-            .reactants = {reaction_row.reactant_1, reaction_row.reactant_2},
-            .products = {reaction_row.product_1, reaction_row.product_2},
-            .rate = reaction_row.rate,
-            .dG = reaction_row.dG};
+        std::cerr << time::time_stamp() << "computing dependency graph...\n";
 
-        reactions[reaction_id] = reaction;
+        // initializing dependency graph
+        compute_dependents(initial_state.homogeneous.size(), parameters.thread_count);
+        compute_affected(parameters.max_dependency_graph_bytes, parameters.thread_count);
+
+        std::cerr << time::time_stamp() << "finished computing dependency graph\n";
+
+        if (!parameters.model_cache.empty())
+        {
+            ModelCacheWriter cache_writer(parameters.model_cache,
+                                          energy_model_cache, fingerprint);
+            write_cache(cache_writer);
+            cache_writer.write(reactions_by_dG);
+            if (cache_writer.finish())
+                std::cerr << time::time_stamp() << "wrote model cache "
+                          << parameters.model_cache << '\n';
+            else
+                std::cerr << time::time_stamp() << "could not write model cache "
+                          << parameters.model_cache << '\n';
+        }
     }
 
     std::cerr << "energy_budget: " << initial_state.energy_budget << std::endl;
 
-    std::cerr << time::time_stamp() << "computing dependency graph...\n";
-
-    // initializing dependency graph
-    dependents.resize(initial_state.homogeneous.size());
-    compute_dependents();
+    compute_initial_propensities(initial_state.homogeneous,
+                                 initial_state.energy_budget,
+                                 initial_state_propensities,
+                                 parameters.thread_count);
 
-    std::cerr << time::time_stamp() << "finished computing dependency graph\n";
+    std::chrono::duration<double> startup_seconds =
+        std::chrono::steady_clock::now() - startup_begin;
+    std::cerr << time::time_stamp() << "network ready after "
+              << startup_seconds.count() << " s using "
+              << parameters.thread_count << " threads\n";
 
 } // EnergyReactionNetwork()
 
@@ -188,9 +259,7 @@ double EnergyReactionNetwork::compute_energy_propensity(
 {
     // Compute propensities when we are considering dG > 0 reactions
 
-    EnergyReaction &reaction = reactions[reaction_index];
-
-    if (reaction.dG > energy_budget)
+    if (reactions.dG[reaction_index] > energy_budget)
     {
         // When the reaction requires more energy than is available, it cannot happen
 
@@ -209,59 +278,65 @@ double EnergyReactionNetwork::compute_energy_propensity(
 
 /*---------------------------------------------------------------------------*/
 
-void EnergyReactionNetwork::update_propensities(
-    std::function<void(Update update)> update_function,
+void EnergyReactionNetwork::compute_initial_propensities(
     std::vector<int> &state,
-    int next_reaction,
-    double energy_budget)
+    double energy_budget,
+    std::vector<double> &initial_propensities,
+    int thread_count)
 {
+    initial_propensities.resize(reactions.size());
 
-    EnergyReaction &reaction = reactions[next_reaction];
+    parallel_ranges(thread_count, initial_propensities.size(),
+                    [&](int, unsigned long int begin, unsigned long int end)
+                    {
+        for (unsigned long int i = begin; i < end; i++)
+            initial_propensities[i] = compute_energy_propensity(
+                state, i, energy_budget); });
+} // compute_initial_propensities()
 
-    std::vector<int> species_of_interest;
-    species_of_interest.reserve(4);
-
-    for (int i = 0; i < reaction.number_of_reactants; i++)
-    {
-        int reactant_id = reaction.reactants[i];
-        species_of_interest.push_back(reactant_id);
-    }
+/*---------------------------------------------------------------------------*/
 
-    for (int j = 0; j < reaction.number_of_products; j++)
-    {
-        int product_id = reaction.products[j];
-        species_of_interest.push_back(product_id);
-    }
+void EnergyReactionNetwork::update_propensities(
+    std::vector<Update> &updates,
+    std::vector<int> &state,
+    int next_reaction,
+    double previous_energy_budget,
+    double energy_budget)
+{
 
     // Update the propensities for reactions corresponding to species
     // which were produced or consumed
-    for (int species_id : species_of_interest)
-    {
-        for (unsigned int reaction_index : dependents[species_id])
-        {
-            double new_propensity = compute_energy_propensity(
-                state,
-                reaction_index,
-                energy_budget);
-
-            update_function(Update{
-                .index = reaction_index,
-                .propensity = new_propensity});
-        }
-    }
-
-    // We'll need to update the propensities for all reactions which have
-    // a dG > energy_budget
-    for (unsigned int reaction_index = 0; reaction_index < reactions.size(); reaction_index++)
-    {
+    for_each_affected(next_reaction, [&](unsigned int reaction_index)
+                      {
         double new_propensity = compute_energy_propensity(
             state,
             reaction_index,
             energy_budget);
 
-        update_function(Update{
+        updates.push_back(Update{
             .index = reaction_index,
-            .propensity = new_propensity});
+            .propensity = new_propensity}); });
+
+    // Reactions with previous_energy_budget >= dG > energy_budget no
+    // longer fit in the budget. Every other reaction was either already
+    // switched off or is unaffected by the change in budget.
+    if (energy_budget < previous_energy_budget)
+    {
+        auto by_dG = [&](double budget, int reaction_index)
+        { return budget < reactions.dG[reaction_index]; };
+
+        auto first = std::upper_bound(reactions_by_dG.begin(),
+                                      reactions_by_dG.end(),
+                                      energy_budget, by_dG);
+        auto last = std::upper_bound(first, reactions_by_dG.end(),
+                                     previous_energy_budget, by_dG);
+
+        for (auto it = first; it != last; it++)
+        {
+            updates.push_back(Update{
+                .index = static_cast<unsigned long int>(*it),
+                .propensity = 0.0});
+        }
     }
 } // update_propensities()
 
@@ -272,13 +347,13 @@ void EnergyReactionNetwork::update_energy_budget(
     int next_reaction)
 {
 
-    EnergyReaction &reaction = reactions[next_reaction];
+    double dG = reactions.dG[next_reaction];
 
     // We only need to update the energy budget when the reaction triggered is dG > 0.
     // This way we avoid reaction loops
-    if (reaction.dG > 0)
+    if (dG > 0)
     {
-        energy_budget = energy_budget - reaction.dG;
+        energy_budget = energy_budget - dG;
     }
 } // update_energy_budget()
 
@@ -287,22 +362,13 @@ void EnergyReactionNetwork::update_energy_budget(
 void EnergyReactionNetwork::checkpoint(SqlReader<ReactionNetworkReadStateSql> state_reader,
                                        SqlReader<EnergyNetworkReadCutoffSql> cutoff_reader,
                                        SqlReader<ReactionNetworkReadTrajectoriesSql> trajectory_reader,
-                                       std::map<int, EnergyState> &temp_seed_state_map,
+                                       SeedStateStore<EnergyState> &temp_seed_state_map,
                                        std::map<int, int> &temp_seed_step_map,
-                                       SeedQueue &temp_seed_queue,
                                        std::map<int, double> &temp_seed_time_map,
                                        EnergyReactionNetwork &model)
 {
 
     bool read_interrupt_states = false;
-    EnergyState default_state = model.initial_state;
-
-    while (std::optional<unsigned long int> maybe_seed =
-               temp_seed_queue.get_seed())
-    {
-        unsigned long int seed = maybe_seed.value();
-        temp_seed_state_map.insert(std::make_pair(seed, default_state));
-    }
 
     while (std::optional<EnergyNetworkReadCutoffSql> maybe_cutoff_row = cutoff_reader.next())
     {
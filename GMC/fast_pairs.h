@@ -0,0 +1,189 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_FAST_PAIRS_H
+#define RNMC_FAST_PAIRS_H
+
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "reaction_network.h"
+
+// fast reversible pairs A <-> B for the slow scale simulation. A pair is
+// made of all the reactions A -> B and B -> A, and is fast when a
+// molecule of A or B flips between the two much faster than it takes
+// part in any other reaction. The fast reactions are then assumed to be
+// at equilibrium, where each of the n_A + n_B molecules of the pair is
+// independently an A with probability
+//
+//     p_A = rate(B -> A) / (rate(A -> B) + rate(B -> A))
+//
+// following the slow scale SSA of Cao, Gillespie and Petzold, J. Chem.
+// Phys. 122, 014116 (2005).
+struct FastPairs
+{
+    std::vector<int> first;             // species A of each pair
+    std::vector<int> second;            // species B of each pair
+    std::vector<double> first_fraction; // p_A of each pair
+
+    std::vector<int> pair_of_species; // pair of each species, -1 if it has none
+    std::vector<bool> fast_reaction;  // reactions of the pairs
+
+    unsigned long int size() const { return first.size(); };
+
+    // ratio is how many times faster than any other reaction of its
+    // species each direction of a pair must be, judged at state
+    template <typename Reaction>
+    void compute(ReactionNetwork<Reaction> &reaction_network,
+                 const std::vector<int> &state,
+                 double ratio);
+};
+
+/*---------------------------------------------------------------------------*/
+
+template <typename Reaction>
+void FastPairs::compute(ReactionNetwork<Reaction> &reaction_network,
+                        const std::vector<int> &state,
+                        double ratio)
+{
+    ReactionArrays<Reaction> &reactions = reaction_network.reactions;
+    unsigned long int number_of_reactions = reactions.size();
+    unsigned long int number_of_species = state.size();
+
+    // summed rates of the unimolecular reactions between each pair of
+    // species, keyed by (A, B) with A < B
+    struct Candidate
+    {
+        double forward = 0.0;  // A -> B
+        double backward = 0.0; // B -> A
+    };
+    std::map<std::pair<int, int>, Candidate> candidates;
+
+    for (unsigned long int i = 0; i < number_of_reactions; i++)
+    {
+        if (reactions.number_of_reactants[i] != 1 ||
+            reactions.number_of_products[i] != 1)
+            continue;
+
+        int reactant = reactions.reactants[2 * i];
+        int product = reactions.products[2 * i];
+        if (reactant == product)
+            continue;
+
+        if (reactant < product)
+            candidates[{reactant, product}].forward += reactions.rate[i];
+        else
+            candidates[{product, reactant}].backward += reactions.rate[i];
+    }
+
+    // the fastest rate per molecule at which each species takes part in
+    // a reaction other than a unimolecular one to another species
+    std::vector<double> other_rate(number_of_species, 0.0);
+    for (unsigned long int i = 0; i < number_of_reactions; i++)
+    {
+        int number_of_reactants = reactions.number_of_reactants[i];
+        const SpeciesIndex *reactants = &reactions.reactants[2 * i];
+
+        if (number_of_reactants == 1 && reactions.number_of_products[i] == 1 &&
+            reactants[0] != reactions.products[2 * i])
+            continue;
+
+        for (int k = 0; k < number_of_reactants; k++)
+        {
+            double rate = reactions.rate[i];
+            if (number_of_reactants == 2)
+            {
+                int other = reactants[1 - k];
+                rate *= reaction_network.factor_two * std::max(state[other], 1);
+                if (reactants[0] == reactants[1])
+                    rate *= reaction_network.factor_duplicate;
+            }
+
+            other_rate[reactants[k]] = std::max(other_rate[reactants[k]], rate);
+        }
+    }
+
+    // the unimolecular reactions are every candidate's flips, so the two
+    // fastest out of each species, as (summed rate, product), are kept.
+    // A candidate leaves out only its own flips, and still sees the
+    // fastest of the others, whether they drain the species or are the
+    // flips of another candidate.
+    std::vector<std::pair<double, int>> fastest_flip(number_of_species, {0.0, -1});
+    std::vector<std::pair<double, int>> second_flip(number_of_species, {0.0, -1});
+
+    auto add_flip = [&](int reactant, int product, double rate)
+    {
+        if (rate > fastest_flip[reactant].first)
+        {
+            second_flip[reactant] = fastest_flip[reactant];
+            fastest_flip[reactant] = {rate, product};
+        }
+        else if (rate > second_flip[reactant].first)
+            second_flip[reactant] = {rate, product};
+    };
+
+    for (auto &[species, candidate] : candidates)
+    {
+        add_flip(species.first, species.second, candidate.forward);
+        add_flip(species.second, species.first, candidate.backward);
+    }
+
+    auto fastest_other = [&](int species, int partner)
+    {
+        double flip = fastest_flip[species].second != partner ? fastest_flip[species].first
+                                                              : second_flip[species].first;
+        return std::max(other_rate[species], flip);
+    };
+
+    // accept the fastest pairs first, so that a species sitting between
+    // two candidate pairs joins the faster one
+    std::vector<std::pair<double, std::pair<int, int>>> fast;
+    for (auto &[species, candidate] : candidates)
+    {
+        double slowest_flip = std::min(candidate.forward, candidate.backward);
+        double fastest = std::max(fastest_other(species.first, species.second),
+                                  fastest_other(species.second, species.first));
+
+        if (slowest_flip > 0.0 && slowest_flip >= ratio * fastest)
+            fast.push_back({slowest_flip, species});
+    }
+    std::sort(fast.begin(), fast.end(), std::greater<>());
+
+    first.clear();
+    second.clear();
+    first_fraction.clear();
+    pair_of_species.assign(number_of_species, -1);
+
+    for (auto &[slowest_flip, species] : fast)
+    {
+        auto [a, b] = species;
+        if (pair_of_species[a] >= 0 || pair_of_species[b] >= 0)
+            continue;
+
+        Candidate candidate = candidates[species];
+        pair_of_species[a] = first.size();
+        pair_of_species[b] = first.size();
+        first.push_back(a);
+        second.push_back(b);
+        first_fraction.push_back(candidate.backward / (candidate.forward + candidate.backward));
+    }
+
+    fast_reaction.assign(number_of_reactions, false);
+    for (unsigned long int i = 0; i < number_of_reactions; i++)
+    {
+        if (reactions.number_of_reactants[i] != 1 ||
+            reactions.number_of_products[i] != 1)
+            continue;
+
+        int pair = pair_of_species[reactions.reactants[2 * i]];
+        if (pair >= 0 && pair == pair_of_species[reactions.products[2 * i]])
+            fast_reaction[i] = true;
+    }
+} // compute()
+
+#endif
@@ -9,14 +9,35 @@ See the README file in the top-level RNMC directory.
 #define RNMC_GILLESPIE_REACTION_NETWORK_H
 
 #include <functional>
+#include <chrono>
 
 #include "reaction_network.h"
+#include "reactant_groups.h"
+#include "fast_pairs.h"
 
 // parameters passed to the ReactionNetwork constructor
 // by the dispatcher which are model specific
 struct ReactionNetworkParameters
 {
     bool isCheckpoint;
+    unsigned long int max_dependency_graph_bytes = default_max_dependency_graph_bytes;
+
+    // relative change in propensities allowed per leap, 0 to run every
+    // reaction exactly. See TauLeapingSimulation.
+    double tau_leaping_epsilon = 0.0;
+
+    // threads used to load the network and build the dependency graphs
+    int thread_count = 1;
+
+    // model cache file to read the network from, or to write it to if
+    // there is no valid one. Empty to always read the database.
+    std::string model_cache = "";
+
+    // false for the partial propensity solver, which keeps propensities
+    // by reactant group. The network then skips the reaction dependency
+    // graph and the initial propensity of every reaction, neither of
+    // which it would use.
+    bool per_reaction_propensities = true;
 };
 
 struct GillespieReaction
@@ -34,24 +55,56 @@ struct GillespieReaction
 class GillespieReactionNetwork : public ReactionNetwork<GillespieReaction>
 {
 public:
-    std::vector<int> initial_state; 
-    GillespieReactionNetwork(){};   
+    std::vector<int> initial_state;
+
+    // only computed for the partial propensity solver, by
+    // compute_reactant_groups
+    ReactantGroups reactant_groups;
+
+    // only computed for the slow scale simulation, by compute_fast_pairs
+    FastPairs fast_pairs;
+
+    double tau_leaping_epsilon;
+
+    // only computed in tau leaping mode. The highest order of a reaction
+    // each species is a reactant of: 0 if it is never a reactant, 1, 2,
+    // or 3 for a reaction of the form A + A -> ...
+    std::vector<uint8_t> highest_reactant_order;
+
+    GillespieReactionNetwork(){};
     GillespieReactionNetwork(
         SqlConnection &reaction_network_database,
         SqlConnection &initial_state_database,
         ReactionNetworkParameters parameters);
 
+    // append the propensity updates caused by next_reaction to updates.
+    // The caller owns the buffer so it can be reused from step to step
+    // and handed to the solver in one batch.
+    void update_propensities(
+        std::vector<Update> &updates,
+        std::vector<int> &state,
+        int next_reaction);
+
     void update_propensities(
         std::function<void(Update update)> update_function,
         std::vector<int> &state,
         int next_reaction);
 
+    void compute_reactant_groups();
+
+    void compute_highest_reactant_orders();
+
+    void compute_fast_pairs(double ratio);
+
+    // trajectories are replayed to rebuild states when there are no
+    // interrupt states, either one firing per row or count firings per
+    // row in tau leaping mode
+    template <typename ReadTrajectoriesSql>
     void checkpoint(SqlReader<ReactionNetworkReadStateSql> state_reader,
                     SqlReader<ReadCutoffSql> cutoff_reader,
-                    SqlReader<ReactionNetworkReadTrajectoriesSql> trajectory_reader,
-                    std::map<int, std::vector<int>> &temp_seed_state_map,
+                    SqlReader<ReadTrajectoriesSql> trajectory_reader,
+                    SeedStateStore<std::vector<int>> &temp_seed_state_map,
                     std::map<int, int> &temp_seed_step_map,
-                    SeedQueue &temp_seed_queue,
                     std::map<int, double> &temp_seed_time_map,
                     GillespieReactionNetwork &model);
 
@@ -72,7 +125,10 @@ GillespieReactionNetwork::GillespieReactionNetwork(
     ReactionNetworkParameters parameters)
 {
 
+    auto startup_begin = std::chrono::steady_clock::now();
+
     isCheckpoint = parameters.isCheckpoint;
+    tau_leaping_epsilon = parameters.tau_leaping_epsilon;
 
     // collecting reaction network metadata
     SqlStatement<MetadataSql> metadata_statement(reaction_network_database);
@@ -115,101 +171,189 @@ GillespieReactionNetwork::GillespieReactionNetwork(
         initial_state[species_id] = initial_state_row.count;
     }
 
-    // loading reactions
-    reactions.resize(metadata_row.number_of_reactions);
+    // loading reactions, from the model cache when there is a valid one.
+    // A network without a dependency graph is cached like one built with
+    // no room for it.
+    unsigned long int max_dependency_graph_bytes =
+        parameters.per_reaction_propensities ? parameters.max_dependency_graph_bytes : 0;
+
+    uint64_t fingerprint = database_fingerprint(
+        reaction_network_database.database_file_path,
+        max_dependency_graph_bytes);
+
+    ModelCacheReader cache_reader;
+    bool from_cache = !parameters.model_cache.empty() &&
+                      cache_reader.open(parameters.model_cache,
+                                        gillespie_model_cache, fingerprint) &&
+                      read_cache(cache_reader) &&
+                      reactions.size() == metadata_row.number_of_reactions &&
+                      dependents.size() == metadata_row.number_of_species;
+
+    if (from_cache)
+        std::cerr << time::time_stamp() << "read " << reactions.size()
+                  << " reactions from model cache " << parameters.model_cache << '\n';
+    else
+    {
+        reactions.resize(metadata_row.number_of_reactions,
+                         metadata_row.number_of_species);
 
-    SqlStatement<ReactionSql> reaction_statement(reaction_network_database);
-    SqlReader<ReactionSql> reaction_reader(reaction_statement);
+        load_reactions<ReactionSql>(
+            reaction_network_database, parameters.thread_count,
+            [](ReactionSql &reaction_row)
+            {
+                return GillespieReaction{
+                    .number_of_reactants = (uint8_t)reaction_row.number_of_reactants,
+                    .number_of_products = (uint8_t)reaction_row.number_of_products,
+                    .reactants = {reaction_row.reactant_1, reaction_row.reactant_2},
+                    .products = {reaction_row.product_1, reaction_row.product_2},
+                    .rate = reaction_row.rate};
+            });
 
-    unsigned long int reaction_id = 0;
+        std::cerr << time::time_stamp() << "loaded " << reactions.size()
+                  << " reactions\n";
 
-    while (std::optional<ReactionSql> maybe_reaction_row = reaction_reader.next())
-    {
+        std::cerr << time::time_stamp() << "computing dependency graph...\n";
 
-        ReactionSql reaction_row = maybe_reaction_row.value();
-        uint8_t number_of_reactants = reaction_row.number_of_reactants;
-        uint8_t number_of_products = reaction_row.number_of_products;
-        reaction_id = reaction_row.reaction_id;
-
-        GillespieReaction reaction = {
-            .number_of_reactants = number_of_reactants,
-            .number_of_products = number_of_products,
-            .reactants = {reaction_row.reactant_1, reaction_row.reactant_2},
-            .products = {reaction_row.product_1, reaction_row.product_2},
-            .rate = reaction_row.rate};
-        reactions[reaction_id] = reaction;
+        compute_dependents(initial_state.size(), parameters.thread_count);
+        if (parameters.per_reaction_propensities)
+            compute_affected(max_dependency_graph_bytes, parameters.thread_count);
+        std::cerr << time::time_stamp() << "finished computing dependency graph\n";
+
+        if (!parameters.model_cache.empty())
+        {
+            ModelCacheWriter cache_writer(parameters.model_cache,
+                                          gillespie_model_cache, fingerprint);
+            write_cache(cache_writer);
+            if (cache_writer.finish())
+                std::cerr << time::time_stamp() << "wrote model cache "
+                          << parameters.model_cache << '\n';
+            else
+                std::cerr << time::time_stamp() << "could not write model cache "
+                          << parameters.model_cache << '\n';
+        }
     }
 
-    std::cerr << time::time_stamp() << "computing dependency graph...\n";
-    dependents.resize(initial_state.size());
+    if (parameters.per_reaction_propensities)
+        compute_initial_propensities(initial_state, initial_state_propensities,
+                                     parameters.thread_count);
+
+    if (tau_leaping_epsilon > 0.0)
+        compute_highest_reactant_orders();
 
-    compute_dependents();
-    std::cerr << time::time_stamp() << "finished computing dependency graph\n";
+    std::chrono::duration<double> startup_seconds =
+        std::chrono::steady_clock::now() - startup_begin;
+    std::cerr << time::time_stamp() << "network ready after "
+              << startup_seconds.count() << " s using "
+              << parameters.thread_count << " threads\n";
 
 } // GillespieReactionNetwork()
 
 /*---------------------------------------------------------------------------*/
 
+void GillespieReactionNetwork::update_propensities(
+    std::vector<Update> &updates,
+    std::vector<int> &state,
+    int next_reaction)
+{
+
+    for_each_affected(next_reaction, [&](unsigned int reaction_index)
+                      {
+        double new_propensity = compute_propensity(
+            state,
+            reaction_index);
+
+        updates.push_back(Update{
+            .index = reaction_index,
+            .propensity = new_propensity}); });
+} // update_propensities()
+
+/*---------------------------------------------------------------------------*/
+
 void GillespieReactionNetwork::update_propensities(
     std::function<void(Update update)> update_function,
     std::vector<int> &state,
     int next_reaction)
 {
+    std::vector<Update> updates;
+    update_propensities(updates, state, next_reaction);
 
-    GillespieReaction &reaction = reactions[next_reaction];
+    for (Update update : updates)
+        update_function(update);
+} // update_propensities()
 
-    std::vector<int> species_of_interest;
-    species_of_interest.reserve(4);
+/*---------------------------------------------------------------------------*/
 
-    for (int i = 0; i < reaction.number_of_reactants; i++)
-    {
-        int reactant_id = reaction.reactants[i];
-        species_of_interest.push_back(reactant_id);
-    }
+void GillespieReactionNetwork::compute_reactant_groups()
+{
+    std::cerr << time::time_stamp() << "grouping reactions by reactants...\n";
 
-    for (int j = 0; j < reaction.number_of_products; j++)
-    {
-        int product_id = reaction.products[j];
-        species_of_interest.push_back(product_id);
-    }
+    reactant_groups.compute(*this, initial_state.size());
+
+    std::cerr << time::time_stamp() << reactions.size() << " reactions in "
+              << reactant_groups.number_of_groups() << " reactant groups\n";
+} // compute_reactant_groups()
+
+/*---------------------------------------------------------------------------*/
+
+void GillespieReactionNetwork::compute_fast_pairs(double ratio)
+{
+    std::cerr << time::time_stamp() << "finding fast reversible pairs...\n";
+
+    fast_pairs.compute(*this, initial_state, ratio);
+
+    std::cerr << time::time_stamp() << fast_pairs.size()
+              << " fast reversible pairs\n";
+} // compute_fast_pairs()
 
-    for (int species_id : species_of_interest)
+/*---------------------------------------------------------------------------*/
+
+void GillespieReactionNetwork::compute_highest_reactant_orders()
+{
+    highest_reactant_order.assign(initial_state.size(), 0);
+
+    for (unsigned long int i = 0; i < reactions.size(); i++)
     {
-        for (unsigned int reaction_index : dependents[species_id])
-        {
+        const SpeciesIndex *reactants = &reactions.reactants[2 * i];
+        int number_of_reactants = reactions.number_of_reactants[i];
 
-            double new_propensity = compute_propensity(
-                state,
-                reaction_index);
+        for (int k = 0; k < number_of_reactants; k++)
+        {
+            uint8_t order = number_of_reactants;
+            if (number_of_reactants == 2 && reactants[0] == reactants[1])
+                order = 3;
 
-            update_function(Update{
-                .index = reaction_index,
-                .propensity = new_propensity});
+            uint8_t &highest = highest_reactant_order[reactants[k]];
+            highest = std::max(highest, order);
         }
     }
-} // update_propensities()
+} // compute_highest_reactant_orders()
+
+/*---------------------------------------------------------------------------*/
+
+// number of firings recorded by a trajectory row
+inline int trajectory_row_count(ReactionNetworkReadTrajectoriesSql &)
+{
+    return 1;
+} // trajectory_row_count()
+
+inline int trajectory_row_count(ReactionNetworkReadLeapTrajectoriesSql &row)
+{
+    return row.count;
+} // trajectory_row_count()
 
 /*---------------------------------------------------------------------------*/
 
+template <typename ReadTrajectoriesSql>
 void GillespieReactionNetwork::checkpoint(SqlReader<ReactionNetworkReadStateSql> state_reader,
                                           SqlReader<ReadCutoffSql> cutoff_reader,
-                                          SqlReader<ReactionNetworkReadTrajectoriesSql> trajectory_reader,
-                                          std::map<int, std::vector<int>> &temp_seed_state_map,
+                                          SqlReader<ReadTrajectoriesSql> trajectory_reader,
+                                          SeedStateStore<std::vector<int>> &temp_seed_state_map,
                                           std::map<int, int> &temp_seed_step_map,
-                                          SeedQueue &temp_seed_queue,
                                           std::map<int, double> &temp_seed_time_map,
                                           GillespieReactionNetwork &model)
 {
 
     bool read_interrupt_states = false;
-    std::vector<int> default_state = model.initial_state;
-
-    while (std::optional<unsigned long int> maybe_seed =
-               temp_seed_queue.get_seed())
-    {
-        unsigned long int seed = maybe_seed.value();
-        temp_seed_state_map.insert(std::make_pair(seed, default_state));
-    }
 
     while (std::optional<ReadCutoffSql> maybe_cutoff_row = cutoff_reader.next())
     {
@@ -229,28 +373,31 @@ void GillespieReactionNetwork::checkpoint(SqlReader<ReactionNetworkReadStateSql>
 
     if (!read_interrupt_states && isCheckpoint)
     {
-        while (std::optional<ReactionNetworkReadTrajectoriesSql> maybe_trajectory_row = trajectory_reader.next())
+        while (std::optional<ReadTrajectoriesSql> maybe_trajectory_row = trajectory_reader.next())
         {
 
-            ReactionNetworkReadTrajectoriesSql trajectory_row = maybe_trajectory_row.value();
+            ReadTrajectoriesSql trajectory_row = maybe_trajectory_row.value();
+            int count = trajectory_row_count(trajectory_row);
 
             GillespieReaction reaction = model.reactions[trajectory_row.reaction_id];
             // update reactants
             for (int i = 0; i < reaction.number_of_reactants; i++)
             {
                 temp_seed_state_map[trajectory_row.seed][reaction.reactants[i]] =
-                    temp_seed_state_map[trajectory_row.seed][reaction.reactants[i]] - 1;
+                    temp_seed_state_map[trajectory_row.seed][reaction.reactants[i]] - count;
             }
             // update products
             for (int i = 0; i < reaction.number_of_products; i++)
             {
                 temp_seed_state_map[trajectory_row.seed][reaction.products[i]] =
-                    temp_seed_state_map[trajectory_row.seed][reaction.products[i]] + 1;
+                    temp_seed_state_map[trajectory_row.seed][reaction.products[i]] + count;
             }
 
-            if (trajectory_row.step > temp_seed_step_map[trajectory_row.seed])
+            // the step of the last firing in the row
+            int last_step = trajectory_row.step + count - 1;
+            if (last_step > temp_seed_step_map[trajectory_row.seed])
             {
-                temp_seed_step_map[trajectory_row.seed] = trajectory_row.step;
+                temp_seed_step_map[trajectory_row.seed] = last_step;
                 temp_seed_time_map[trajectory_row.seed] = trajectory_row.time;
             }
         }
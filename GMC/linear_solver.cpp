@@ -14,7 +14,7 @@ See the README file in the top-level RNMC directory.
 
 // LinearSolver can opperate directly on the passed propensities using a move
 LinearSolver::LinearSolver(
-    unsigned long int seed,
+    SamplerSeed seed,
     std::vector<double> &&initial_propensities) : sampler(Sampler(seed)),
                                                   // if this move isn't here, the semantics is that initial
                                                   // propensities gets moved into a stack variable for the function
@@ -37,7 +37,7 @@ LinearSolver::LinearSolver(
 /*---------------------------------------------------------------------------*/
 
 LinearSolver::LinearSolver(
-    unsigned long int seed,
+    SamplerSeed seed,
     std::vector<double> &initial_propensities) : sampler(Sampler(seed)),
                                                  propensities(initial_propensities),
                                                  number_of_active_indices(0),
@@ -77,7 +77,7 @@ void LinearSolver::update(Update update)
 
 /*---------------------------------------------------------------------------*/
 
-void LinearSolver::update(std::vector<Update> updates)
+void LinearSolver::update(std::vector<Update> &updates)
 {
     for (Update u : updates)
     {
@@ -96,7 +96,8 @@ std::optional<Event> LinearSolver::event()
     }
 
     double r1 = sampler.generate();
-    double r2 = sampler.generate();
+    double waiting_time = sampler.exponential();
+    sampler.next_step();
     double fraction = propensity_sum * r1;
     double partial = 0.0;
 
@@ -109,7 +110,7 @@ std::optional<Event> LinearSolver::event()
             break;
     }
 
-    double dt = -std::log(r2) / propensity_sum;
+    double dt = waiting_time / propensity_sum;
     if (m < propensities.size())
         return std::optional<Event>(Event{.index = m, .dt = dt});
     else
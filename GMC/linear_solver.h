@@ -37,11 +37,11 @@ public:
     // for linear solver we can moves initial_propensities vector into the object
     // and use it as the propensity buffer. For compatibility with other solvers,
     // we also implement initialization by copying from a reference
-    LinearSolver(unsigned long int seed, std::vector<double> &&initial_propensities);
-    LinearSolver(unsigned long int seed, std::vector<double> &initial_propensities);
+    LinearSolver(SamplerSeed seed, std::vector<double> &&initial_propensities);
+    LinearSolver(SamplerSeed seed, std::vector<double> &initial_propensities);
     LinearSolver() : sampler(Sampler(0)){}; 
     void update(Update update);
-    void update(std::vector<Update> updates);
+    void update(std::vector<Update> &updates);
     std::optional<Event> event();
     double get_propensity(int index);
     double get_propensity_sum();
@@ -0,0 +1,165 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include "next_reaction_solver.h"
+
+NextReactionSolver::NextReactionSolver(
+    SamplerSeed seed,
+    std::vector<double> &initial_propensities) : sampler(Sampler(seed)),
+                                                 propensities(initial_propensities),
+                                                 firing_times(initial_propensities.size()),
+                                                 heap(initial_propensities.size()),
+                                                 position(initial_propensities.size()),
+                                                 time(0.0),
+                                                 number_of_active_indices(0),
+                                                 propensity_sum(0.0)
+{
+    for (unsigned long int i = 0; i < propensities.size(); i++)
+    {
+        propensity_sum += propensities[i];
+        if (propensities[i] > 0.0)
+            number_of_active_indices++;
+
+        firing_times[i] = draw_firing_time(propensities[i]);
+        heap[i] = i;
+        position[i] = i;
+    }
+
+    // heapify bottom up
+    for (unsigned long int i = heap.size() / 2; i-- > 0;)
+        sift_down(i);
+} // NextReactionSolver()
+
+/*---------------------------------------------------------------------------*/
+
+void NextReactionSolver::swap_nodes(unsigned long int i, unsigned long int j)
+{
+    std::swap(heap[i], heap[j]);
+    position[heap[i]] = i;
+    position[heap[j]] = j;
+} // swap_nodes()
+
+/*---------------------------------------------------------------------------*/
+
+void NextReactionSolver::sift_up(unsigned long int i)
+{
+    while (i > 0)
+    {
+        unsigned long int parent = (i - 1) / 2;
+        if (firing_times[heap[parent]] <= firing_times[heap[i]])
+            break;
+
+        swap_nodes(i, parent);
+        i = parent;
+    }
+} // sift_up()
+
+/*---------------------------------------------------------------------------*/
+
+void NextReactionSolver::sift_down(unsigned long int i)
+{
+    unsigned long int size = heap.size();
+    while (true)
+    {
+        unsigned long int smallest = i;
+        unsigned long int left = 2 * i + 1;
+        unsigned long int right = 2 * i + 2;
+
+        if (left < size && firing_times[heap[left]] < firing_times[heap[smallest]])
+            smallest = left;
+        if (right < size && firing_times[heap[right]] < firing_times[heap[smallest]])
+            smallest = right;
+
+        if (smallest == i)
+            break;
+
+        swap_nodes(i, smallest);
+        i = smallest;
+    }
+} // sift_down()
+
+/*---------------------------------------------------------------------------*/
+
+void NextReactionSolver::update(Update update)
+{
+    double old_propensity = propensities[update.index];
+    double new_propensity = update.propensity;
+
+    if (old_propensity > 0.0)
+        number_of_active_indices--;
+    if (new_propensity > 0.0)
+        number_of_active_indices++;
+
+    propensity_sum -= old_propensity;
+    propensity_sum += new_propensity;
+    propensities[update.index] = new_propensity;
+
+    double &firing_time = firing_times[update.index];
+    double old_firing_time = firing_time;
+
+    if (new_propensity <= 0.0)
+        firing_time = std::numeric_limits<double>::infinity();
+    else if (old_propensity <= 0.0)
+        // a reaction switched on has no time to rescale
+        firing_time = draw_firing_time(new_propensity);
+    else if (new_propensity != old_propensity)
+        firing_time = time + (old_propensity / new_propensity) * (firing_time - time);
+
+    if (firing_time < old_firing_time)
+        sift_up(position[update.index]);
+    else if (firing_time > old_firing_time)
+        sift_down(position[update.index]);
+} // update()
+
+/*---------------------------------------------------------------------------*/
+
+void NextReactionSolver::update(std::vector<Update> &updates)
+{
+    for (Update u : updates)
+    {
+        update(u);
+    }
+} // update()
+
+/*---------------------------------------------------------------------------*/
+
+std::optional<Event> NextReactionSolver::event()
+{
+    if (number_of_active_indices == 0)
+    {
+        propensity_sum = 0.0;
+        return std::optional<Event>();
+    }
+
+    unsigned long int m = heap[0];
+    double dt = firing_times[m] - time;
+    time = firing_times[m];
+
+    // the fired reaction draws its next time with its current
+    // propensity. If the step changes that propensity, the update
+    // rescales the fresh time like any other, which by the memoryless
+    // property of the exponential is the same as drawing it afresh.
+    firing_times[m] = draw_firing_time(propensities[m]);
+    sift_down(0);
+    sampler.next_step();
+
+    return std::optional<Event>(Event{.index = m, .dt = dt});
+} // event()
+
+/*---------------------------------------------------------------------------*/
+
+double NextReactionSolver::get_propensity(int index)
+{
+    return propensities[index];
+} // get_propensity()
+
+/*---------------------------------------------------------------------------*/
+
+double NextReactionSolver::get_propensity_sum()
+{
+    return propensity_sum;
+} // get_propensity_sum()
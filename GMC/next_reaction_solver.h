@@ -0,0 +1,66 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_NEXT_REACTION_SOLVER_H
+#define RNMC_NEXT_REACTION_SOLVER_H
+
+#include <vector>
+#include <optional>
+#include <cmath>
+#include <limits>
+
+#include "../core/sampler.h"
+#include "../core/RNMC_types.h"
+
+// next reaction method from Gibson and Bruck, J. Phys. Chem. A 104, 1876
+// (2000). Every reaction carries the absolute time at which it would
+// next fire, and the times are kept in a binary min heap together with
+// the position of each reaction in the heap. An event is the root of
+// the heap, after which only the fired reaction draws a new time, so a
+// step costs one random number rather than two.
+//
+// when the propensity of a reaction changes from a_old to a_new, its
+// time t_old is rescaled to time + (a_old / a_new) * (t_old - time)
+// instead of being redrawn, and the reaction is moved up or down the
+// heap. A reaction with zero propensity has an infinite time and sinks
+// to the bottom. Updates and events are both O(log N).
+
+class NextReactionSolver
+{
+private:
+    Sampler sampler;
+    std::vector<double> propensities;
+    std::vector<double> firing_times; // absolute firing time of each reaction
+    std::vector<unsigned long int> heap;     // reactions ordered by firing time
+    std::vector<unsigned long int> position; // position of each reaction in heap
+    double time;                             // time of the last event
+    int number_of_active_indices;
+    double propensity_sum;
+
+    double draw_firing_time(double propensity)
+    {
+        if (propensity > 0.0)
+            return time + sampler.exponential() / propensity;
+        else
+            return std::numeric_limits<double>::infinity();
+    };
+
+    void swap_nodes(unsigned long int i, unsigned long int j);
+    void sift_up(unsigned long int i);
+    void sift_down(unsigned long int i);
+
+public:
+    NextReactionSolver() : sampler(Sampler(0)){};
+    NextReactionSolver(SamplerSeed seed, std::vector<double> &initial_propensities);
+    void update(Update update);
+    void update(std::vector<Update> &updates);
+    std::optional<Event> event();
+    double get_propensity(int index);
+    double get_propensity_sum();
+};
+
+#endif
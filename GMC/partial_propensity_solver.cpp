@@ -0,0 +1,205 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include <algorithm>
+
+#include "partial_propensity_solver.h"
+
+PartialPropensitySolver::PartialPropensitySolver(
+    SamplerSeed seed,
+    const ReactantGroups &groups,
+    const std::vector<int> &state) : sampler(Sampler(seed)),
+                                     groups(&groups),
+                                     partial(groups.number_of_groups()),
+                                     row_sum(groups.number_of_species + 1),
+                                     row_propensity(groups.number_of_species + 1),
+                                     updates_since_refresh(0)
+{
+    refresh(state);
+} // PartialPropensitySolver()
+
+/*---------------------------------------------------------------------------*/
+
+double PartialPropensitySolver::compute_partial(
+    unsigned long int group,
+    const std::vector<int> &state)
+{
+    int partner = groups->partner[group];
+
+    if (partner < 0)
+        return groups->rate[group];
+    else if (partner == groups->row[group])
+        return groups->rate[group] * std::max(state[partner] - 1, 0);
+    else
+        return groups->rate[group] * state[partner];
+} // compute_partial()
+
+/*---------------------------------------------------------------------------*/
+
+void PartialPropensitySolver::refresh(const std::vector<int> &state)
+{
+    for (unsigned long int row = 0; row <= groups->number_of_species; row++)
+    {
+        double sum = 0.0;
+        for (unsigned long int g = groups->row_offsets[row];
+             g < groups->row_offsets[row + 1];
+             g++)
+        {
+            partial[g] = compute_partial(g, state);
+            sum += partial[g];
+        }
+
+        row_sum[row] = sum;
+        row_propensity[row] = count(row, state) * sum;
+    }
+
+    updates_since_refresh = 0;
+} // refresh()
+
+/*---------------------------------------------------------------------------*/
+
+void PartialPropensitySolver::update(
+    const std::vector<int> &state,
+    const int *species,
+    int number_of_species)
+{
+    if (++updates_since_refresh == partial_propensity_refresh_interval)
+    {
+        refresh(state);
+        return;
+    }
+
+    for (int k = 0; k < number_of_species; k++)
+    {
+        int species_id = species[k];
+
+        // groups whose partial propensity depends on this species
+        for (int g : groups->partner_groups[species_id])
+        {
+            double new_partial = compute_partial(g, state);
+            int row = groups->row[g];
+
+            row_sum[row] += new_partial - partial[g];
+            partial[g] = new_partial;
+            row_propensity[row] = std::max(0.0, count(row, state) * row_sum[row]);
+        }
+
+        // the row of the species itself
+        row_propensity[species_id] =
+            std::max(0.0, count(species_id, state) * row_sum[species_id]);
+    }
+} // update()
+
+/*---------------------------------------------------------------------------*/
+
+std::optional<Event> PartialPropensitySolver::event(const std::vector<int> &state)
+{
+    // rounding in the row sums can leave a row which looks active but has
+    // no group with a positive partial propensity. If that row is picked,
+    // the sums are recomputed exactly and the selection repeated.
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        double propensity_sum = get_propensity_sum();
+        if (propensity_sum <= 0.0)
+            return std::optional<Event>();
+
+        double r1 = sampler.generate();
+        double waiting_time = sampler.exponential();
+        double fraction = propensity_sum * r1;
+
+        // pick a row
+        unsigned long int number_of_rows = groups->number_of_species + 1;
+        unsigned long int row = number_of_rows;
+        unsigned long int last_active_row = number_of_rows;
+        double cumulative = 0.0;
+        for (unsigned long int i = 0; i < number_of_rows; i++)
+        {
+            if (row_propensity[i] <= 0.0)
+                continue;
+
+            last_active_row = i;
+            cumulative += row_propensity[i];
+            if (cumulative > fraction)
+            {
+                row = i;
+                fraction -= cumulative - row_propensity[i];
+                break;
+            }
+        }
+
+        if (row == number_of_rows)
+        {
+            row = last_active_row;
+            fraction = row_propensity[row];
+        }
+
+        // pick a group in the row. Dividing by the row count turns the
+        // remaining fraction into a fraction of the row sum.
+        fraction /= count(row, state);
+
+        unsigned long int first_group = groups->row_offsets[row];
+        unsigned long int end_group = groups->row_offsets[row + 1];
+        unsigned long int group = end_group;
+        unsigned long int last_active_group = end_group;
+        cumulative = 0.0;
+        for (unsigned long int g = first_group; g < end_group; g++)
+        {
+            if (partial[g] <= 0.0)
+                continue;
+
+            last_active_group = g;
+            cumulative += partial[g];
+            if (cumulative > fraction)
+            {
+                group = g;
+                fraction -= cumulative - partial[g];
+                break;
+            }
+        }
+
+        if (last_active_group == end_group)
+        {
+            refresh(state);
+            continue;
+        }
+
+        if (group == end_group)
+        {
+            group = last_active_group;
+            fraction = partial[group];
+        }
+
+        // pick a reaction in the group in proportion to its rate
+        double target = std::min(fraction / partial[group], 1.0) * groups->rate[group];
+
+        const double *first = groups->cumulative_rate.data() + groups->reactions.offsets[group];
+        const double *last = groups->cumulative_rate.data() + groups->reactions.offsets[group + 1];
+        const double *chosen = std::min(std::upper_bound(first, last, target), last - 1);
+
+        unsigned long int index =
+            groups->reactions.entries[groups->reactions.offsets[group] + (chosen - first)];
+
+        sampler.next_step();
+        double dt = waiting_time / propensity_sum;
+        return std::optional<Event>(Event{.index = index, .dt = dt});
+    }
+
+    return std::optional<Event>();
+} // event()
+
+/*---------------------------------------------------------------------------*/
+
+double PartialPropensitySolver::get_propensity_sum()
+{
+    // the number of rows is the number of species, which is small in the
+    // networks this solver is meant for
+    double sum = 0.0;
+    for (double propensity : row_propensity)
+        sum += propensity;
+
+    return sum;
+} // get_propensity_sum()
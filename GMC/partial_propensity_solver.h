@@ -0,0 +1,71 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+
+-------------------------------------------------------------------------
+
+The partial propensity solver implements the partial propensity direct
+method for networks with few species and many reactions. Rather than a
+propensity per reaction it keeps a partial propensity per group of
+reactions sharing their reactants (see reactant_groups.h), so its
+memory per simulation and its work per step scale with the number of
+distinct reactant pairs, which is at most quadratic in the number of
+species, rather than with the number of reactions.
+
+Unlike the other solvers it reads species counts directly, so it is
+driven by PartialPropensitySimulation rather than ReactionNetworkSimulation.
+
+------------------------------------------------------------------------- */
+
+#ifndef RNMC_PARTIAL_PROPENSITY_SOLVER_H
+#define RNMC_PARTIAL_PROPENSITY_SOLVER_H
+
+#include "../core/sampler.h"
+#include "../core/RNMC_types.h"
+#include "reactant_groups.h"
+
+#include <vector>
+#include <optional>
+#include <cmath>
+
+// row sums are updated by differences. They are recomputed from the
+// partial propensities this often to stop rounding errors building up.
+constexpr unsigned long int partial_propensity_refresh_interval = 1ul << 16;
+
+class PartialPropensitySolver
+{
+private:
+    Sampler sampler;
+    const ReactantGroups *groups;
+    std::vector<double> partial;        // partial propensity of each group
+    std::vector<double> row_sum;        // sum of the partial propensities in each row
+    std::vector<double> row_propensity; // row species count times row_sum
+    unsigned long int updates_since_refresh;
+
+    double count(unsigned long int row, const std::vector<int> &state)
+    {
+        return row == groups->number_of_species ? 1.0 : state[row];
+    };
+
+    double compute_partial(unsigned long int group, const std::vector<int> &state);
+    void refresh(const std::vector<int> &state);
+
+public:
+    PartialPropensitySolver(SamplerSeed seed,
+                            const ReactantGroups &groups,
+                            const std::vector<int> &state);
+    PartialPropensitySolver() : sampler(Sampler(0)), groups(nullptr) {};
+
+    // state has already been changed by the last event, and species
+    // lists the species whose counts changed
+    void update(const std::vector<int> &state,
+                const int *species,
+                int number_of_species);
+
+    std::optional<Event> event(const std::vector<int> &state);
+    double get_propensity_sum();
+};
+
+#endif
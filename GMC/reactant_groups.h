@@ -0,0 +1,158 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_REACTANT_GROUPS_H
+#define RNMC_REACTANT_GROUPS_H
+
+#include <vector>
+#include <algorithm>
+
+#include "reaction_network.h"
+
+// reactions grouped by their reactants, for the partial propensity
+// solver. Every reaction in a group has a propensity proportional to its
+// rate, so the propensity of a group is a function of at most two
+// species counts times the summed rates, and a reaction can be picked
+// from its group by rate alone.
+//
+// each group lives in the row of its first reactant. Following the
+// partial propensity direct method (Ramaswamy, Gonzalez-Segredo and
+// Sbalzarini, J. Chem. Phys. 130, 244104 (2009)), the propensity of a
+// group is the count of its row species times its partial propensity:
+//
+//     no reactants    row number_of_species   partial = factor_zero * rate
+//     A               row A                   partial = rate
+//     A + B, A < B    row A                   partial = factor_two * rate * n_B
+//     A + A           row A                   partial = factor_duplicate * factor_two * rate * (n_A - 1)
+//
+// the extra row number_of_species holds reactions without reactants and
+// behaves as a species whose count is always 1.
+struct ReactantGroups
+{
+    unsigned long int number_of_species;
+
+    std::vector<int> row;     // row of each group
+    std::vector<int> partner; // second reactant of each group, -1 if it has none
+    std::vector<double> rate; // summed rates of each group including the factors
+
+    // groups are numbered in row order, so the groups of row i are
+    // row_offsets[i] up to row_offsets[i + 1]
+    std::vector<unsigned long int> row_offsets;
+
+    // reactions of each group, and the running sum of their rates
+    // (including the factors) within the group
+    DependencyGraph reactions;
+    std::vector<double> cumulative_rate;
+
+    // maps a species to the groups whose partial propensity depends on
+    // its count, which are the groups it is the second reactant of
+    DependencyGraph partner_groups;
+
+    unsigned long int number_of_groups() const { return partner.size(); };
+
+    template <typename Reaction>
+    void compute(ReactionNetwork<Reaction> &reaction_network,
+                 unsigned long int number_of_species);
+};
+
+/*---------------------------------------------------------------------------*/
+
+template <typename Reaction>
+void ReactantGroups::compute(ReactionNetwork<Reaction> &reaction_network,
+                             unsigned long int number_of_species)
+{
+    this->number_of_species = number_of_species;
+    ReactionArrays<Reaction> &network_reactions = reaction_network.reactions;
+    unsigned long int number_of_reactions = network_reactions.size();
+
+    // the row and partner of each reaction
+    auto key = [&](int reaction_id)
+    {
+        const SpeciesIndex *reactants = &network_reactions.reactants[2 * reaction_id];
+        switch (network_reactions.number_of_reactants[reaction_id])
+        {
+        case 0:
+            return std::make_pair((long int)number_of_species, -1l);
+        case 1:
+            return std::make_pair((long int)reactants[0], -1l);
+        default:
+            return std::make_pair((long int)std::min(reactants[0], reactants[1]),
+                                  (long int)std::max(reactants[0], reactants[1]));
+        }
+    };
+
+    std::vector<int> order(number_of_reactions);
+    for (unsigned long int i = 0; i < number_of_reactions; i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+                     { return key(a) < key(b); });
+
+    row.clear();
+    partner.clear();
+    rate.clear();
+    row_offsets.assign(number_of_species + 2, 0);
+    reactions.offsets.assign(1, 0);
+    reactions.entries = order;
+    cumulative_rate.resize(number_of_reactions);
+
+    // walk the sorted reactions, starting a new group whenever the key
+    // changes. order is sorted by row, so the groups come out in row
+    // order too.
+    for (unsigned long int i = 0; i < number_of_reactions; i++)
+    {
+        int reaction_id = order[i];
+        auto [group_row, group_partner] = key(reaction_id);
+
+        if (i == 0 || key(order[i - 1]) != std::make_pair(group_row, group_partner))
+        {
+            if (i > 0)
+                reactions.offsets.push_back(i);
+            row.push_back(group_row);
+            partner.push_back(group_partner);
+            rate.push_back(0.0);
+            row_offsets[group_row + 1]++;
+        }
+
+        double factor;
+        if (group_row == (long int)number_of_species)
+            factor = reaction_network.factor_zero;
+        else if (group_partner < 0)
+            factor = 1.0;
+        else if (group_partner == group_row)
+            factor = reaction_network.factor_duplicate * reaction_network.factor_two;
+        else
+            factor = reaction_network.factor_two;
+
+        rate.back() += factor * network_reactions.rate[reaction_id];
+        cumulative_rate[i] = rate.back();
+    }
+    if (number_of_reactions > 0)
+        reactions.offsets.push_back(number_of_reactions);
+
+    for (unsigned long int i = 0; i <= number_of_species; i++)
+        row_offsets[i + 1] += row_offsets[i];
+
+    // partner_groups by counting sort, the same way as compute_dependents
+    partner_groups.offsets.assign(number_of_species + 1, 0);
+    for (int species_id : partner)
+        if (species_id >= 0)
+            partner_groups.offsets[species_id + 1]++;
+
+    for (unsigned long int i = 0; i < number_of_species; i++)
+        partner_groups.offsets[i + 1] += partner_groups.offsets[i];
+
+    partner_groups.entries.resize(partner_groups.offsets[number_of_species]);
+    std::vector<unsigned long int> next(partner_groups.offsets.begin(),
+                                        partner_groups.offsets.end() - 1);
+
+    for (unsigned long int g = 0; g < partner.size(); g++)
+        if (partner[g] >= 0)
+            partner_groups.entries[next[partner[g]]++] = g;
+} // compute()
+
+#endif
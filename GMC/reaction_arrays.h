@@ -0,0 +1,164 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_REACTION_ARRAYS_H
+#define RNMC_REACTION_ARRAYS_H
+
+#include <stdint.h>
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <iostream>
+#include <type_traits>
+
+#include "../core/sql.h"
+
+// compiling with -DCOMPACT_REACTIONS ("make compact") stores rates and
+// dG as floats and species ids as 16 bit integers, which roughly halves
+// the memory taken by the reactions. Networks with more than
+// max_compact_species species are rejected when they are loaded, as are
+// networks with a rate or dG which a float can't hold: magnitudes above
+// FLT_MAX, or non-zero magnitudes below FLT_MIN, which would become
+// denormals or 0 and quietly stop a reaction from firing.
+#ifdef COMPACT_REACTIONS
+using ReactionReal = float;
+using SpeciesIndex = uint16_t;
+#else
+using ReactionReal = double;
+using SpeciesIndex = int;
+#endif
+
+constexpr unsigned long int max_compact_species = 1ul << 16;
+
+// true for reaction types with a dG member
+template <typename Reaction, typename = void>
+struct has_dG : std::false_type
+{
+};
+
+template <typename Reaction>
+struct has_dG<Reaction, std::void_t<decltype(Reaction::dG)>> : std::true_type
+{
+};
+
+// reactions stored as a structure of arrays. The propensity and state
+// update kernels read the arrays directly, so a step only pulls in the
+// fields it needs instead of whole padded reactions. Reactants and
+// products take two slots per reaction each, slot 2 * i + k holding
+// the k-th reactant or product of reaction i.
+//
+// reactions[i] assembles the i-th reaction as a Reaction, which is
+// convenient where speed doesn't matter.
+template <typename Reaction>
+class ReactionArrays
+{
+public:
+    std::vector<uint8_t> number_of_reactants;
+    std::vector<uint8_t> number_of_products;
+    std::vector<SpeciesIndex> reactants;
+    std::vector<SpeciesIndex> products;
+    std::vector<ReactionReal> rate;
+    std::vector<ReactionReal> dG; // empty unless Reaction has a dG
+
+    unsigned long int size() const { return rate.size(); };
+
+    void resize(unsigned long int number_of_reactions,
+                unsigned long int number_of_species)
+    {
+#ifdef COMPACT_REACTIONS
+        if (number_of_species > max_compact_species)
+        {
+            std::cerr << time::time_stamp()
+                      << "network has " << number_of_species
+                      << " species, more than the " << max_compact_species
+                      << " supported by a COMPACT_REACTIONS build\n";
+            std::abort();
+        }
+#else
+        (void)number_of_species;
+#endif
+
+        number_of_reactants.resize(number_of_reactions);
+        number_of_products.resize(number_of_reactions);
+        reactants.resize(2 * number_of_reactions);
+        products.resize(2 * number_of_reactions);
+        rate.resize(number_of_reactions);
+        if constexpr (has_dG<Reaction>::value)
+            dG.resize(number_of_reactions);
+    };
+
+    void set(unsigned long int i, const Reaction &reaction)
+    {
+        number_of_reactants[i] = reaction.number_of_reactants;
+        number_of_products[i] = reaction.number_of_products;
+
+        // unused slots are left as 0 so that they are valid species ids
+        for (int k = 0; k < 2; k++)
+        {
+            reactants[2 * i + k] =
+                k < reaction.number_of_reactants ? reaction.reactants[k] : 0;
+            products[2 * i + k] =
+                k < reaction.number_of_products ? reaction.products[k] : 0;
+        }
+
+        rate[i] = to_reaction_real(reaction.rate, "rate", i);
+        if constexpr (has_dG<Reaction>::value)
+            dG[i] = to_reaction_real(reaction.dG, "dG", i);
+    };
+
+    static ReactionReal to_reaction_real(double value, const char *name,
+                                         unsigned long int i)
+    {
+#ifdef COMPACT_REACTIONS
+        double magnitude = std::abs(value);
+        if (std::isfinite(value) &&
+            (magnitude > FLT_MAX || (magnitude != 0.0 && magnitude < FLT_MIN)))
+        {
+            std::cerr << time::time_stamp()
+                      << "reaction " << i << " has " << name << " " << value
+                      << ", outside the float range supported by a"
+                      << " COMPACT_REACTIONS build\n";
+            std::abort();
+        }
+#else
+        (void)name;
+        (void)i;
+#endif
+        return value;
+    };
+
+    Reaction operator[](unsigned long int i) const
+    {
+        Reaction reaction{};
+        reaction.number_of_reactants = number_of_reactants[i];
+        reaction.number_of_products = number_of_products[i];
+
+        for (int k = 0; k < 2; k++)
+        {
+            reaction.reactants[k] =
+                k < reaction.number_of_reactants ? reactants[2 * i + k] : -1;
+            reaction.products[k] =
+                k < reaction.number_of_products ? products[2 * i + k] : -1;
+        }
+
+        reaction.rate = rate[i];
+        if constexpr (has_dG<Reaction>::value)
+            reaction.dG = dG[i];
+
+        return reaction;
+    };
+
+    unsigned long int bytes() const
+    {
+        return number_of_reactants.size() + number_of_products.size() +
+               (reactants.size() + products.size()) * sizeof(SpeciesIndex) +
+               (rate.size() + dG.size()) * sizeof(ReactionReal);
+    };
+};
+
+#endif
@@ -13,16 +13,67 @@ See the README file in the top-level RNMC directory.
 #include <optional>
 #include <mutex>
 #include <map>
+#include <algorithm>
+#include <numeric>
+#include <atomic>
+#include <iostream>
 #include <assert.h>
 
 #include "sql_types.h"
+#include "reaction_arrays.h"
 #include "../core/sql.h"
 #include "../core/RNMC_types.h"
 #include "../core/sql_types.h"
 #include "../core/queues.h"
+#include "../core/parallel.h"
+#include "../core/model_cache.h"
 
 #include <vector>
 
+// the precomputed reaction to reaction graph is skipped if it would take
+// more memory than this. See ReactionNetwork::compute_affected.
+constexpr unsigned long int default_max_dependency_graph_bytes = 1ul << 30;
+
+// adjacency lists stored in compressed sparse row form. Row i is
+// entries[offsets[i]] up to entries[offsets[i + 1]], so the whole graph
+// is two allocations no matter how many rows it has.
+struct DependencyGraph
+{
+    std::vector<unsigned long int> offsets;
+    std::vector<int> entries;
+
+    struct Row
+    {
+        const int *first;
+        const int *last;
+
+        const int *begin() const { return first; };
+        const int *end() const { return last; };
+        unsigned long int size() const { return last - first; };
+        bool empty() const { return first == last; };
+        int operator[](unsigned long int i) const { return first[i]; };
+    };
+
+    unsigned long int size() const
+    {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    };
+
+    bool empty() const { return entries.empty(); };
+
+    Row operator[](unsigned long int i) const
+    {
+        return Row{.first = entries.data() + offsets[i],
+                   .last = entries.data() + offsets[i + 1]};
+    };
+
+    unsigned long int bytes() const
+    {
+        return offsets.size() * sizeof(unsigned long int) +
+               entries.size() * sizeof(int);
+    };
+};
+
 template <typename Reaction>
 class ReactionNetwork
 {
@@ -32,8 +83,19 @@ public:
     double factor_duplicate; // rate modifier for reactions of form A + A -> ...
 
     // maps species to the reactions which involve that species
-    std::vector<std::vector<int>> dependents;
-    std::vector<Reaction> reactions;
+    DependencyGraph dependents;
+
+    // maps each reaction to the sorted, deduplicated list of reactions
+    // whose propensity can change when it fires. Empty when it would
+    // not fit in the memory budget, in which case the lists are
+    // assembled from dependents on every step instead.
+    DependencyGraph affected;
+    ReactionArrays<Reaction> reactions;
+
+    // propensities of the initial state, computed once when the network
+    // is loaded. Seeds which start from the initial state build their
+    // solvers from these instead of computing their own.
+    std::vector<double> initial_state_propensities;
 
     bool isCheckpoint; // write state, cutoff, trajectories while running or if error
 
@@ -43,7 +105,34 @@ public:
         SqlConnection &reaction_network_database,
         SqlConnection &initial_state_database);
 
-    void compute_dependents();
+    // read every row of the reactions table into reactions, which must
+    // already have its final size. The rows are split by reaction_id
+    // into one range per thread and each range is read on its own
+    // connection. to_reaction converts a ReactionRow into a Reaction.
+    template <typename ReactionRow, typename ToReaction>
+    void load_reactions(SqlConnection &reaction_network_database,
+                        int thread_count,
+                        ToReaction to_reaction);
+
+    void compute_dependents(unsigned long int number_of_species,
+                            int thread_count = 1);
+
+    void compute_affected(unsigned long int max_bytes, int thread_count = 1);
+
+    // the reactions and dependency graphs, which are everything built
+    // from the network database. See core/model_cache.h.
+    void write_cache(ModelCacheWriter &cache);
+    bool read_cache(ModelCacheReader &cache);
+
+    // the species whose counts change when reaction_index fires, each
+    // listed once. Returns how many were written to species.
+    int changed_species(int reaction_index, int species[4]);
+
+    // call visit(index) once for every reaction whose propensity can
+    // change when next_reaction fires, in increasing order of index
+    // when the affected graph has been computed
+    template <typename Visit>
+    void for_each_affected(int next_reaction, Visit visit);
 
     double compute_propensity(
         std::vector<int> &state,
@@ -53,7 +142,9 @@ public:
         std::vector<int> &state,
         int reaction_index);
 
-    void compute_initial_propensities(std::vector<int> state, std::vector<double> &initial_propensities);
+    void compute_initial_propensities(std::vector<int> state,
+                                      std::vector<double> &initial_propensities,
+                                      int thread_count = 1);
 
     // convert a history element as found a simulation to history
     // to a SQL type.
@@ -61,6 +152,10 @@ public:
         int seed,
         ReactionNetworkTrajectoryHistoryElement history_element);
 
+    ReactionNetworkWriteLeapTrajectoriesSql history_element_to_sql(
+        int seed,
+        ReactionNetworkLeapHistoryElement history_element);
+
     ReactionNetworkWriteStateSql state_history_element_to_sql(
         int seed,
         ReactionNetworkStateHistoryElement history_element);
@@ -72,56 +167,345 @@ ReactionNetwork<Reaction>::ReactionNetwork() {} // ReactionNetwork()
 /*---------------------------------------------------------------------------*/
 
 template <typename Reaction>
-void ReactionNetwork<Reaction>::compute_dependents()
+template <typename ReactionRow, typename ToReaction>
+void ReactionNetwork<Reaction>::load_reactions(
+    SqlConnection &reaction_network_database,
+    int thread_count,
+    ToReaction to_reaction)
 {
+    parallel_ranges(thread_count, reactions.size(),
+                    [&](int range, unsigned long int begin, unsigned long int end)
+                    {
+        // sqlite connections can't be shared between threads, so every
+        // range but the first opens its own
+        std::optional<SqlConnection> range_connection;
+        if (range > 0)
+            range_connection.emplace(reaction_network_database.database_file_path,
+                                     SQLITE_OPEN_READONLY);
+
+        SqlStatement<ReactionRow> reaction_statement(
+            range > 0 ? range_connection.value() : reaction_network_database,
+            ReactionRow::range_sql_statement(begin, end));
+        SqlReader<ReactionRow> reaction_reader(reaction_statement);
+
+        // every reaction_id is in exactly one range, so the ranges write
+        // to disjoint slots of reactions
+        while (std::optional<ReactionRow> maybe_reaction_row = reaction_reader.next())
+        {
+            ReactionRow &reaction_row = maybe_reaction_row.value();
+            reactions.set(reaction_row.reaction_id, to_reaction(reaction_row));
+        } });
+} // load_reactions()
 
-    for (unsigned int reaction_id = 0; reaction_id < reactions.size(); reaction_id++)
-    {
-        Reaction &reaction = reactions[reaction_id];
+/*---------------------------------------------------------------------------*/
 
-        for (int i = 0; i < reaction.number_of_reactants; i++)
+template <typename Reaction>
+void ReactionNetwork<Reaction>::compute_dependents(unsigned long int number_of_species,
+                                                   int thread_count)
+{
+    // counting sort of (species, reaction) pairs by species. The first
+    // pass counts the reactions of each species, the second fills the
+    // rows in order of reaction id.
+    //
+    // both passes are split into ranges of reactions. Each range counts
+    // into its own row of next, so the number of ranges is capped to
+    // keep next no bigger than the reactions themselves. The rows of a
+    // later range are placed after those of an earlier one, which gives
+    // the same graph as a single range.
+    unsigned long int number_of_reactions = reactions.size();
+    int range_count = parallel_range_count(
+        std::min((unsigned long int)std::max(thread_count, 1),
+                 std::max(1ul, number_of_reactions / std::max(1ul, number_of_species))),
+        number_of_reactions);
+
+    std::vector<std::vector<unsigned long int>> next(
+        range_count, std::vector<unsigned long int>(number_of_species, 0));
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
         {
-            int reactant_id = reaction.reactants[i];
-            if (reaction.number_of_reactants == 1 || (reaction.reactants[0] != reaction.reactants[1]))
-            {
-                dependents[reactant_id].push_back(reaction_id);
-            }
-            else if (i == 0)
+            // next[range][i] becomes the slot where range writes its
+            // first reaction of species i
+            dependents.offsets.assign(number_of_species + 1, 0);
+            for (unsigned long int i = 0; i < number_of_species; i++)
             {
-                // if i = 1 then duplicate reactant and don't add dependency twice
-                dependents[reactant_id].push_back(reaction_id);
+                unsigned long int slot = dependents.offsets[i];
+                for (int range = 0; range < range_count; range++)
+                {
+                    unsigned long int count = next[range][i];
+                    next[range][i] = slot;
+                    slot += count;
+                }
+                dependents.offsets[i + 1] = slot;
             }
+
+            dependents.entries.resize(dependents.offsets[number_of_species]);
         }
+
+        parallel_ranges(range_count, number_of_reactions,
+                        [&](int range, unsigned long int begin, unsigned long int end)
+                        {
+            std::vector<unsigned long int> &range_next = next[range];
+
+            for (unsigned long int reaction_id = begin; reaction_id < end; reaction_id++)
+            {
+                int number_of_reactants = reactions.number_of_reactants[reaction_id];
+                const SpeciesIndex *reactants = &reactions.reactants[2 * reaction_id];
+
+                for (int i = 0; i < number_of_reactants; i++)
+                {
+                    // if i = 1 of A + A then duplicate reactant and don't add
+                    // dependency twice
+                    if (i == 1 && reactants[0] == reactants[1])
+                        continue;
+
+                    int reactant_id = reactants[i];
+                    if (pass == 0)
+                        range_next[reactant_id]++;
+                    else
+                        dependents.entries[range_next[reactant_id]++] = reaction_id;
+                }
+            } });
     }
 } // compute_dependents()
 
 /*---------------------------------------------------------------------------*/
 
+template <typename Reaction>
+int ReactionNetwork<Reaction>::changed_species(int reaction_index, int species[4])
+{
+    int number_of_species = 0;
+
+    auto add = [&](int species_id)
+    {
+        for (int k = 0; k < number_of_species; k++)
+            if (species[k] == species_id)
+                return;
+        species[number_of_species++] = species_id;
+    };
+
+    for (int i = 0; i < reactions.number_of_reactants[reaction_index]; i++)
+        add(reactions.reactants[2 * reaction_index + i]);
+
+    for (int j = 0; j < reactions.number_of_products[reaction_index]; j++)
+        add(reactions.products[2 * reaction_index + j]);
+
+    return number_of_species;
+} // changed_species()
+
+/*---------------------------------------------------------------------------*/
+
+template <typename Reaction>
+void ReactionNetwork<Reaction>::compute_affected(unsigned long int max_bytes,
+                                                 int thread_count)
+{
+    affected = DependencyGraph();
+
+    // the same two passes as compute_dependents, except each row is the
+    // union of up to four rows of dependents so the size of a row is
+    // only known after merging. The first pass only counts. Rows are
+    // independent of each other, so both passes are split into ranges
+    // of reactions.
+    //
+    // merging is what takes the time on the large networks the budget is
+    // there for, so the graph is first bounded by the sum of the rows of
+    // dependents it would merge, which only needs their sizes. If that
+    // doesn't fit, the counting pass keeps a running total and gives up
+    // as soon as it goes over.
+    unsigned long int number_of_reactions = reactions.size();
+    unsigned long int offsets_bytes = (number_of_reactions + 1) * sizeof(unsigned long int);
+
+    auto over_budget = [&](const char *needs, unsigned long int bytes)
+    {
+        std::cerr << time::time_stamp()
+                  << "reaction dependency graph needs " << needs << (bytes >> 20)
+                  << " MB, over the limit of " << (max_bytes >> 20)
+                  << " MB. Updating propensities by species instead\n";
+    };
+
+    if (offsets_bytes > max_bytes)
+    {
+        over_budget("more than ", offsets_bytes);
+        return;
+    }
+
+    unsigned long int entries_budget = (max_bytes - offsets_bytes) / sizeof(int);
+
+    auto merge_row = [&](unsigned long int reaction_id, std::vector<int> &row)
+    {
+        int species[4];
+        int number_of_species = changed_species(reaction_id, species);
+
+        row.clear();
+        for (int k = 0; k < number_of_species; k++)
+            row.insert(row.end(), dependents[species[k]].begin(), dependents[species[k]].end());
+
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+    };
+
+    std::vector<unsigned long int> bounds(parallel_range_count(thread_count, number_of_reactions), 0);
+
+    parallel_ranges(thread_count, number_of_reactions,
+                    [&](int range, unsigned long int begin, unsigned long int end)
+                    {
+        int species[4];
+        for (unsigned long int reaction_id = begin; reaction_id < end; reaction_id++)
+        {
+            int number_of_species = changed_species(reaction_id, species);
+            for (int k = 0; k < number_of_species; k++)
+                bounds[range] += dependents[species[k]].size();
+        } });
+
+    bool bounded = std::accumulate(bounds.begin(), bounds.end(), 0ul) <= entries_budget;
+
+    std::vector<unsigned long int> offsets(number_of_reactions + 1, 0);
+
+    // only read and written when the bound doesn't fit. A range adds its
+    // rows to it once they hold more than its share of the budget, so
+    // the threads don't contend for it on every reaction, but a range
+    // with rows of O(R) entries still stops within one row of the
+    // budget being used up.
+    std::atomic<unsigned long int> counted(0);
+    unsigned long int flush_threshold = std::max(
+        1ul, entries_budget / bounds.size());
+
+    parallel_ranges(thread_count, number_of_reactions,
+                    [&](int, unsigned long int begin, unsigned long int end)
+                    {
+        std::vector<int> row;
+        unsigned long int uncounted = 0;
+        for (unsigned long int reaction_id = begin; reaction_id < end; reaction_id++)
+        {
+            merge_row(reaction_id, row);
+            offsets[reaction_id + 1] = row.size();
+
+            if (bounded)
+                continue;
+
+            uncounted += row.size();
+            if (uncounted >= flush_threshold || reaction_id + 1 == end)
+            {
+                if (counted.fetch_add(uncounted) + uncounted > entries_budget)
+                    return;
+                uncounted = 0;
+            }
+        } });
+
+    if (!bounded && counted > entries_budget)
+    {
+        over_budget("more than ", offsets_bytes + counted * sizeof(int));
+        return;
+    }
+
+    for (unsigned long int reaction_id = 0; reaction_id < number_of_reactions; reaction_id++)
+        offsets[reaction_id + 1] += offsets[reaction_id];
+
+    unsigned long int number_of_entries = offsets[number_of_reactions];
+
+    affected.entries.resize(number_of_entries);
+
+    parallel_ranges(thread_count, number_of_reactions,
+                    [&](int, unsigned long int begin, unsigned long int end)
+                    {
+        std::vector<int> row;
+        for (unsigned long int reaction_id = begin; reaction_id < end; reaction_id++)
+        {
+            merge_row(reaction_id, row);
+            std::copy(row.begin(), row.end(),
+                      affected.entries.begin() + offsets[reaction_id]);
+        } });
+
+    affected.offsets = std::move(offsets);
+} // compute_affected()
+
+/*---------------------------------------------------------------------------*/
+
+template <typename Reaction>
+void ReactionNetwork<Reaction>::write_cache(ModelCacheWriter &cache)
+{
+    cache.write(reactions.number_of_reactants);
+    cache.write(reactions.number_of_products);
+    cache.write(reactions.reactants);
+    cache.write(reactions.products);
+    cache.write(reactions.rate);
+    cache.write(reactions.dG);
+    cache.write(dependents.offsets);
+    cache.write(dependents.entries);
+    cache.write(affected.offsets);
+    cache.write(affected.entries);
+} // write_cache()
+
+/*---------------------------------------------------------------------------*/
+
+template <typename Reaction>
+bool ReactionNetwork<Reaction>::read_cache(ModelCacheReader &cache)
+{
+    return cache.read(reactions.number_of_reactants) &&
+           cache.read(reactions.number_of_products) &&
+           cache.read(reactions.reactants) &&
+           cache.read(reactions.products) &&
+           cache.read(reactions.rate) &&
+           cache.read(reactions.dG) &&
+           cache.read(dependents.offsets) &&
+           cache.read(dependents.entries) &&
+           cache.read(affected.offsets) &&
+           cache.read(affected.entries);
+} // read_cache()
+
+/*---------------------------------------------------------------------------*/
+
+template <typename Reaction>
+template <typename Visit>
+void ReactionNetwork<Reaction>::for_each_affected(int next_reaction, Visit visit)
+{
+    if (!affected.offsets.empty())
+    {
+        for (int reaction_index : affected[next_reaction])
+            visit(reaction_index);
+
+        return;
+    }
+
+    // a reaction which depends on two changed species is visited twice
+    int species[4];
+    int number_of_species = changed_species(next_reaction, species);
+
+    for (int k = 0; k < number_of_species; k++)
+        for (int reaction_index : dependents[species[k]])
+            visit(reaction_index);
+} // for_each_affected()
+
+/*---------------------------------------------------------------------------*/
+
 template <typename Reaction>
 double ReactionNetwork<Reaction>::compute_propensity(
     std::vector<int> &state,
     int reaction_index)
 {
 
-    Reaction &reaction = reactions[reaction_index];
+    int number_of_reactants = reactions.number_of_reactants[reaction_index];
+    const SpeciesIndex *reactants = &reactions.reactants[2 * reaction_index];
+    double rate = reactions.rate[reaction_index];
 
     double p;
     // zero reactants
-    if (reaction.number_of_reactants == 0)
-        p = factor_zero * reaction.rate;
+    if (number_of_reactants == 0)
+        p = factor_zero * rate;
 
     // one reactant
-    else if (reaction.number_of_reactants == 1)
-        p = state[reaction.reactants[0]] * reaction.rate;
+    else if (number_of_reactants == 1)
+        p = state[reactants[0]] * rate;
 
     // two reactants
     else
     {
-        if (reaction.reactants[0] == reaction.reactants[1])
-            p = factor_duplicate * factor_two * state[reaction.reactants[0]] * (state[reaction.reactants[0]] - 1) * reaction.rate;
+        if (reactants[0] == reactants[1])
+            p = factor_duplicate * factor_two * state[reactants[0]] * (state[reactants[0]] - 1) * rate;
 
         else
-            p = factor_two * state[reaction.reactants[0]] * state[reaction.reactants[1]] * reaction.rate;
+            p = factor_two * state[reactants[0]] * state[reactants[1]] * rate;
     }
     assert(p >= 0);
     return p;
@@ -136,34 +520,36 @@ void ReactionNetwork<Reaction>::update_state(
 {
 
     for (int m = 0;
-         m < reactions[reaction_index].number_of_reactants;
+         m < reactions.number_of_reactants[reaction_index];
          m++)
     {
-        state[reactions[reaction_index].reactants[m]]--;
+        state[reactions.reactants[2 * reaction_index + m]]--;
     }
 
     for (int m = 0;
-         m < reactions[reaction_index].number_of_products;
+         m < reactions.number_of_products[reaction_index];
          m++)
     {
-        state[reactions[reaction_index].products[m]]++;
+        state[reactions.products[2 * reaction_index + m]]++;
     }
 } // update_state()
 
 /*---------------------------------------------------------------------------*/
 
 template <typename Reaction>
-void ReactionNetwork<Reaction>::compute_initial_propensities(std::vector<int> state, 
-                                                             std::vector<double> &initial_propensities)
+void ReactionNetwork<Reaction>::compute_initial_propensities(std::vector<int> state,
+                                                             std::vector<double> &initial_propensities,
+                                                             int thread_count)
 {
     // resize to correct shape
     initial_propensities.resize(reactions.size());
 
     // computing initial propensities
-    for (unsigned long int i = 0; i < initial_propensities.size(); i++)
-    {
-        initial_propensities[i] = compute_propensity(state, i);
-    }
+    parallel_ranges(thread_count, initial_propensities.size(),
+                    [&](int, unsigned long int begin, unsigned long int end)
+                    {
+        for (unsigned long int i = begin; i < end; i++)
+            initial_propensities[i] = compute_propensity(state, i); });
 
 } // compute_initial_propensities()
 
@@ -182,6 +568,20 @@ ReactionNetworkWriteTrajectoriesSql ReactionNetwork<Reaction>::history_element_t
 
 /*---------------------------------------------------------------------------*/
 
+template <typename Reaction>
+ReactionNetworkWriteLeapTrajectoriesSql ReactionNetwork<Reaction>::history_element_to_sql(int seed,
+                                                                                          ReactionNetworkLeapHistoryElement history_element)
+{
+    return ReactionNetworkWriteLeapTrajectoriesSql{
+        .seed = seed,
+        .step = history_element.step,
+        .reaction_id = history_element.reaction_id,
+        .count = history_element.count,
+        .time = history_element.time};
+} // history_element_to_sql()
+
+/*---------------------------------------------------------------------------*/
+
 template <typename Reaction>
 ReactionNetworkWriteStateSql ReactionNetwork<Reaction>::state_history_element_to_sql(int seed, 
                                                                                      ReactionNetworkStateHistoryElement history_element)
@@ -7,7 +7,7 @@ See the README file in the top-level RNMC directory.
 
 #include "sparse_solver.h"
 
-SparseSolver::SparseSolver(unsigned long int seed,
+SparseSolver::SparseSolver(SamplerSeed seed,
                            std::vector<double> &initial_propensities) : sampler(Sampler(seed))
 {
 
@@ -41,7 +41,7 @@ void SparseSolver::update(Update update)
 
 /*---------------------------------------------------------------------------*/
 
-void SparseSolver::update(std::vector<Update> updates)
+void SparseSolver::update(std::vector<Update> &updates)
 {
     for (Update update : updates)
         this->update(update);
@@ -58,7 +58,8 @@ std::optional<Event> SparseSolver::event()
     }
 
     double r1 = sampler.generate();
-    double r2 = sampler.generate();
+    double waiting_time = sampler.exponential();
+    sampler.next_step();
     double fraction = propensity_sum * r1;
     double partial = 0.0;
 
@@ -73,7 +74,7 @@ std::optional<Event> SparseSolver::event()
             break;
     }
 
-    double dt = -std::log(r2) / propensity_sum;
+    double dt = waiting_time / propensity_sum;
     if (it != propensities.end())
         return std::optional<Event>(Event{.index = std::get<0>(*it), .dt = dt});
     else
@@ -13,6 +13,15 @@ std::string ReactionSql::sql_statement =
     "SELECT reaction_id, number_of_reactants, number_of_products, "
     "reactant_1, reactant_2, product_1, product_2, rate FROM reactions;";
 
+std::string ReactionSql::range_sql_statement(unsigned long int begin,
+                                             unsigned long int end)
+{
+    return "SELECT reaction_id, number_of_reactants, number_of_products, "
+           "reactant_1, reactant_2, product_1, product_2, rate FROM reactions "
+           "WHERE reaction_id >= " + std::to_string(begin) +
+           " AND reaction_id < " + std::to_string(end) + ";";
+};
+
 void ReactionSql::action(ReactionSql &r, sqlite3_stmt *stmt)
 {
     r.reaction_id = sqlite3_column_int(stmt, 0);
@@ -32,6 +41,15 @@ std::string EnergyReactionSql::sql_statement =
     "SELECT reaction_id, number_of_reactants, number_of_products, "
     "reactant_1, reactant_2, product_1, product_2, rate, dG FROM reactions;";
 
+std::string EnergyReactionSql::range_sql_statement(unsigned long int begin,
+                                                   unsigned long int end)
+{
+    return "SELECT reaction_id, number_of_reactants, number_of_products, "
+           "reactant_1, reactant_2, product_1, product_2, rate, dG FROM reactions "
+           "WHERE reaction_id >= " + std::to_string(begin) +
+           " AND reaction_id < " + std::to_string(end) + ";";
+};
+
 void EnergyReactionSql::action(EnergyReactionSql &r, sqlite3_stmt *stmt)
 {
     r.reaction_id = sqlite3_column_int(stmt, 0);
@@ -48,7 +66,7 @@ void EnergyReactionSql::action(EnergyReactionSql &r, sqlite3_stmt *stmt)
 /* ----------------------------- Write Trajectory -----------------------------*/
 
 std::string ReactionNetworkWriteTrajectoriesSql::sql_statement =
-    "INSERT INTO trajectories VALUES (?1, ?2, ?3, ?4);";
+    "INSERT INTO trajectories (seed, step, reaction_id, time) VALUES (?1, ?2, ?3, ?4);";
 
 void ReactionNetworkWriteTrajectoriesSql::action(ReactionNetworkWriteTrajectoriesSql &t, sqlite3_stmt *stmt)
 {
@@ -58,6 +76,13 @@ void ReactionNetworkWriteTrajectoriesSql::action(ReactionNetworkWriteTrajectorie
     sqlite3_bind_double(stmt, 4, t.time);
 };
 
+std::string ReactionNetworkWriteTrajectoriesSql::binary_column_names = "reaction_id";
+
+void ReactionNetworkWriteTrajectoriesSql::binary_columns(ReactionNetworkWriteTrajectoriesSql &t, int *columns)
+{
+    columns[0] = t.reaction_id;
+};
+
 /* ----------------------------- Read Trajectory -----------------------------*/
 
 std::string ReactionNetworkReadTrajectoriesSql::sql_statement =
@@ -71,6 +96,43 @@ void ReactionNetworkReadTrajectoriesSql::action(ReactionNetworkReadTrajectoriesS
     r.time = sqlite3_column_double(stmt, 3);
 }
 
+/* -------------------------- Write Leap Trajectory --------------------------*/
+
+std::string ReactionNetworkWriteLeapTrajectoriesSql::sql_statement =
+    "INSERT INTO trajectories (seed, step, reaction_id, time, count) "
+    "VALUES (?1, ?2, ?3, ?4, ?5);";
+
+void ReactionNetworkWriteLeapTrajectoriesSql::action(ReactionNetworkWriteLeapTrajectoriesSql &t, sqlite3_stmt *stmt)
+{
+    sqlite3_bind_int(stmt, 1, t.seed);
+    sqlite3_bind_int(stmt, 2, t.step);
+    sqlite3_bind_int(stmt, 3, t.reaction_id);
+    sqlite3_bind_double(stmt, 4, t.time);
+    sqlite3_bind_int(stmt, 5, t.count);
+};
+
+std::string ReactionNetworkWriteLeapTrajectoriesSql::binary_column_names = "reaction_id,count";
+
+void ReactionNetworkWriteLeapTrajectoriesSql::binary_columns(ReactionNetworkWriteLeapTrajectoriesSql &t, int *columns)
+{
+    columns[0] = t.reaction_id;
+    columns[1] = t.count;
+};
+
+/* -------------------------- Read Leap Trajectory ---------------------------*/
+
+std::string ReactionNetworkReadLeapTrajectoriesSql::sql_statement =
+    "SELECT seed, step, reaction_id, time, count FROM trajectories;";
+
+void ReactionNetworkReadLeapTrajectoriesSql::action(ReactionNetworkReadLeapTrajectoriesSql &r, sqlite3_stmt *stmt)
+{
+    r.seed = sqlite3_column_int(stmt, 0);
+    r.step = sqlite3_column_int(stmt, 1);
+    r.reaction_id = sqlite3_column_int(stmt, 2);
+    r.time = sqlite3_column_double(stmt, 3);
+    r.count = sqlite3_column_int(stmt, 4);
+}
+
 /* --------------------------------- Read state ------------------------------*/
 
 std::string ReactionNetworkReadStateSql::sql_statement =
@@ -23,6 +23,10 @@ public:
     int product_2;
     double rate;
     static std::string sql_statement;
+    // the rows with begin <= reaction_id < end, so that the table can
+    // be read in parallel on several connections
+    static std::string range_sql_statement(unsigned long int begin,
+                                           unsigned long int end);
     static void action(ReactionSql &r, sqlite3_stmt *stmt);
 };
 
@@ -39,6 +43,10 @@ public:
     double rate;
     double dG;
     static std::string sql_statement;
+    // the rows with begin <= reaction_id < end, so that the table can
+    // be read in parallel on several connections
+    static std::string range_sql_statement(unsigned long int begin,
+                                           unsigned long int end);
     static void action(EnergyReactionSql &r, sqlite3_stmt *stmt);
 };
 
@@ -53,6 +61,11 @@ public:
     double time;
     static std::string sql_statement;
     static void action(ReactionNetworkWriteTrajectoriesSql &r, sqlite3_stmt *stmt);
+
+    // integer columns after step and time in binary trajectory files
+    static constexpr int number_of_binary_columns = 1;
+    static std::string binary_column_names;
+    static void binary_columns(ReactionNetworkWriteTrajectoriesSql &r, int *columns);
 };
 
 class ReactionNetworkReadTrajectoriesSql
@@ -66,6 +79,38 @@ public:
     static void action(ReactionNetworkReadTrajectoriesSql &r, sqlite3_stmt *stmt);
 };
 
+// trajectories written in tau leaping mode. Each row is one reaction
+// firing count times in a leap, and step is the number of firings
+// before the row, so the steps of a seed stay unique. The trajectories
+// table needs a count column, which GMC adds when it is missing.
+class ReactionNetworkWriteLeapTrajectoriesSql
+{
+public:
+    int seed;
+    int step;
+    int reaction_id;
+    int count;
+    double time;
+    static std::string sql_statement;
+    static void action(ReactionNetworkWriteLeapTrajectoriesSql &r, sqlite3_stmt *stmt);
+
+    static constexpr int number_of_binary_columns = 2;
+    static std::string binary_column_names;
+    static void binary_columns(ReactionNetworkWriteLeapTrajectoriesSql &r, int *columns);
+};
+
+class ReactionNetworkReadLeapTrajectoriesSql
+{
+public:
+    int seed;
+    int step;
+    double time;
+    int reaction_id;
+    int count;
+    static std::string sql_statement;
+    static void action(ReactionNetworkReadLeapTrajectoriesSql &r, sqlite3_stmt *stmt);
+};
+
 /* --------- I/O State SQL ---------*/
 
 class ReactionNetworkReadStateSql
@@ -129,6 +174,15 @@ struct ReactionNetworkTrajectoryHistoryElement
     int step;
 };
 
+struct ReactionNetworkLeapHistoryElement
+{
+    unsigned long int seed;
+    int reaction_id;        // reaction which fired
+    int count;              // how many times it fired
+    double time;            // time after the leap
+    int step;               // number of firings before this one
+};
+
 struct EnergyNetworkCutoffHistoryElement
 {
     unsigned long int seed;
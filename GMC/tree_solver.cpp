@@ -12,7 +12,7 @@ TreeSolver implementation
 TreeSolver always copies the initial propensities into a new array.
 ---------------------------------------------------------------------------*/
 TreeSolver::TreeSolver(
-    unsigned long int seed,
+    SamplerSeed seed,
     std::vector<double> &initial_propensities) : sampler(Sampler(seed)),
                                                  number_of_active_indices(0)
 {
@@ -74,10 +74,54 @@ void TreeSolver::update(Update update)
 
 /*---------------------------------------------------------------------------*/
 
-void TreeSolver::update(std::vector<Update> updates)
+// apply all the updates from a step at once. The leaves are written
+// first and then every internal node above them is recomputed exactly
+// once, level by level. Reactions which share a species with many others
+// have most of their ancestors in common, so this saves most of the
+// root walks a separate update() per reaction would do. If an index
+// appears more than once, the last update wins.
+void TreeSolver::update(std::vector<Update> &updates)
 {
+    if (updates.size() == 1)
+    {
+        update(updates[0]);
+        return;
+    }
+
+    dirty_nodes.clear();
     for (Update u : updates)
-        update(u);
+    {
+        int i = propensity_offset + u.index;
+        if (tree[i] > 0.0)
+            number_of_active_indices--;
+        if (u.propensity > 0.0)
+            number_of_active_indices++;
+        tree[i] = u.propensity;
+
+        if (i > 0)
+            dirty_nodes.push_back((i - 1) / 2);
+    }
+
+    // all leaves are on the same level, so after sorting, the parents
+    // of a level are again sorted and only need adjacent duplicates
+    // removed
+    std::sort(dirty_nodes.begin(), dirty_nodes.end());
+    while (!dirty_nodes.empty())
+    {
+        dirty_nodes.erase(
+            std::unique(dirty_nodes.begin(), dirty_nodes.end()),
+            dirty_nodes.end());
+
+        for (int parent : dirty_nodes)
+            tree[parent] = tree[2 * parent + 1] + tree[2 * parent + 2];
+
+        // the root is the only node on its level
+        if (dirty_nodes[0] == 0)
+            break;
+
+        for (int &parent : dirty_nodes)
+            parent = (parent - 1) / 2;
+    }
 } // update()
 
 /*---------------------------------------------------------------------------*/
@@ -105,7 +149,7 @@ int TreeSolver::find_solve_tree(double value)
 std::optional<Event> TreeSolver::event()
 {
     unsigned long int m;
-    double r1, r2, dt;
+    double r1, waiting_time, dt;
 
     if (number_of_active_indices == 0)
     {
@@ -113,12 +157,13 @@ std::optional<Event> TreeSolver::event()
     }
 
     r1 = sampler.generate();
-    r2 = sampler.generate();
+    waiting_time = sampler.exponential();
+    sampler.next_step();
 
     double value = r1 * tree[0];
 
     m = find_solve_tree(value);
-    dt = -log(r2) / tree[0];
+    dt = waiting_time / tree[0];
 
     return std::optional<Event>(Event{.index = m, .dt = dt});
 } // event()
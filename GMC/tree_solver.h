@@ -12,6 +12,7 @@ See the README file in the top-level RNMC directory.
 #include <optional>
 #include <cmath>
 #include <map>
+#include <algorithm>
 
 #include "../core/sampler.h"
 #include "../core/RNMC_types.h"
@@ -29,6 +30,7 @@ private:
     int number_of_indices;        // for this solver, different to length of tree
     int number_of_active_indices; // an index is active if its propensity is non zero
     int propensity_offset;        // index where propensities start as leaves of tree
+    std::vector<int> dirty_nodes; // scratch space for batched updates
 
     // walk tree from root to appropriate leaf
     // value is modified when right branch of tree is traversed
@@ -38,9 +40,9 @@ public:
     // tree solver is constructed using a reference because it ends up
     // forming the tail end of a larger vector
     TreeSolver() : sampler(Sampler(0)){}; // defualt constructor
-    TreeSolver(unsigned long int seed, std::vector<double> &initial_propensities);
+    TreeSolver(SamplerSeed seed, std::vector<double> &initial_propensities);
     void update(Update update);
-    void update(std::vector<Update> updates);
+    void update(std::vector<Update> &updates);
     std::optional<Event> event();
     double get_propensity(int index);
     double get_propensity_sum();
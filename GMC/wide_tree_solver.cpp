@@ -0,0 +1,244 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include "wide_tree_solver.h"
+
+/*---------------------------------------------------------------------------
+WideTreeSolver implementation
+WideTreeSolver always copies the initial propensities into a new array.
+---------------------------------------------------------------------------*/
+WideTreeSolver::WideTreeSolver(
+    SamplerSeed seed,
+    std::vector<double> &initial_propensities) : sampler(Sampler(seed)),
+                                                 number_of_indices(initial_propensities.size()),
+                                                 number_of_active_indices(0)
+{
+    // number of nodes on each level, from the leaves up to the root
+    std::vector<unsigned long int> level_sizes;
+    unsigned long int level_size = number_of_indices;
+    do
+    {
+        level_size = (level_size + wide_tree_fanout - 1) / wide_tree_fanout;
+        if (level_size == 0)
+            level_size = 1;
+        level_sizes.push_back(level_size);
+    } while (level_size > 1);
+
+    number_of_levels = level_sizes.size();
+    level_offset.resize(number_of_levels);
+
+    unsigned long int number_of_nodes = 0;
+    for (int level = 0; level < number_of_levels; level++)
+    {
+        level_offset[level] = number_of_nodes;
+        number_of_nodes += level_sizes[number_of_levels - 1 - level];
+    }
+
+    tree.resize(number_of_nodes, WideTreeNode{});
+
+    // fill the leaves
+    unsigned long int leaves = level_offset[number_of_levels - 1];
+    for (unsigned long int i = 0; i < number_of_indices; i++)
+    {
+        tree[leaves + i / wide_tree_fanout].children[i % wide_tree_fanout] =
+            initial_propensities[i];
+        if (initial_propensities[i] > 0.0)
+            number_of_active_indices++;
+    }
+
+    // fill the internal nodes bottom up
+    for (int level = number_of_levels - 1; level > 0; level--)
+    {
+        unsigned long int number_of_level_nodes =
+            level_sizes[number_of_levels - 1 - level];
+
+        for (unsigned long int j = 0; j < number_of_level_nodes; j++)
+        {
+            double sum = 0.0;
+            for (int c = 0; c < wide_tree_fanout; c++)
+                sum += tree[level_offset[level] + j].children[c];
+
+            tree[level_offset[level - 1] + j / wide_tree_fanout]
+                .children[j % wide_tree_fanout] = sum;
+        }
+    }
+} // WideTreeSolver()
+
+/*---------------------------------------------------------------------------*/
+
+void WideTreeSolver::update_ancestors(unsigned long int index)
+{
+    unsigned long int j = index / wide_tree_fanout;
+
+    for (int level = number_of_levels - 1; level > 0; level--)
+    {
+        // summing all 8 children rather than applying a difference keeps
+        // rounding errors from accumulating in the internal nodes
+        double sum = 0.0;
+        for (int c = 0; c < wide_tree_fanout; c++)
+            sum += tree[level_offset[level] + j].children[c];
+
+        tree[level_offset[level - 1] + j / wide_tree_fanout]
+            .children[j % wide_tree_fanout] = sum;
+
+        j = j / wide_tree_fanout;
+    }
+} // update_ancestors()
+
+/*---------------------------------------------------------------------------*/
+
+void WideTreeSolver::update(Update update)
+{
+    double &leaf = tree[level_offset[number_of_levels - 1] +
+                        update.index / wide_tree_fanout]
+                       .children[update.index % wide_tree_fanout];
+
+    if (leaf > 0.0)
+        number_of_active_indices--;
+    if (update.propensity > 0.0)
+        number_of_active_indices++;
+    leaf = update.propensity;
+
+    update_ancestors(update.index);
+} // update()
+
+/*---------------------------------------------------------------------------*/
+
+// apply all the updates from a step at once, recomputing every node
+// above the changed leaves exactly once. If an index appears more than
+// once, the last update wins.
+void WideTreeSolver::update(std::vector<Update> &updates)
+{
+    if (updates.size() == 1)
+    {
+        update(updates[0]);
+        return;
+    }
+
+    unsigned long int leaves = level_offset[number_of_levels - 1];
+
+    dirty_nodes.clear();
+    for (Update u : updates)
+    {
+        double &leaf = tree[leaves + u.index / wide_tree_fanout]
+                           .children[u.index % wide_tree_fanout];
+
+        if (leaf > 0.0)
+            number_of_active_indices--;
+        if (u.propensity > 0.0)
+            number_of_active_indices++;
+        leaf = u.propensity;
+
+        dirty_nodes.push_back(u.index / wide_tree_fanout);
+    }
+
+    // dirty_nodes holds the indices of changed nodes within a level.
+    // Dividing a sorted list by the fanout keeps it sorted, so each
+    // level only needs adjacent duplicates removed.
+    std::sort(dirty_nodes.begin(), dirty_nodes.end());
+    for (int level = number_of_levels - 1; level > 0; level--)
+    {
+        dirty_nodes.erase(
+            std::unique(dirty_nodes.begin(), dirty_nodes.end()),
+            dirty_nodes.end());
+
+        for (unsigned long int &j : dirty_nodes)
+        {
+            double sum = 0.0;
+            for (int c = 0; c < wide_tree_fanout; c++)
+                sum += tree[level_offset[level] + j].children[c];
+
+            tree[level_offset[level - 1] + j / wide_tree_fanout]
+                .children[j % wide_tree_fanout] = sum;
+
+            j = j / wide_tree_fanout;
+        }
+    }
+} // update()
+
+/*---------------------------------------------------------------------------*/
+
+int WideTreeSolver::find_child(WideTreeNode &node, double &value)
+{
+    double prefix[wide_tree_fanout];
+    double partial = 0.0;
+    for (int c = 0; c < wide_tree_fanout; c++)
+    {
+        partial += node.children[c];
+        prefix[c] = partial;
+    }
+
+    // the prefix sums are non decreasing, so the chosen child is the
+    // number of prefix sums not exceeding value. Counting rather than
+    // searching keeps the loop free of branches so it vectorizes.
+    int child = 0;
+    for (int c = 0; c < wide_tree_fanout; c++)
+        child += (prefix[c] <= value);
+
+    // rounding can push value past the last prefix sum. Fall back to the
+    // last child with a non zero propensity.
+    if (child == wide_tree_fanout)
+    {
+        child = wide_tree_fanout - 1;
+        while (child > 0 && node.children[child] == 0.0)
+            child--;
+        value = node.children[child];
+        return child;
+    }
+
+    if (child > 0)
+        value -= prefix[child - 1];
+
+    return child;
+} // find_child()
+
+/*---------------------------------------------------------------------------*/
+
+std::optional<Event> WideTreeSolver::event()
+{
+    if (number_of_active_indices == 0)
+    {
+        return std::optional<Event>();
+    }
+
+    double r1 = sampler.generate();
+    double waiting_time = sampler.exponential();
+    sampler.next_step();
+
+    double propensity_sum = get_propensity_sum();
+    double value = r1 * propensity_sum;
+
+    unsigned long int j = 0;
+    for (int level = 0; level < number_of_levels; level++)
+    {
+        int child = find_child(tree[level_offset[level] + j], value);
+        j = j * wide_tree_fanout + child;
+    }
+
+    double dt = waiting_time / propensity_sum;
+
+    return std::optional<Event>(Event{.index = j, .dt = dt});
+} // event()
+
+/*---------------------------------------------------------------------------*/
+
+double WideTreeSolver::get_propensity(int index)
+{
+    return tree[level_offset[number_of_levels - 1] + index / wide_tree_fanout]
+        .children[index % wide_tree_fanout];
+} // get_propensity()
+
+/*---------------------------------------------------------------------------*/
+
+double WideTreeSolver::get_propensity_sum()
+{
+    double sum = 0.0;
+    for (int c = 0; c < wide_tree_fanout; c++)
+        sum += tree[0].children[c];
+
+    return sum;
+} // get_propensity_sum()
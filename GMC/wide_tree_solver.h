@@ -0,0 +1,65 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_WIDE_TREE_SOLVER_H
+#define RNMC_WIDE_TREE_SOLVER_H
+
+#include <vector>
+#include <optional>
+#include <cmath>
+#include <algorithm>
+
+#include "../core/sampler.h"
+#include "../core/RNMC_types.h"
+
+// same algorithm as TreeSolver, but the sum tree has a fanout of 8
+// instead of 2. Each node stores the propensity sums of its 8 children
+// contiguously in a single 64 byte cache line, so walking the tree for
+// an event or an update touches log_8(R) cache lines instead of
+// log_2(R). For 10^8 reactions that is 9 dependent loads instead of 27.
+//
+// Nodes are stored level by level, starting at the root. The children of
+// node j on level l are nodes 8j, ..., 8j + 7 on level l + 1, so siblings
+// are always adjacent in memory. The bottom level holds the propensities
+// themselves.
+
+constexpr int wide_tree_fanout = 8;
+
+struct alignas(64) WideTreeNode
+{
+    double children[wide_tree_fanout];
+};
+
+class WideTreeSolver
+{
+private:
+    Sampler sampler;
+    std::vector<WideTreeNode> tree;
+    std::vector<unsigned long int> level_offset; // index in tree of the first node on each level
+    int number_of_levels;
+    unsigned long int number_of_indices;
+    int number_of_active_indices; // an index is active if its propensity is non zero
+    std::vector<unsigned long int> dirty_nodes; // scratch space for batched updates
+
+    // find the child of a node containing value. value is reduced by the
+    // propensity of the children to the left of the chosen one.
+    int find_child(WideTreeNode &node, double &value);
+
+    // recompute the sums stored above the leaf node containing index
+    void update_ancestors(unsigned long int index);
+
+public:
+    WideTreeSolver() : sampler(Sampler(0)){};
+    WideTreeSolver(SamplerSeed seed, std::vector<double> &initial_propensities);
+    void update(Update update);
+    void update(std::vector<Update> &updates);
+    std::optional<Event> event();
+    double get_propensity(int index);
+    double get_propensity_sum();
+};
+
+#endif
@@ -22,7 +22,14 @@ void print_usage()
               << "--thread_count\n"
               << "--step_cutoff|time_cutoff\n"
               << "--checkpoint\n"
-              << "--parameters\n";
+              << "--parameters\n"
+              << "--history_chunk_size (optional)\n"
+              << "--max_history_mb (optional)\n"
+              << "--journal_mode=delete|truncate|persist|memory|wal|off (optional)\n"
+              << "--synchronous=off|normal|full|extra (optional)\n"
+              << "--output_format=sqlite|binary (optional)\n"
+              << "--model_cache=path (optional)\n"
+              << "--rng=gsl|philox (optional)\n";
 
 } // print_usage()
 
@@ -47,7 +54,7 @@ void print_usage_LGMC_parameters()
 int main(int argc, char **argv)
 {
 
-    if (argc != 9)
+    if (argc < 9 || argc > 16)
     {
         print_usage();
         exit(EXIT_FAILURE);
@@ -63,6 +70,13 @@ int main(int argc, char **argv)
         {"time_cutoff", optional_argument, NULL, 7},
         {"checkpoint", required_argument, NULL, 8},
         {"parameters", required_argument, NULL, 9},
+        {"history_chunk_size", required_argument, NULL, 10},
+        {"max_history_mb", required_argument, NULL, 11},
+        {"journal_mode", required_argument, NULL, 12},
+        {"synchronous", required_argument, NULL, 13},
+        {"output_format", required_argument, NULL, 14},
+        {"model_cache", required_argument, NULL, 15},
+        {"rng", required_argument, NULL, 16},
         {NULL, 0, NULL, 0}
         // last element of options array needs to be filled with zeros
     };
@@ -77,6 +91,15 @@ int main(int argc, char **argv)
     int thread_count = 0;
     char *LGMC_params_file = nullptr;
     bool isCheckpoint;
+    std::string model_cache;
+
+    HistoryParameters history_parameters = {
+        .history_chunk_size = default_history_chunk_size,
+        .max_bytes_in_flight = 0,
+        .journal_mode = "",
+        .synchronous = "",
+        .output_format = sqlite_output,
+        .trajectory_directory = ""};
 
     Cutoff cutoff = {
         .bound = {.step = 0},
@@ -129,6 +152,60 @@ int main(int argc, char **argv)
             LGMC_params_file = optarg;
             break;
 
+        case 10:
+            history_parameters.history_chunk_size = atol(optarg);
+            break;
+
+        case 11:
+            history_parameters.max_bytes_in_flight = atol(optarg) * 1024 * 1024;
+            break;
+
+        case 12:
+            history_parameters.journal_mode = optarg;
+            if (!is_journal_mode(history_parameters.journal_mode))
+            {
+                std::cerr << "unknown journal mode " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 13:
+            history_parameters.synchronous = optarg;
+            if (!is_synchronous_mode(history_parameters.synchronous))
+            {
+                std::cerr << "unknown synchronous mode " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 14:
+            if (std::string(optarg) == "sqlite")
+                history_parameters.output_format = sqlite_output;
+            else if (std::string(optarg) == "binary")
+                history_parameters.output_format = binary_output;
+            else
+            {
+                std::cerr << "unknown output format " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 15:
+            model_cache = optarg;
+            break;
+
+        case 16:
+            if (!parse_sampler_backend(optarg, sampler_backend))
+            {
+                std::cerr << "unknown rng " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
         default:
             // if an unexpected argument is passed, exit
             print_usage();
@@ -137,6 +214,19 @@ int main(int argc, char **argv)
         }
     }
 
+    if (history_parameters.history_chunk_size == 0)
+    {
+        std::cerr << "history_chunk_size must be positive\n";
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+
+    // binary trajectories go next to the initial state database, which
+    // still holds the checkpoint tables
+    if (history_parameters.output_format == binary_output)
+        history_parameters.trajectory_directory =
+            std::string(initial_state_database) + ".trajectories";
+
     // read in LGMC parameters from file
     std::string LGMC_params_str(LGMC_params_file);
     std::ifstream fin;
@@ -195,7 +285,8 @@ int main(int argc, char **argv)
                                  .g_e = g_e,
                                  .is_add_sites = is_add_site,
                                  .charge_transfer_style = charge_transfer_style,
-                                 .isCheckpoint = isCheckpoint};
+                                 .isCheckpoint = isCheckpoint,
+                                 .model_cache = model_cache};
 
     Dispatcher<LatticeSolver,
                LatticeReactionNetwork,
@@ -219,6 +310,7 @@ int main(int argc, char **argv)
             base_seed,
             thread_count,
             cutoff,
+            history_parameters,
             parameters);
 
     dispatcher.run_dispatcher();
@@ -31,6 +31,7 @@ Lattice::Lattice(float latconst_in)
     nmax = DELTA;
 
     maxneigh = 6;
+    idneigh = NeighborTable(maxneigh);
 
 } // Lattice()
 
@@ -61,6 +62,7 @@ Lattice::Lattice(float latconst_in, int ihi_in,
     nmax = DELTA;
 
     maxneigh = 6;
+    idneigh = NeighborTable(maxneigh);
 
     // create sites on lattice
     structured_lattice();
@@ -72,74 +74,6 @@ Lattice::Lattice(float latconst_in, int ihi_in,
 
 /* ---------------------------------------------------------------------- */
 
-Lattice::Lattice(const Lattice &other)
-{
-
-    latconst = other.latconst;
-    ilo = other.ilo;
-    ihi = other.ihi;
-    jlo = other.jlo;
-    jhi = other.jhi;
-    klo = other.klo;
-    khi = other.khi;
-    xlo = other.xlo;
-    xhi = other.xhi;
-    ylo = other.ylo;
-    yhi = other.yhi;
-    zlo = other.zlo;
-    zhi = other.zhi;
-    is_xperiodic = other.is_xperiodic;
-    is_yperiodic = other.is_yperiodic;
-    is_zperiodic = other.is_zperiodic;
-    maxz = other.maxz;
-    loc_map = other.loc_map;
-
-    for (auto it = other.sites.begin(); it != other.sites.end(); it++)
-    {
-        sites[it->first] = it->second;
-    }
-
-    nsites = other.nsites;
-    nmax = other.nmax;
-
-    maxneigh = other.maxneigh;
-
-    for (auto it = other.numneigh.begin(); it != other.numneigh.end(); it++)
-    {
-        numneigh[it->first] = it->second;
-    }
-
-    for (auto it = other.edges.begin(); it != other.edges.end(); it++)
-    {
-        edges[it->first] = it->second;
-    }
-
-    for (int i = 0; i < int(numneigh.size()); i++)
-    {
-        uint32_t *neighi;
-        create(neighi, maxneigh, "create:neighi");
-
-        for (size_t j = 0; j < other.numneigh.at(i); j++)
-        {
-            neighi[j] = other.idneigh.at(i)[j];
-        }
-        idneigh[i] = neighi;
-    }
-} // Lattice()
-
-/* ---------------------------------------------------------------------- */
-
-Lattice::~Lattice()
-{
-
-    for (size_t i = 0; i < idneigh.size(); i++)
-    {
-        sfree(idneigh[i]);
-    }
-} // ~Lattice()
-
-/* ---------------------------------------------------------------------- */
-
 void Lattice::structured_lattice()
 {
 
@@ -216,6 +150,11 @@ void Lattice::structured_lattice()
 
     bool can_adsorb = false;
 
+    nmax = MAX(nmax, (ihi - ilo + 1) * (jhi - jlo + 1) * (khi - klo + 1));
+    sites.reserve(nmax);
+    numneigh.reserve(nmax);
+    idneigh.reserve(nmax);
+
     for (int k = klo; k <= khi; k++)
     {
         for (int j = jlo; j <= jhi; j++)
@@ -276,10 +215,6 @@ void Lattice::structured_connectivity()
     {
         numneigh[i] = 0;
 
-        uint32_t *neighi;
-        create(neighi, maxneigh, "create:neighi");
-        idneigh[i] = neighi;
-
         for (int neigh = 0; neigh < maxneigh; neigh++)
         {
 
@@ -405,8 +340,8 @@ void Lattice::add_site(uint32_t i_in, uint32_t j_in, uint32_t k_in,
                        bool meta_neighbors_in)
 {
 
-    std::tuple<uint32_t, uint32_t, uint32_t> key = {i_in, j_in, k_in};
-    if (loc_map.find(key) != loc_map.end())
+    SiteGrid::Position key = {i_in, j_in, k_in};
+    if (loc_map.contains(key))
     {
         // site already exists
         return;
@@ -415,8 +350,9 @@ void Lattice::add_site(uint32_t i_in, uint32_t j_in, uint32_t k_in,
     if (nsites == nmax)
     {
         nmax += DELTA;
-        // can_adsorb.reserve(nmax);
-        // can_desorb.reserve(nmax);
+        sites.reserve(nmax);
+        numneigh.reserve(nmax);
+        idneigh.reserve(nmax);
     }
 
     // Initialize neighbor information for this new site
@@ -425,18 +361,17 @@ void Lattice::add_site(uint32_t i_in, uint32_t j_in, uint32_t k_in,
     // initially empty site
     sites[nsites] = Site{i_in, j_in, k_in, SPECIES_EMPTY, can_adsorb_in};
 
-    loc_map[key] = nsites;
+    loc_map.insert(key, nsites);
 
     if (can_adsorb_in)
     {
-        edges[nsites] = 'a';
+        edges.set(nsites, 'a');
     }
 
     if (update_neighbors_in)
     {
-        uint32_t *neighi;
-        create(neighi, maxneigh, "create:neighi");
-        idneigh[nsites] = neighi;
+        // create the row of the new site
+        idneigh[nsites];
         update_neighbors(nsites, meta_neighbors_in);
     }
 
@@ -488,7 +423,7 @@ void Lattice::add_site(uint32_t i_in, uint32_t j_in, uint32_t k_in,
 void Lattice::delete_site(int id)
 {
 
-    assert(sites.find(id) != sites.end());
+    assert(sites.contains(id));
 
     update_neighbors(id, true);
 
@@ -504,7 +439,6 @@ void Lattice::delete_site(int id)
 
     // delete from other hashes
     numneigh.erase(id);
-    sfree(idneigh[id]);
     idneigh.erase(id);
     edges.erase(id);
 
@@ -567,8 +501,7 @@ void Lattice::update_neighbors(uint32_t n, bool meta_neighbors_in)
         }
     }
 
-    std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> ijk;
-    ijk.resize(6);
+    SiteGrid::Position ijk[6];
 
     ijk[0] = {left, sites[n].j, sites[n].k};
     ijk[1] = {right, sites[n].j, sites[n].k};
@@ -581,14 +514,14 @@ void Lattice::update_neighbors(uint32_t n, bool meta_neighbors_in)
 
     for (int q = 0; q < 6; q++)
     {
-        auto it = loc_map.find(ijk[q]);
-        if (it != loc_map.end())
+        int neighbor = loc_map.find(ijk[q]);
+        if (neighbor >= 0)
         {
-            idneigh[n][numneigh[n]++] = it->second;
+            idneigh[n][numneigh[n]++] = neighbor;
 
             if (meta_neighbors_in)
             {
-                update_neighbors(it->second, false);
+                update_neighbors(neighbor, false);
             }
         }
     }
@@ -613,17 +546,6 @@ void *Lattice::smalloc(int nbytes, const char *name)
 
 /* ---------------------------------------------------------------------- */
 
-template <typename TYPE>
-TYPE *Lattice::create(TYPE *&array, int n, const char *name)
-{
-    int nbytes = ((int)sizeof(TYPE)) * n;
-    array = (TYPE *)smalloc(nbytes, name);
-    return array;
-
-} // create()
-
-/* ---------------------------------------------------------------------- */
-
 template <typename TYPE>
 TYPE **Lattice::create(TYPE **&array, int n1, int n2, const char *name)
 {
@@ -677,4 +599,68 @@ float Lattice::get_latconst()
 float Lattice::get_maxz()
 {
     return maxz;
-}
\ No newline at end of file
+} // get_maxz()
+
+/* ---------------------------------------------------------------------- */
+
+int Lattice::get_maxk()
+{
+    return static_cast<int>(std::lround(maxz / latconst));
+} // get_maxk()
+
+/* ---------------------------------------------------------------------- */
+
+int Lattice::get_nsites()
+{
+    return nsites;
+} // get_nsites()
+
+/* ---------------------------------------------------------------------- */
+
+void SiteGrid::insert(const Position &position, int id)
+{
+    uint32_t i = std::get<0>(position);
+    uint32_t j = std::get<1>(position);
+    uint32_t k = std::get<2>(position);
+
+    if (i >= ni || j >= nj)
+    {
+        // a new row or column changes the layout of every layer
+        uint32_t new_ni = MAX(ni, i + 1);
+        uint32_t new_nj = MAX(nj, j + 1);
+        std::vector<int> new_ids(static_cast<size_t>(new_ni) * new_nj * nk, -1);
+
+        for (uint32_t kk = 0; kk < nk; kk++)
+            for (uint32_t jj = 0; jj < nj; jj++)
+                for (uint32_t ii = 0; ii < ni; ii++)
+                    new_ids[(static_cast<size_t>(kk) * new_nj + jj) * new_ni + ii] =
+                        ids[(static_cast<size_t>(kk) * nj + jj) * ni + ii];
+
+        ids = std::move(new_ids);
+        ni = new_ni;
+        nj = new_nj;
+    }
+
+    if (k >= nk)
+    {
+        nk = k + 1;
+        ids.resize(static_cast<size_t>(ni) * nj * nk, -1);
+    }
+
+    int &entry = ids[(static_cast<size_t>(k) * nj + j) * ni + i];
+    if (entry < 0)
+        count++;
+    entry = id;
+} // insert()
+
+/* ---------------------------------------------------------------------- */
+
+void SiteGrid::erase(const Position &position)
+{
+    if (!contains(position))
+        return;
+
+    ids[(static_cast<size_t>(std::get<2>(position)) * nj + std::get<1>(position)) * ni +
+        std::get<0>(position)] = -1;
+    count--;
+} // erase()
\ No newline at end of file
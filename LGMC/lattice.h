@@ -18,6 +18,9 @@ Lattice from https://spparks.sandia.gov/
 #include <map>
 #include <cassert>
 #include <iostream>
+#include <tuple>
+#include <limits>
+#include <cmath>
 
 #include "stdio.h"
 #include "stdlib.h"
@@ -59,6 +62,286 @@ struct Site
     bool can_adsorb; // is the site in contact with the electrolyte?
 };
 
+/* ----------------------- dense site storage ------------------------------ */
+
+// a value for each site id, stored densely by id. Ids are handed out in
+// order by add_site and never reused, so a deleted site leaves a gap.
+// Like the maps these replace, operator[] sets an id which isn't set.
+template <typename T>
+class SiteArray
+{
+public:
+    SiteArray() : count(0){};
+
+    T &operator[](int id)
+    {
+        // a negative id is a failed lookup, e.g. SiteGrid::find of a
+        // position without a site
+        assert(id >= 0);
+        if (id >= static_cast<int>(values.size()))
+        {
+            values.resize(id + 1);
+            is_set.resize(id + 1, 0);
+        }
+        if (!is_set[id])
+        {
+            is_set[id] = 1;
+            count++;
+        }
+        return values[id];
+    };
+
+    bool contains(int id) const
+    {
+        return id >= 0 && id < static_cast<int>(values.size()) && is_set[id];
+    };
+
+    void erase(int id)
+    {
+        if (contains(id))
+        {
+            is_set[id] = 0;
+            count--;
+        }
+    };
+
+    void reserve(int n)
+    {
+        values.reserve(n);
+        is_set.reserve(n);
+    };
+
+    // number of ids which are set
+    int size() const { return count; };
+
+private:
+    std::vector<T> values;
+    std::vector<char> is_set;
+    int count;
+};
+
+// the neighbor ids of each site in one flat array, width entries per
+// site id. How many of a site's entries are used is kept in numneigh.
+class NeighborTable
+{
+public:
+    NeighborTable() : width(0), count(0){};
+    NeighborTable(int width_in) : width(width_in), count(0){};
+
+    // the row of a site, which is created if the site has none
+    uint32_t *operator[](int id)
+    {
+        if (id >= static_cast<int>(has_row.size()))
+        {
+            neighbors.resize(static_cast<size_t>(id + 1) * width);
+            has_row.resize(id + 1, 0);
+        }
+        if (!has_row[id])
+        {
+            has_row[id] = 1;
+            count++;
+        }
+        return neighbors.data() + static_cast<size_t>(id) * width;
+    };
+
+    void erase(int id)
+    {
+        if (id < static_cast<int>(has_row.size()) && has_row[id])
+        {
+            has_row[id] = 0;
+            count--;
+        }
+    };
+
+    void reserve(int n)
+    {
+        neighbors.reserve(static_cast<size_t>(n) * width);
+        has_row.reserve(n);
+    };
+
+    // number of sites with a row
+    int size() const { return count; };
+
+private:
+    std::vector<uint32_t> neighbors;
+    std::vector<char> has_row;
+    int width;
+    int count;
+};
+
+// the sites on the surface of the lattice, marked 'a' if a species can
+// adsorb there or 'd' if one can desorb. The adsorbable sites are also
+// kept packed, in no particular order, so that the number of them is
+// known and one can be picked uniformly without going through the
+// surface.
+class EdgeSet
+{
+public:
+    EdgeSet() : count(0){};
+
+    // the mark of a site, 0 if it isn't an edge
+    char operator[](int id) const
+    {
+        return id >= 0 && id < static_cast<int>(kind.size()) ? kind[id] : 0;
+    };
+
+    bool contains(int id) const { return (*this)[id] != 0; };
+
+    void set(int id, char mark)
+    {
+        if (id >= static_cast<int>(kind.size()))
+        {
+            kind.resize(id + 1, 0);
+            adsorbable_position.resize(id + 1, -1);
+        }
+
+        if (kind[id] == 0)
+            count++;
+
+        if (kind[id] != 'a' && mark == 'a')
+        {
+            adsorbable_position[id] = adsorbable_ids.size();
+            adsorbable_ids.push_back(id);
+            new_adsorbable_ids.push_back(id);
+        }
+        else if (kind[id] == 'a' && mark != 'a')
+            remove_adsorbable(id);
+
+        kind[id] = mark;
+    };
+
+    void erase(int id)
+    {
+        if (!contains(id))
+            return;
+
+        if (kind[id] == 'a')
+            remove_adsorbable(id);
+
+        kind[id] = 0;
+        count--;
+    };
+
+    // number of edges
+    int size() const { return count; };
+
+    int number_of_adsorbable() const { return adsorbable_ids.size(); };
+    int adsorbable(int index) const { return adsorbable_ids[index]; };
+
+    // the sites which have been marked 'a' since the last clear, some
+    // of which may not be any more
+    const std::vector<int> &new_adsorbable() const { return new_adsorbable_ids; };
+    void clear_new_adsorbable() { new_adsorbable_ids.clear(); };
+
+private:
+    std::vector<char> kind;
+    std::vector<int> adsorbable_ids;
+    std::vector<int> adsorbable_position; // index into adsorbable_ids by site id
+    std::vector<int> new_adsorbable_ids;
+    int count;
+
+    void remove_adsorbable(int id)
+    {
+        // move the last adsorbable site into the gap
+        int last = adsorbable_ids.back();
+        adsorbable_ids[adsorbable_position[id]] = last;
+        adsorbable_position[last] = adsorbable_position[id];
+        adsorbable_ids.pop_back();
+        adsorbable_position[id] = -1;
+    };
+};
+
+// site ids by lattice position, in a dense grid covering every position
+// a site has been added at. k is the outermost index, so a lattice
+// growing in z only appends to the grid.
+class SiteGrid
+{
+public:
+    typedef std::tuple<uint32_t, uint32_t, uint32_t> Position;
+
+    SiteGrid() : ni(0), nj(0), nk(0), count(0){};
+
+    // the id of the site at a position, or -1 if there is none
+    int find(const Position &position) const
+    {
+        uint32_t i = std::get<0>(position);
+        uint32_t j = std::get<1>(position);
+        uint32_t k = std::get<2>(position);
+
+        if (i >= ni || j >= nj || k >= nk)
+            return -1;
+
+        return ids[(static_cast<size_t>(k) * nj + j) * ni + i];
+    };
+
+    bool contains(const Position &position) const { return find(position) >= 0; };
+
+    // the id of the site at a position which must have one. Use find or
+    // contains where there may not be a site.
+    int operator[](const Position &position) const
+    {
+        int id = find(position);
+        assert(id >= 0);
+        return id;
+    };
+
+    void insert(const Position &position, int id);
+    void erase(const Position &position);
+
+    // number of positions with a site
+    int size() const { return count; };
+
+private:
+    std::vector<int> ids;
+    uint32_t ni, nj, nk;
+    int count;
+};
+
+/* ---------------------------------------------------------------------- */
+
+// rate coefficients which depend on the layer of the lattice a
+// reaction happens in, such as those of charge transfer from the
+// electrode at k = 0, by reaction and layer. The reaction network
+// computes each one the first time it is needed. The table belongs to a
+// lattice so that every simulation has its own and no locking is
+// needed. A new layer only adds a row. Anything else the rates depend
+// on is passed with each lookup, and if it differs from what the table
+// was filled with, the table is emptied.
+class LayerRates
+{
+public:
+    LayerRates() : number_of_reactions(0), e_free(0), temperature(0){};
+
+    // the rate of a reaction in layer k, NaN if it hasn't been computed
+    double &get(int reaction_id, int k, int number_of_reactions_in,
+                float e_free_in, float temperature_in)
+    {
+        if (number_of_reactions_in != number_of_reactions ||
+            e_free_in != e_free || temperature_in != temperature)
+        {
+            rates.clear();
+            number_of_reactions = number_of_reactions_in;
+            e_free = e_free_in;
+            temperature = temperature_in;
+        }
+
+        unsigned long int index = static_cast<unsigned long int>(k) * number_of_reactions + reaction_id;
+        if (index >= rates.size())
+        {
+            rates.resize(static_cast<unsigned long int>(k + 1) * number_of_reactions,
+                         std::numeric_limits<double>::quiet_NaN());
+        }
+
+        return rates[index];
+    };
+
+private:
+    std::vector<double> rates; // layer k starts at k * number_of_reactions
+    int number_of_reactions;
+    float e_free;
+    float temperature;
+};
+
 class Lattice
 {
 private:
@@ -66,9 +349,6 @@ private:
 
     void *smalloc(int nbytes, const char *name); // safe allocate
 
-    template <typename TYPE>
-    TYPE *create(TYPE *&array, int n, const char *name); // create 1D array
-
     template <typename TYPE>
     TYPE **create(TYPE **&array, int n1, int n2, const char *name); // create 2D array
 
@@ -82,8 +362,8 @@ private:
     int ilo, ihi, klo, khi, jlo, jhi; // geometry info neighbors
                                       // 0 = non-periodic, 1 = periodic
 
-    int nsites;                       // number of sites
-    int nmax;                         // max # sites, idneigh, numneigh
+    int nsites;                       // number of site ids handed out
+    int nmax;                         // sites reserved in the arrays
 
     int maxneigh;                     // max neigh per site
     float maxz;                       // the largest dist of lattice 
@@ -94,11 +374,12 @@ public:
     float xlo, xhi, ylo,              // bounding of box
         yhi, zlo, zhi;                // (yscale * read in value)
 
-    std::unordered_map<int, Site> sites;         // list of Sites for lattice
-    std::unordered_map<int, uint32_t *> idneigh; // neighbor IDs for each site
-    std::unordered_map<int, uint32_t> numneigh;  // # of neighbors of each site
-    std::unordered_map<int, char> edges;
-    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, int> loc_map; // Mapping from site location (i,j,k) to site ID
+    SiteArray<Site> sites;        // list of Sites for lattice
+    NeighborTable idneigh;        // neighbor IDs for each site
+    SiteArray<uint32_t> numneigh; // # of neighbors of each site
+    EdgeSet edges;
+    SiteGrid loc_map;             // Mapping from site location (i,j,k) to site ID
+    LayerRates layer_rates;
     bool isCheckpoint;
 
     Lattice(float latconst_in);
@@ -106,9 +387,7 @@ public:
     Lattice(float latconst_in, int ihi_in,
             int jhi_in, int khi_in);
 
-    Lattice(const Lattice &other); // copy constructor
-
-    ~Lattice();
+    Lattice(const Lattice &other) = default; // copy constructor
 
     void structured_lattice();
 
@@ -126,6 +405,12 @@ public:
     float get_latconst();
 
     float get_maxz();
+
+    // the layer at get_maxz()
+    int get_maxk();
+
+    // site ids are below this, including those of deleted sites
+    int get_nsites();
 };
 
 #endif
\ No newline at end of file
@@ -43,7 +43,7 @@ LatticeReactionNetwork::LatticeReactionNetwork(SqlConnection
                                                SqlConnection
                                                    &initial_state_database,
                                                LatticeParameters
-                                                   parameters) : sampler(Sampler(0))
+                                                   parameters)
 {
 
     isCheckpoint = parameters.isCheckpoint;
@@ -60,8 +60,7 @@ LatticeReactionNetwork::LatticeReactionNetwork(SqlConnection
 /* ---------------------------------------------------------------------- */
 
 void LatticeReactionNetwork::update_state(std::unique_ptr<Lattice> &lattice,
-                                          std::unordered_map<std::string,
-                                                             std::vector<std::pair<double, int>>> &props,
+                                          LatticePropensities &props,
                                           std::vector<int> &state, int next_reaction,
                                           std::optional<int> site_one,
                                           std::optional<int> site_two, long double &prop_sum,
@@ -94,111 +93,96 @@ void LatticeReactionNetwork::update_state(std::unique_ptr<Lattice> &lattice,
 
 void LatticeReactionNetwork::update_propensities(std::unique_ptr<Lattice> &lattice,
                                                  std::vector<int> &state,
-                                                 std::function<void(Update update)> update_function,
-                                                 std::function<void(LatticeUpdate lattice_update,
-                                                                    std::unordered_map<std::string,
-                                                                                       std::vector<std::pair<double, int>>> &props)>
-                                                     lattice_update_function,
+                                                 LatticeSolver &solver,
                                                  int next_reaction,
                                                  std::optional<int> site_one, std::optional<int> site_two,
-                                                 std::unordered_map<std::string,
-                                                                    std::vector<std::pair<double, int>>> &props)
+                                                 LatticePropensities &props)
 {
 
     if (site_one)
     {
         // update lattice state
         bool update_gillepsie = update_propensities(lattice,
-                                                    lattice_update_function, next_reaction,
+                                                    solver, next_reaction,
                                                     site_one.value(), site_two.value(), props);
 
         if (update_gillepsie)
         {
-            update_propensities(update_function, state, next_reaction, lattice);
+            update_propensities(solver, state, next_reaction, lattice);
+            update_adsorp_props(lattice, state, props);
         }
     }
 
     else
     {
         // homoegenous event happens
-        update_propensities(update_function, state, next_reaction, lattice);
+        update_propensities(solver, state, next_reaction, lattice);
+        update_adsorp_props(lattice, state, props);
     }
 
-    update_adsorp_props(lattice, lattice_update_function, state, props);
+    // the adsorption channels only need the number of adsorbable sites
+    // when the solution hasn't changed
+    props.set_adsorbable_sites(lattice->edges.number_of_adsorbable());
 
 } // update_propensities()
 
 /* ---------------------------------------------------------------------- */
 
 void LatticeReactionNetwork::update_adsorp_state(std::unique_ptr<Lattice> &lattice,
-                                                 std::unordered_map<std::string,
-                                                                    std::vector<std::pair<double, int>>> &props,
+                                                 LatticePropensities &props,
                                                  long double &prop_sum, int &active_indices)
 {
 
-    // update only sites on the edge
-    for (auto it = lattice->edges.begin(); it != lattice->edges.end(); it++)
+    // a site which has just become adsorbable may still have desorption
+    // propensities from when it was occupied. Adsorption itself is
+    // grouped into one channel per reaction, so nothing is added here.
+    for (int site : lattice->edges.new_adsorbable())
     {
-        int site = it->first;
         if (lattice->edges[site] == 'a')
         {
             assert(lattice->sites[site].species == SPECIES_EMPTY);
             clear_site_helper(props, site, SITE_HOMOGENEOUS, prop_sum, active_indices);
         }
     }
+
+    lattice->edges.clear_new_adsorbable();
 } // update_adsorp_state()
 
 /* ---------------------------------------------------------------------- */
 
 void LatticeReactionNetwork::update_adsorp_props(std::unique_ptr<Lattice> &lattice,
-                                                 std::function<void(LatticeUpdate lattice_update,
-                                                                    std::unordered_map<std::string,
-                                                                                       std::vector<std::pair<double, int>>> &props)>
-                                                     lattice_update_function,
                                                  std::vector<int> &state,
-                                                 std::unordered_map<std::string,
-                                                                    std::vector<std::pair<double, int>>> &props)
+                                                 LatticePropensities &props)
 {
 
-    // update only sites on the edge
-    for (auto it = lattice->edges.begin(); it != lattice->edges.end(); it++)
-    {
-        int site = it->first;
-
-        if (lattice->edges[site] == 'a')
-        {
-            // find relevant adsorption reactions
-            // the species on adsoprtion sites will always be empty so dependence
-            // graph will point to all adsorption reactions
-            std::vector<int> &potential_reactions = dependents[lattice->sites[site].species];
+    // the species on adsorption sites is always empty, so the dependency
+    // graph of empty points to all adsorption reactions. Their propensity
+    // at any one adsorbable site depends only on the solution.
+    std::vector<int> &potential_reactions = dependents[SPECIES_EMPTY];
 
-            for (int i = 0; i < static_cast<int>(potential_reactions.size()); i++)
-            {
-
-                unsigned long int reaction_id = potential_reactions[i];
-                LatticeReaction reaction = reactions[reaction_id];
-
-                if (reaction.type == Type::ADSORPTION)
-                {
+    for (int i = 0; i < static_cast<int>(potential_reactions.size()); i++)
+    {
 
-                    int other_reactant_id = (reaction.reactants[0] == lattice->sites[site].species) ? 1 : 0;
+        unsigned long int reaction_id = potential_reactions[i];
+        LatticeReaction &reaction = reactions[reaction_id];
 
-                    if (state[reaction.reactants[other_reactant_id]] != 0)
-                    {
+        if (reaction.type == Type::ADSORPTION)
+        {
 
-                        double new_propensity = compute_propensity(1, state[reaction.reactants[other_reactant_id]], reaction_id, lattice);
+            int other_reactant_id = (reaction.reactants[0] == SPECIES_EMPTY) ? 1 : 0;
+            int count = state[reaction.reactants[other_reactant_id]];
 
-                        lattice_update_function(LatticeUpdate{
-                                                    .index = reaction_id,
-                                                    .propensity = new_propensity,
-                                                    .site_one = site,
-                                                    .site_two = SITE_HOMOGENEOUS},
-                                                props);
-                    }
-                }
+            double site_propensity = 0.0;
+            if (count != 0)
+            {
+                site_propensity = compute_propensity(1, count, reaction_id, lattice);
             }
+
+            props.set_adsorption(reaction_id, site_propensity);
         }
     }
+
+    props.set_adsorbable_sites(lattice->edges.number_of_adsorbable());
 } // update_adsorp_props()
 
 /* ---------------------------------------------------------------------- */
@@ -207,34 +191,13 @@ double LatticeReactionNetwork::compute_propensity(int num_one, int num_two,
                                                   int react_id, std::unique_ptr<Lattice> &lattice, int site_id)
 {
 
-    LatticeReaction reaction = reactions[react_id];
+    LatticeReaction &reaction = reactions[react_id];
 
     double p, k;
 
     if (reaction.type == Type::REDUCTION || reaction.type == Type::OXIDATION)
     {
-        bool reduction_in = (reaction.type == Type::REDUCTION) ? true : false;
-
-        assert(charge_transfer_style == ChargeTransferStyle::MARCUS ||
-               charge_transfer_style == ChargeTransferStyle::BUTLER_VOLMER);
-
-        if (charge_transfer_style == ChargeTransferStyle::MARCUS)
-        {
-            k = get_marcus_rate_coefficient(reaction.dG, reaction.prefactor,
-                                            reaction.reorganization_energy,
-                                            reaction.electron_tunneling_coefficient,
-                                            g_e, static_cast<float>(lattice->sites[site_id].k) * lattice->latconst,
-                                            temperature, reduction_in);
-        }
-        else
-        {
-            k = get_butler_volmer_rate_coefficient(reaction.dG,
-                                                   reaction.prefactor,
-                                                   reaction.charge_transfer_coefficient,
-                                                   reaction.electron_tunneling_coefficient,
-                                                   g_e, static_cast<float>(lattice->sites[site_id].k) * lattice->latconst,
-                                                   temperature, reduction_in);
-        }
+        k = get_charge_transfer_rate(react_id, lattice->sites[site_id].k, lattice);
     }
     else
     {
@@ -258,20 +221,24 @@ double LatticeReactionNetwork::compute_propensity(int num_one, int num_two,
 /* ---------------------------------------------------------------------- */
 
 bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &lattice,
-                                                  std::unordered_map<std::string,
-                                                                     std::vector<std::pair<double, int>>> &props,
+                                                  LatticePropensities &props,
                                                   int next_reaction, int site_one, int site_two,
                                                   long double &prop_sum, int &active_indices,
                                                   bool &flip_sites)
 {
 
+    // flip_sites comes in as the solver's draw of which way round two
+    // products go, and goes out as whether they went the other way
+    bool flip_products = flip_sites;
+    flip_sites = false;
+
     LatticeReaction reaction = reactions[next_reaction];
 
     if (reaction.type == Type::ADSORPTION)
     {
 
-        assert(lattice->edges.find(site_one) != lattice->edges.end());
-        assert(lattice->sites.find(site_one) != lattice->sites.end());
+        assert(lattice->edges.contains(site_one));
+        assert(lattice->sites.contains(site_one));
         assert(lattice->edges[site_one] == 'a');
         assert(lattice->sites[site_one].species == SPECIES_EMPTY);
         assert(site_two == SITE_HOMOGENEOUS);
@@ -296,20 +263,20 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
             clear_site(lattice, props, site_new, site_one, prop_sum, active_indices);
 
             // new site can adsorb
-            lattice->edges[site_new] = 'a';
+            lattice->edges.set(site_new, 'a');
             lattice->edges.erase(site_one);
         }
         else
         {
-            lattice->edges[site_one] = 'd';
+            lattice->edges.set(site_one, 'd');
         }
         return true;
     } // ADSORPTION
     else if (reaction.type == Type::DESORPTION)
     {
 
-        assert(lattice->edges.find(site_one) != lattice->edges.end());
-        assert(lattice->sites.find(site_one) != lattice->sites.end());
+        assert(lattice->edges.contains(site_one));
+        assert(lattice->sites.contains(site_one));
         assert(lattice->sites[site_one].species == reaction.reactants[0]);
         assert(site_two == SITE_HOMOGENEOUS);
 
@@ -317,23 +284,28 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
         clear_site(lattice, props, site_one, std::optional<int>(), prop_sum, active_indices);
         clear_site_helper(props, site_one, SITE_HOMOGENEOUS, prop_sum, active_indices);
 
-        lattice->edges[site_one] = 'a';
+        lattice->edges.set(site_one, 'a');
 
         if (is_add_sites)
         {
 
-            // site behind can now adsorb or desorb
+            // site behind can now adsorb or desorb. There is none
+            // behind a site at k = 0, whose k - 1 wraps around and is
+            // outside the grid.
             std::tuple<uint32_t, uint32_t, uint32_t> key = {lattice->sites[site_one].i,
                                                             lattice->sites[site_one].j,
                                                             lattice->sites[site_one].k - 1};
-            int id = lattice->loc_map[key];
-            if (lattice->sites[id].species == SPECIES_EMPTY)
+            if (lattice->loc_map.contains(key))
             {
-                lattice->edges[id] = 'a';
-            }
-            else
-            {
-                lattice->edges[id] = 'd';
+                int id = lattice->loc_map[key];
+                if (lattice->sites[id].species == SPECIES_EMPTY)
+                {
+                    lattice->edges.set(id, 'a');
+                }
+                else
+                {
+                    lattice->edges.set(id, 'd');
+                }
             }
             // delete site done in propensity update
             // so that id can be used to find site below
@@ -349,13 +321,13 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
         if (reaction.number_of_reactants == 1)
         {
             assert(lattice->sites[site_one].species == reaction.reactants[0]);
-            assert(lattice->sites.find(site_one) != lattice->sites.end());
+            assert(lattice->sites.contains(site_one));
             assert(site_two == SITE_SELF_REACTION);
             lattice->sites[site_one].species = reaction.products[0];
 
             clear_site(lattice, props, site_one, std::optional<int>(), prop_sum, active_indices);
 
-            if ((lattice->edges.find(site_one) != lattice->edges.end()) && (lattice->edges[site_one] == 'd'))
+            if ((lattice->edges.contains(site_one)) && (lattice->edges[site_one] == 'd'))
             {
 
                 clear_site_helper(props, site_one, SITE_HOMOGENEOUS, prop_sum, active_indices);
@@ -364,9 +336,8 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
         else
         {
             // randomly assign products to sites
-            assert(lattice->sites.find(site_two) != lattice->sites.end());
-            double r1 = sampler.generate();
-            if (r1 <= 0.5)
+            assert(lattice->sites.contains(site_two));
+            if (!flip_products)
             {
                 lattice->sites[site_one].species = reaction.products[0];
                 lattice->sites[site_two].species = reaction.products[1];
@@ -379,19 +350,19 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
                 flip_sites = true;
             }
 
-            if (lattice->edges.find(site_one) != lattice->edges.end())
+            if (lattice->edges.contains(site_one))
             {
 
                 if ((lattice->edges[site_one] == 'a') && (lattice->sites[site_one].species != SPECIES_EMPTY))
                 {
-                    lattice->edges[site_one] = 'd';
+                    lattice->edges.set(site_one, 'd');
                     clear_site_helper(props, site_one, SITE_HOMOGENEOUS, prop_sum, active_indices);
                 }
                 if (lattice->edges[site_one] == 'd')
                 {
                     if (lattice->sites[site_one].species == SPECIES_EMPTY)
                     {
-                        lattice->edges[site_one] = 'a';
+                        lattice->edges.set(site_one, 'a');
 
                         // remove site above if it exists
                         if (is_add_sites)
@@ -399,7 +370,7 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
                             std::tuple<uint32_t, uint32_t, uint32_t> key = {lattice->sites[site_one].i,
                                                                             lattice->sites[site_one].j,
                                                                             lattice->sites[site_one].k + 1};
-                            if (lattice->loc_map.find(key) != lattice->loc_map.end())
+                            if (lattice->loc_map.contains(key))
                             {
                                 int site_above = lattice->loc_map[key];
                                 lattice->delete_site(site_above);
@@ -416,19 +387,19 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
                 }
             }
 
-            if (lattice->edges.find(site_two) != lattice->edges.end())
+            if (lattice->edges.contains(site_two))
             {
 
                 if ((lattice->edges[site_two] == 'a') && (lattice->sites[site_two].species != SPECIES_EMPTY))
                 {
-                    lattice->edges[site_two] = 'd';
+                    lattice->edges.set(site_two, 'd');
                     clear_site_helper(props, site_two, SITE_HOMOGENEOUS, prop_sum, active_indices);
                 }
                 if (lattice->edges[site_two] == 'd')
                 {
                     if (lattice->sites[site_two].species == SPECIES_EMPTY)
                     {
-                        lattice->edges[site_two] = 'a';
+                        lattice->edges.set(site_two, 'a');
 
                         // remove site above if it exists
                         if (is_add_sites)
@@ -436,7 +407,7 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
                             std::tuple<uint32_t, uint32_t, uint32_t> key = {lattice->sites[site_two].i,
                                                                             lattice->sites[site_two].j,
                                                                             lattice->sites[site_two].k + 1};
-                            if (lattice->loc_map.find(key) != lattice->loc_map.end())
+                            if (lattice->loc_map.contains(key))
                             {
                                 int site_above = lattice->loc_map[key];
                                 lattice->delete_site(site_above);
@@ -460,8 +431,8 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
     } // HOMOGENEOUS_SOLID OR REDUCTION OR OXIDATION
     else if (reaction.type == Type::DIFFUSION)
     {
-        assert(lattice->sites.find(site_one) != lattice->sites.end());
-        assert(lattice->sites.find(site_two) != lattice->sites.end());
+        assert(lattice->sites.contains(site_one));
+        assert(lattice->sites.contains(site_two));
 
         int empty_site;
         int other_site;
@@ -490,22 +461,22 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
         clear_site(lattice, props, site_one, site_two, prop_sum, active_indices);
         clear_site(lattice, props, site_two, std::optional<int>(), prop_sum, active_indices);
 
-        if (lattice->edges.find(empty_site) != lattice->edges.end())
+        if (lattice->edges.contains(empty_site))
         {
 
             if (lattice->edges[empty_site] == 'a')
             {
-                lattice->edges[empty_site] = 'd';
+                lattice->edges.set(empty_site, 'd');
                 clear_site_helper(props, empty_site, SITE_HOMOGENEOUS, prop_sum, active_indices);
             }
         }
 
-        if (lattice->edges.find(other_site) != lattice->edges.end())
+        if (lattice->edges.contains(other_site))
         {
 
             if (lattice->edges[other_site] == 'd')
             {
-                lattice->edges[other_site] = 'a';
+                lattice->edges.set(other_site, 'a');
             }
         }
 
@@ -520,13 +491,9 @@ bool LatticeReactionNetwork::update_state_lattice(std::unique_ptr<Lattice> &latt
 /* ---------------------------------------------------------------------- */
 
 bool LatticeReactionNetwork::update_propensities(std::unique_ptr<Lattice> &lattice,
-                                                 std::function<void(LatticeUpdate lattice_update,
-                                                                    std::unordered_map<std::string,
-                                                                                       std::vector<std::pair<double, int>>> &props)>
-                                                     update_function,
+                                                 LatticeSolver &solver,
                                                  int next_reaction, int site_one, int site_two,
-                                                 std::unordered_map<std::string,
-                                                                    std::vector<std::pair<double, int>>> &props)
+                                                 LatticePropensities &props)
 {
 
     LatticeReaction reaction = reactions[next_reaction];
@@ -534,11 +501,11 @@ bool LatticeReactionNetwork::update_propensities(std::unique_ptr<Lattice> &latti
     if (reaction.type == Type::ADSORPTION)
     {
         // state already updated
-        assert(lattice->sites.find(site_one) != lattice->sites.end());
+        assert(lattice->sites.contains(site_one));
         assert(lattice->sites[site_one].species == reaction.products[0]);
         assert(site_two == SITE_HOMOGENEOUS);
 
-        relevant_react(lattice, update_function, site_one, std::optional<int>(), props);
+        relevant_react(lattice, solver, site_one, std::optional<int>(), props);
 
         if (is_add_sites)
         {
@@ -548,7 +515,7 @@ bool LatticeReactionNetwork::update_propensities(std::unique_ptr<Lattice> &latti
                                                             lattice->sites[site_one].k + 1};
             int site_new = lattice->loc_map[key];
 
-            relevant_react(lattice, update_function, site_new, site_one, props);
+            relevant_react(lattice, solver, site_new, site_one, props);
         }
 
         return true;
@@ -559,11 +526,11 @@ bool LatticeReactionNetwork::update_propensities(std::unique_ptr<Lattice> &latti
         if (!is_add_sites)
         {
             // reaction already happended
-            assert(lattice->sites.find(site_one) != lattice->sites.end());
+            assert(lattice->sites.contains(site_one));
             assert(lattice->sites[site_one].species == SPECIES_EMPTY);
             assert(site_two == SITE_HOMOGENEOUS);
 
-            relevant_react(lattice, update_function, site_one, std::optional<int>(), props);
+            relevant_react(lattice, solver, site_one, std::optional<int>(), props);
         }
         else if (is_add_sites)
         {
@@ -573,11 +540,11 @@ bool LatticeReactionNetwork::update_propensities(std::unique_ptr<Lattice> &latti
                                                             lattice->sites[site_one].j,
                                                             lattice->sites[site_one].k - 1};
             lattice->delete_site(site_one);
-            if (lattice->loc_map.find(key) != lattice->loc_map.end())
+            if (lattice->loc_map.contains(key))
             {
                 int site_below = lattice->loc_map[key];
-                assert(lattice->sites.find(site_below) != lattice->sites.end());
-                relevant_react(lattice, update_function, site_below, std::optional<int>(), props);
+                assert(lattice->sites.contains(site_below));
+                relevant_react(lattice, solver, site_below, std::optional<int>(), props);
             }
         }
 
@@ -590,25 +557,25 @@ bool LatticeReactionNetwork::update_propensities(std::unique_ptr<Lattice> &latti
 
         if (reaction.number_of_reactants == 1)
         {
-            assert(lattice->sites.find(site_one) != lattice->sites.end());
+            assert(lattice->sites.contains(site_one));
             assert(lattice->sites[site_one].species == reaction.products[0]);
             assert(site_two == SITE_SELF_REACTION);
 
-            relevant_react(lattice, update_function, site_one, std::optional<int>(), props);
+            relevant_react(lattice, solver, site_one, std::optional<int>(), props);
         }
         else
         {
-            assert(lattice->sites.find(site_two) != lattice->sites.end());
-            relevant_react(lattice, update_function, site_one, site_two, props);
-            relevant_react(lattice, update_function, site_two, std::optional<int>(), props);
+            assert(lattice->sites.contains(site_two));
+            relevant_react(lattice, solver, site_one, site_two, props);
+            relevant_react(lattice, solver, site_two, std::optional<int>(), props);
         }
         return false;
     } // HOMOGENEOUS_SOLID
     else if (reaction.type == Type::DIFFUSION)
     {
 
-        relevant_react(lattice, update_function, site_one, site_two, props);
-        relevant_react(lattice, update_function, site_two, std::optional<int>(), props);
+        relevant_react(lattice, solver, site_one, site_two, props);
+        relevant_react(lattice, solver, site_two, std::optional<int>(), props);
 
         return false;
     } // DIFFUSION
@@ -621,8 +588,7 @@ bool LatticeReactionNetwork::update_propensities(std::unique_ptr<Lattice> &latti
 /* ---------------------------------------------------------------------- */
 
 void LatticeReactionNetwork::clear_site(std::unique_ptr<Lattice> &lattice,
-                                        std::unordered_map<std::string,
-                                                           std::vector<std::pair<double, int>>> &props,
+                                        LatticePropensities &props,
                                         int site, std::optional<int> ignore_neighbor,
                                         long double &prop_sum, int &active_indices)
 {
@@ -647,45 +613,33 @@ void LatticeReactionNetwork::clear_site(std::unique_ptr<Lattice> &lattice,
 /* ---------------------------------------------------------------------- */
 
 // deal with active_indices
-void LatticeReactionNetwork::clear_site_helper(std::unordered_map<std::string,
-                                                                  std::vector<std::pair<double, int>>> &props,
+void LatticeReactionNetwork::clear_site_helper(LatticePropensities &props,
                                                int site_one, int site_two, long double &prop_sum,
                                                int &active_indices)
 {
 
-    std::string combo = make_string(site_one, site_two);
+    // pairs which never had a reaction have no slot to clear
+    std::optional<uint32_t> slot = props.find(site_one, site_two);
+    if (!slot)
+        return;
 
-    // check if first time key has been added
-    if (props.find(combo) == props.end())
-    {
-        // key not found
-        props[combo].reserve(reactions.size());
-    }
-    else
-    {
-        // already exists, clear vector to update
-        std::vector<std::pair<double, int>> vec = props[combo];
-        prop_sum -= sum_row(combo, props);
-
-        active_indices -= props[combo].size();
-
-        props[combo].clear();
-    }
+    // already exists, clear to update
+    prop_sum -= props.sum(slot.value());
+    active_indices -= props.size(slot.value());
+    props.clear(slot.value());
 
 } // clear_site_helper
 
 /* ---------------------------------------------------------------------- */
 
 void LatticeReactionNetwork::relevant_react(std::unique_ptr<Lattice> &lattice,
-                                            std::function<void(LatticeUpdate lattice_update, std::unordered_map<std::string,
-                                                                                                                std::vector<std::pair<double, int>>> &props)>
-                                                update_function,
+                                            LatticeSolver &solver,
                                             int site, std::optional<int> ignore_neighbor,
-                                            std::unordered_map<std::string, std::vector<std::pair<double, int>>> &props)
+                                            LatticePropensities &props)
 {
 
     // all reactions related to central site
-    assert(lattice->sites.find(site) != lattice->sites.end());
+    assert(lattice->sites.contains(site));
     std::vector<int> potential_reactions = dependents[lattice->sites[site].species];
 
     // compute and add new propensities
@@ -703,19 +657,19 @@ void LatticeReactionNetwork::relevant_react(std::unique_ptr<Lattice> &lattice,
             // if reaction produces a solid product make sure on edge
             if (reaction.type == Type::DESORPTION)
             {
-                if ((lattice->edges.find(site) != lattice->edges.end()) &&
+                if ((lattice->edges.contains(site)) &&
                     (lattice->edges[site] == 'd'))
                 {
                     // in can_desorb vector
 
                     double new_propensity = compute_propensity(1, 0, reaction_id, lattice);
 
-                    update_function(LatticeUpdate{
-                                        .index = reaction_id,
-                                        .propensity = new_propensity,
-                                        .site_one = site,
-                                        .site_two = SITE_HOMOGENEOUS},
-                                    props);
+                    solver.update(LatticeUpdate{
+                                      .index = reaction_id,
+                                      .propensity = new_propensity,
+                                      .site_one = site,
+                                      .site_two = SITE_HOMOGENEOUS},
+                                  props);
                 }
             }
             else
@@ -723,12 +677,12 @@ void LatticeReactionNetwork::relevant_react(std::unique_ptr<Lattice> &lattice,
                 // oxidation / reduction / homogeneous solid with one reactant
                 double new_propensity = compute_propensity(1, 0, reaction_id, lattice, site);
 
-                update_function(LatticeUpdate{
-                                    .index = reaction_id,
-                                    .propensity = new_propensity,
-                                    .site_one = site,
-                                    .site_two = SITE_SELF_REACTION},
-                                props);
+                solver.update(LatticeUpdate{
+                                  .index = reaction_id,
+                                  .propensity = new_propensity,
+                                  .site_one = site,
+                                  .site_two = SITE_SELF_REACTION},
+                              props);
             }
 
         } // single reactant
@@ -760,18 +714,18 @@ void LatticeReactionNetwork::relevant_react(std::unique_ptr<Lattice> &lattice,
 
                     if (!ignore_neighbor || (ignore_neighbor && neighbor != ignore_neighbor.value()))
                     {
-                        assert(lattice->sites.find(neighbor) != lattice->sites.end());
+                        assert(lattice->sites.contains(neighbor));
                         if (lattice->sites[neighbor].species == reaction.reactants[other_reactant_id])
                         {
 
                             double new_propensity = compute_propensity(1, 1, reaction_id, lattice);
 
-                            update_function(LatticeUpdate{
-                                                .index = reaction_id,
-                                                .propensity = new_propensity,
-                                                .site_one = site,
-                                                .site_two = neighbor},
-                                            props);
+                            solver.update(LatticeUpdate{
+                                              .index = reaction_id,
+                                              .propensity = new_propensity,
+                                              .site_one = site,
+                                              .site_two = neighbor},
+                                          props);
                         }
                     } // ignore_neighbor
                 } // for neigh
@@ -782,15 +736,6 @@ void LatticeReactionNetwork::relevant_react(std::unique_ptr<Lattice> &lattice,
 
 /* ---------------------------------------------------------------------- */
 
-std::string LatticeReactionNetwork::make_string(int site_one, int site_two)
-{
-
-    return (site_one > site_two) ? std::to_string(site_one) + "." +
-                                       std::to_string(site_two)
-                                 : std::to_string(site_two) + "." + std::to_string(site_one);
-
-} // make_string
-
 std::string LatticeReactionNetwork::make_string(std::vector<int> vec)
 {
     std::sort(vec.begin(), vec.end());
@@ -807,20 +752,6 @@ std::string LatticeReactionNetwork::make_string(std::vector<int> vec)
 
 /* ---------------------------------------------------------------------- */
 
-double LatticeReactionNetwork::sum_row(std::string hash, std::unordered_map<std::string,
-                                                                            std::vector<std::pair<double, int>>> &props)
-{
-
-    double sum = 0;
-    for (auto it = props[hash].begin(); it != props[hash].end(); it++)
-    {
-        sum += it->first;
-    }
-    return sum;
-} // sum_row()
-
-/* ---------------------------------------------------------------------- */
-
 void LatticeReactionNetwork::init_reaction_network(SqlConnection &reaction_network_database,
                                                    SqlConnection &initial_state_database,
                                                    LatticeParameters parameters)
@@ -873,6 +804,28 @@ void LatticeReactionNetwork::init_reaction_network(SqlConnection &reaction_netwo
         species_id = initial_state_row.species_id;
         initial_state.homogeneous[species_id] = initial_state_row.count;
     }
+
+    // loading reactions, from the model cache when there is a valid one
+    uint64_t fingerprint = database_fingerprint(
+        reaction_network_database.database_file_path, 0);
+
+    ModelCacheReader cache_reader;
+    bool from_cache = !parameters.model_cache.empty() &&
+                      cache_reader.open(parameters.model_cache,
+                                        lattice_model_cache, fingerprint) &&
+                      read_cache(cache_reader) &&
+                      reactions.size() == metadata_row.number_of_reactions &&
+                      dependents.size() == metadata_row.number_of_species;
+
+    if (from_cache)
+    {
+        std::cerr << time::time_stamp() << "read " << reactions.size()
+                  << " reactions from model cache " << parameters.model_cache << '\n';
+        return;
+    }
+
+    reactions.clear();
+    dependents.clear();
     reactions.reserve(metadata_row.number_of_reactions);
 
     // loading reactions
@@ -884,6 +837,19 @@ void LatticeReactionNetwork::init_reaction_network(SqlConnection &reaction_netwo
     assert(reactions.size() == metadata_row.number_of_reactions);
 
     compute_dependents();
+
+    if (!parameters.model_cache.empty())
+    {
+        ModelCacheWriter cache_writer(parameters.model_cache,
+                                      lattice_model_cache, fingerprint);
+        write_cache(cache_writer);
+        if (cache_writer.finish())
+            std::cerr << time::time_stamp() << "wrote model cache "
+                      << parameters.model_cache << '\n';
+        else
+            std::cerr << time::time_stamp() << "could not write model cache "
+                      << parameters.model_cache << '\n';
+    }
 } // init_reaction_network()
 
 /* ---------------------------------------------------------------------- */
@@ -1035,6 +1001,51 @@ void LatticeReactionNetwork::compute_dependents()
 
 /* ---------------------------------------------------------------------- */
 
+void LatticeReactionNetwork::write_cache(ModelCacheWriter &cache)
+{
+    cache.write(reactions);
+
+    // dependents is written flattened, as the row lengths followed by
+    // the rows one after another
+    std::vector<int> row_sizes;
+    std::vector<int> entries;
+    for (std::vector<int> &row : dependents)
+    {
+        row_sizes.push_back(row.size());
+        entries.insert(entries.end(), row.begin(), row.end());
+    }
+
+    cache.write(row_sizes);
+    cache.write(entries);
+} // write_cache()
+
+/* ---------------------------------------------------------------------- */
+
+bool LatticeReactionNetwork::read_cache(ModelCacheReader &cache)
+{
+    std::vector<int> row_sizes;
+    std::vector<int> entries;
+    if (!cache.read(reactions) || !cache.read(row_sizes) || !cache.read(entries))
+        return false;
+
+    dependents.assign(row_sizes.size(), std::vector<int>());
+
+    unsigned long int position = 0;
+    for (unsigned long int i = 0; i < row_sizes.size(); i++)
+    {
+        if (row_sizes[i] < 0 || position + row_sizes[i] > entries.size())
+            return false;
+
+        dependents[i].assign(entries.begin() + position,
+                             entries.begin() + position + row_sizes[i]);
+        position += row_sizes[i];
+    }
+
+    return position == entries.size();
+} // read_cache()
+
+/* ---------------------------------------------------------------------- */
+
 void LatticeReactionNetwork::update_state_solution(std::vector<int> &state,
                                                    int reaction_index)
 {
@@ -1063,7 +1074,7 @@ void LatticeReactionNetwork::update_state_solution(std::vector<int> &state,
 
 /* ---------------------------------------------------------------------- */
 
-void LatticeReactionNetwork::update_propensities(std::function<void(Update update)> update_function,
+void LatticeReactionNetwork::update_propensities(LatticeSolver &solver,
                                                  std::vector<int> &state, int next_reaction,
                                                  std::unique_ptr<Lattice> &lattice)
 {
@@ -1100,7 +1111,7 @@ void LatticeReactionNetwork::update_propensities(std::function<void(Update updat
 
             double new_propensity = compute_propensity(state, reaction_index, lattice);
 
-            update_function(Update{
+            solver.update(Update{
                 .index = reaction_index,
                 .propensity = new_propensity});
         }
@@ -1112,7 +1123,7 @@ void LatticeReactionNetwork::update_propensities(std::function<void(Update updat
 double LatticeReactionNetwork::compute_propensity(std::vector<int> &state, int reaction_index,
                                                   std::unique_ptr<Lattice> &lattice)
 {
-    LatticeReaction reaction = reactions[reaction_index];
+    LatticeReaction &reaction = reactions[reaction_index];
 
     double p, k;
 
@@ -1134,20 +1145,7 @@ double LatticeReactionNetwork::compute_propensity(std::vector<int> &state, int r
 
     if (reaction.type == Type::OXIDATION || reaction.type == Type::REDUCTION)
     {
-        bool reduction_in = (reaction.type == Type::REDUCTION) ? true : false;
-
-        if (charge_transfer_style == ChargeTransferStyle::MARCUS)
-        {
-            k = get_marcus_rate_coefficient(reaction.dG, reaction.prefactor, reaction.reorganization_energy,
-                                            reaction.electron_tunneling_coefficient, g_e, lattice->get_maxz(),
-                                            temperature, reduction_in);
-        }
-        else
-        {
-            k = get_butler_volmer_rate_coefficient(reaction.dG, reaction.prefactor, reaction.charge_transfer_coefficient,
-                                                   reaction.electron_tunneling_coefficient, g_e, lattice->get_maxz(),
-                                                   temperature, reduction_in);
-        }
+        k = get_charge_transfer_rate(reaction_index, lattice->get_maxk(), lattice);
     }
     else
     {
@@ -1220,9 +1218,8 @@ LatticeWriteCutoffSql LatticeReactionNetwork::cutoff_history_element_to_sql(
 void LatticeReactionNetwork::checkpoint(SqlReader<LatticeReadStateSql> state_reader,
                                         SqlReader<LatticeReadCutoffSql> cutoff_reader,
                                         SqlReader<LatticeReadTrajectoriesSql>,
-                                        std::map<int, LatticeState> &temp_seed_state_map,
+                                        SeedStateStore<LatticeState> &temp_seed_state_map,
                                         std::map<int, int> &temp_seed_step_map,
-                                        SeedQueue &temp_seed_queue,
                                         std::map<int, double> &temp_seed_time_map,
                                         LatticeReactionNetwork &model)
 {
@@ -1255,18 +1252,15 @@ void LatticeReactionNetwork::checkpoint(SqlReader<LatticeReadStateSql> state_rea
     {
         int initial_latconst = model.initial_state.lattice->latconst;
 
-        // create a default lattice for each simulation
-        while (std::optional<unsigned long int> maybe_seed =
-                   temp_seed_queue.get_seed())
-        {
-            unsigned long int seed = maybe_seed.value();
-
-            // Each LatticeState must have its own lattice to point to
-            std::unique_ptr<Lattice> default_lattice(new Lattice(initial_latconst));
-
-            LatticeState default_state = {model.initial_state.homogeneous, std::move(default_lattice)};
-            temp_seed_state_map.insert(std::make_pair(seed, std::move(default_state)));
-        }
+        // each simulation starts from an empty lattice which the sites
+        // are added to one by one. Each LatticeState must have its own
+        // lattice to point to.
+        temp_seed_state_map.set_default(
+            [&model, initial_latconst]()
+            {
+                std::unique_ptr<Lattice> default_lattice(new Lattice(initial_latconst));
+                return LatticeState(model.initial_state.homogeneous, std::move(default_lattice));
+            });
 
         // go through interrupt_state and add each site one by one or update homogeneous region
         while (std::optional<LatticeReadStateSql> maybe_state_row = state_reader.next())
@@ -1294,38 +1288,22 @@ void LatticeReactionNetwork::checkpoint(SqlReader<LatticeReadStateSql> state_rea
                 // update site occupancy
                 std::tuple<uint32_t, uint32_t, uint32_t> key = {i, j, k};
                 int site_id = temp_seed_state_map[state_row.seed].lattice->loc_map[key];
-                assert(temp_seed_state_map[state_row.seed].lattice->sites.find(site_id) != temp_seed_state_map[state_row.seed].lattice->sites.end());
+                assert(temp_seed_state_map[state_row.seed].lattice->sites.contains(site_id));
                 temp_seed_state_map[state_row.seed].lattice->sites[site_id].species = state_row.species_id;
 
                 // if can adsorb, check if species occupies the site
                 if (temp_seed_state_map[state_row.seed].lattice->sites[site_id].can_adsorb && state_row.species_id != SPECIES_EMPTY)
                 {
-                    temp_seed_state_map[state_row.seed].lattice->edges[site_id] = 'd';
+                    temp_seed_state_map[state_row.seed].lattice->edges.set(site_id, 'd');
                 }
             }
         }
     } // dynamic lattice and reading from state
     else
     {
-        // static lattice or dynamic and not reading from state
-        int initial_latconst = model.initial_state.lattice->latconst;
-
-        // create a default lattice for each simulation
-        while (std::optional<unsigned long int> maybe_seed =
-                   temp_seed_queue.get_seed())
-        {
-            unsigned long int seed = maybe_seed.value();
-
-            // Each LatticeState must have its own lattice to point to
-            std::unique_ptr<Lattice> default_lattice(new Lattice(initial_latconst,
-                                                                 model.initial_state.lattice->xhi / initial_latconst,
-                                                                 model.initial_state.lattice->yhi / initial_latconst,
-                                                                 model.initial_state.lattice->zhi / initial_latconst));
-
-            LatticeState default_state = {model.initial_state.homogeneous, std::move(default_lattice)};
-
-            temp_seed_state_map.insert(std::make_pair(seed, std::move(default_state)));
-        }
+        // static lattice or dynamic and not reading from state. The
+        // default copy of the initial state gives each simulation its
+        // own lattice with the initial dimensions.
 
         while (std::optional<LatticeReadStateSql> maybe_state_row = state_reader.next())
         {
@@ -1343,15 +1321,24 @@ void LatticeReactionNetwork::checkpoint(SqlReader<LatticeReadStateSql> state_rea
                 int j = std::get<1>(seed_ijk_map[state_row.seed][state_row.site_mapping]);
                 int k = std::get<2>(seed_ijk_map[state_row.seed][state_row.site_mapping]);
 
-                // update site occupancy
+                // update site occupancy. A static lattice already has
+                // every site the state can refer to.
                 std::tuple<uint32_t, uint32_t, uint32_t> key = {i, j, k};
+                if (!temp_seed_state_map[state_row.seed].lattice->loc_map.contains(key))
+                {
+                    std::cerr << time::time_stamp()
+                              << "interrupt state of seed " << state_row.seed
+                              << " refers to site " << state_row.site_mapping
+                              << ", which is not in the lattice\n";
+                    std::abort();
+                }
                 int site_id = temp_seed_state_map[state_row.seed].lattice->loc_map[key];
                 temp_seed_state_map[state_row.seed].lattice->sites[site_id].species = state_row.species_id;
 
                 // if can adsorb, check if species occupies the site
                 if (temp_seed_state_map[state_row.seed].lattice->sites[site_id].can_adsorb && state_row.species_id != SPECIES_EMPTY)
                 {
-                    temp_seed_state_map[state_row.seed].lattice->edges[site_id] = 'd';
+                    temp_seed_state_map[state_row.seed].lattice->edges.set(site_id, 'd');
                 }
             }
         }
@@ -1359,10 +1346,8 @@ void LatticeReactionNetwork::checkpoint(SqlReader<LatticeReadStateSql> state_rea
         // automatically does this
         if (read_interrupt_states)
         {
-            for (auto it = temp_seed_state_map.begin(); it != temp_seed_state_map.end(); it++)
-            {
-                it->second.lattice->isCheckpoint = true;
-            }
+            temp_seed_state_map.for_each([](unsigned long int, LatticeState &state)
+                                         { state.lattice->isCheckpoint = true; });
         }
     }
 } // checkpoint()
@@ -1374,20 +1359,26 @@ void LatticeReactionNetwork::store_checkpoint(std::vector<LatticeStateHistoryEle
                                               std::vector<LatticeCutoffHistoryElement> &cutoff_packet)
 {
     // Lattice site
-    for (auto site : state.lattice->sites)
+    for (int site_id = 0; site_id < state.lattice->get_nsites(); site_id++)
     {
+        if (!state.lattice->sites.contains(site_id))
+        {
+            continue;
+        }
+
+        Site &site = state.lattice->sites[site_id];
 
         int edge = 0;
-        if (state.lattice->edges.find(site.first) != state.lattice->edges.end())
+        if (state.lattice->edges.contains(site_id))
         {
             edge = 1;
         }
 
         state_packet.push_back(LatticeStateHistoryElement{
             .seed = seed,
-            .species_id = site.second.species,
+            .species_id = site.species,
             .quantity = 1,
-            .site_mapping = static_cast<int>(combine(site.second.i, site.second.j, site.second.k)),
+            .site_mapping = static_cast<int>(combine(site.i, site.j, site.k)),
             .edge = edge});
     }
 
@@ -1427,28 +1418,61 @@ void LatticeReactionNetwork::compute_initial_propensities(std::vector<int> state
 /* ---------------------------------------------------------------------- */
 
 void LatticeReactionNetwork::update_all_propensities(std::unique_ptr<Lattice> &lattice,
-                                                     std::unordered_map<std::string,
-                                                                        std::vector<std::pair<double, int>>> &props,
+                                                     LatticePropensities &props,
                                                      long double &prop_sum, int &active_indices,
-                                                     std::function<void(LatticeUpdate lattice_update,
-                                                                        std::unordered_map<std::string,
-                                                                        std::vector<std::pair<double, int>>> &props)>
-                                                         update_function)
+                                                     LatticeSolver &solver)
 {
 
     // Go through all lattice sites and update their propensities
-    for (auto it = lattice->sites.begin(); it != lattice->sites.end(); it++)
+    for (int site_id = 0; site_id < lattice->get_nsites(); site_id++)
     {
-        std::tuple<uint32_t, uint32_t, uint32_t> key = {it->second.i, it->second.j, it->second.k};
-        int site_id = lattice->loc_map[key];
+        if (!lattice->sites.contains(site_id))
+        {
+            continue;
+        }
 
         clear_site(lattice, props, site_id, std::optional<int>(), prop_sum, active_indices);
-        relevant_react(lattice, update_function, site_id, std::optional<int>(), props);
+        relevant_react(lattice, solver, site_id, std::optional<int>(), props);
     }
 } // update_all_propensities()
 
 /* ---------------------------------------------------------------------- */
 
+double LatticeReactionNetwork::get_charge_transfer_rate(int reaction_id, int k,
+                                                        std::unique_ptr<Lattice> &lattice)
+{
+    double &rate = lattice->layer_rates.get(reaction_id, k, reactions.size(), g_e, temperature);
+
+    if (std::isnan(rate))
+    {
+        LatticeReaction &reaction = reactions[reaction_id];
+        bool reduction_in = (reaction.type == Type::REDUCTION) ? true : false;
+        float distance = static_cast<float>(k) * lattice->latconst;
+
+        assert(charge_transfer_style == ChargeTransferStyle::MARCUS ||
+               charge_transfer_style == ChargeTransferStyle::BUTLER_VOLMER);
+
+        if (charge_transfer_style == ChargeTransferStyle::MARCUS)
+        {
+            rate = get_marcus_rate_coefficient(reaction.dG, reaction.prefactor,
+                                               reaction.reorganization_energy,
+                                               reaction.electron_tunneling_coefficient,
+                                               g_e, distance, temperature, reduction_in);
+        }
+        else
+        {
+            rate = get_butler_volmer_rate_coefficient(reaction.dG, reaction.prefactor,
+                                                      reaction.charge_transfer_coefficient,
+                                                      reaction.electron_tunneling_coefficient,
+                                                      g_e, distance, temperature, reduction_in);
+        }
+    }
+
+    return rate;
+} // get_charge_transfer_rate()
+
+/* ---------------------------------------------------------------------- */
+
 double LatticeReactionNetwork::get_butler_volmer_rate_coefficient(double base_dg,
                                                                   double prefactor, double charge_transfer_coefficient,
                                                                   double electron_tunneling_coefficient,
@@ -16,6 +16,7 @@ See the README file in the top-level RNMC directory.
 #include "../core/sampler.h"
 #include "../core/sql_types.h"
 #include "../core/queues.h"
+#include "../core/model_cache.h"
 
 #include <list>
 #include <vector>
@@ -26,9 +27,6 @@ See the README file in the top-level RNMC directory.
 #include <memory>
 #include <algorithm>
 
-const int SITE_SELF_REACTION = -3;
-const int SITE_HOMOGENEOUS = -2;
-
 const double KB = 8.6173e-5;      // In eV/K
 const double PLANCK = 4.1357e-15; // In eV s
 
@@ -75,6 +73,10 @@ struct LatticeParameters
     bool is_add_sites;
     ChargeTransferStyle charge_transfer_style;
     bool isCheckpoint;
+
+    // model cache file to read the reactions and dependents from, or to
+    // write them to if there is no valid one. See core/model_cache.h.
+    std::string model_cache = "";
 };
 
 struct LatticeReaction
@@ -117,86 +119,59 @@ public:
 
     /* -------------------------------- Updates Global ----------------------------- */
 
-    void update_state(std::unique_ptr<Lattice> &lattice, std::unordered_map<std::string, 
-                      std::vector<std::pair<double, int>>> &props,
+    void update_state(std::unique_ptr<Lattice> &lattice, LatticePropensities &props,
                       std::vector<int> &state, int next_reaction,
                       std::optional<int> site_one, std::optional<int> site_two,
                       long double &prop_sum, int &active_indices, bool &flip_sites);
 
     void update_propensities(std::unique_ptr<Lattice> &lattice, std::vector<int> &state,
-                             std::function<void(Update update)> update_function,
-                             std::function<void(LatticeUpdate lattice_update, 
-                             std::unordered_map<std::string,
-                             std::vector<std::pair<double, int>>> &props)>
-                             lattice_update_function, int next_reaction, 
+                             LatticeSolver &solver, int next_reaction, 
                              std::optional<int> site_one, std::optional<int> site_two,
-                             std::unordered_map<std::string, std::vector<std::pair<double, int>>> &props);
+                             LatticePropensities &props);
 
     void update_adsorp_state(std::unique_ptr<Lattice> &lattice, 
-                             std::unordered_map<std::string, 
-                             std::vector<std::pair<double, int>>> &props,
+                             LatticePropensities &props,
                              long double &prop_sum, int &active_indices);
 
     void update_adsorp_props(std::unique_ptr<Lattice> &lattice, 
-                             std::function<void(LatticeUpdate lattice_update, 
-                             std::unordered_map<std::string, 
-                             std::vector<std::pair<double, int>>> &props)> lattice_update_function,
                              std::vector<int> &state,
-                             std::unordered_map<std::string, std::vector<std::pair<double, int>>> &props);
+                             LatticePropensities &props);
 
     /* -------------------------------- Updates Lattice ----------------------------- */
 
     bool update_state_lattice(std::unique_ptr<Lattice> &lattice, 
-                              std::unordered_map<std::string, 
-                              std::vector<std::pair<double, int>>> &props,
+                              LatticePropensities &props,
                               int next_reaction, int site_one, int site_two,
                               long double &prop_sum, int &active_indices, bool &flip_sites);
 
     void clear_site(std::unique_ptr<Lattice> &lattice, 
-                    std::unordered_map<std::string, 
-                    std::vector<std::pair<double, int>>> &props,
+                    LatticePropensities &props,
                     int site, std::optional<int> ignore_neighbor,
                     long double &prop_sum, int &active_indices);
 
-    void clear_site_helper(std::unordered_map<std::string,
-                           std::vector<std::pair<double, int>>> &props,
+    void clear_site_helper(LatticePropensities &props,
                            int site_one, int site_two, long double &prop_sum,
                            int &active_indices);
 
     void relevant_react(std::unique_ptr<Lattice> &lattice, 
-                        std::function<void(LatticeUpdate lattice_update, 
-                        std::unordered_map<std::string, 
-                        std::vector<std::pair<double, int>>> &props)> update_function,
+                        LatticeSolver &solver,
                         int site, std::optional<int> ignore_neighbor,
-                        std::unordered_map<std::string, 
-                        std::vector<std::pair<double, int>>> &props);
+                        LatticePropensities &props);
 
     double compute_propensity(int num_one, int num_two, int react_id, 
                               std::unique_ptr<Lattice> &lattice, int site_id = 0);
 
     bool update_propensities(std::unique_ptr<Lattice> &lattice,
-                             std::function<void(LatticeUpdate lattice_update,
-                                                std::unordered_map<std::string,
-                                                std::vector<std::pair<double, int>>> &props)>
-                                                update_function,
+                             LatticeSolver &solver,
                              int next_reaction, int site_one, int site_two,
-                             std::unordered_map<std::string, 
-                             std::vector<std::pair<double, int>>> &props);
+                             LatticePropensities &props);
 
-    std::string make_string(int site_one, int site_two);
     std::string make_string(std::vector<int> vec);
 
-    double sum_row(std::string hash, std::unordered_map<std::string, 
-                   std::vector<std::pair<double, int>>> &props);
-
     void update_all_propensities(std::unique_ptr<Lattice> &lattice, 
-                                 std::unordered_map<std::string, 
-                                 std::vector<std::pair<double, int>>> &props,
+                                 LatticePropensities &props,
                                  long double &prop_sum, int &active_indices,
-                                 std::function<void(LatticeUpdate lattice_update,
-                                                    std::unordered_map<std::string,
-                                                    std::vector<std::pair<double, int>>> &props)>
-                                                    update_function);
+                                 LatticeSolver &solver);
 
     /* -------------------------- Updates Reaction Network ----------------------------- */
 
@@ -208,10 +183,13 @@ public:
 
     void compute_dependents();
 
+    void write_cache(ModelCacheWriter &cache);
+    bool read_cache(ModelCacheReader &cache);
+
     double compute_propensity(std::vector<int> &state, int reaction_index, 
                               std::unique_ptr<Lattice> &lattice);
 
-    void update_propensities(std::function<void(Update update)> update_function,
+    void update_propensities(LatticeSolver &solver,
                              std::vector<int> &state, int next_reaction, 
                              std::unique_ptr<Lattice> &lattice);
 
@@ -237,9 +215,8 @@ public:
     void checkpoint(SqlReader<LatticeReadStateSql> state_reader,
                     SqlReader<LatticeReadCutoffSql> cutoff_reader,
                     SqlReader<LatticeReadTrajectoriesSql> trajectory_reader,
-                    std::map<int, LatticeState> &temp_seed_state_map,
+                    SeedStateStore<LatticeState> &temp_seed_state_map,
                     std::map<int, int> &temp_seed_step_map,
-                    SeedQueue &temp_seed_queue,
                     std::map<int, double> &temp_seed_time_map,
                     LatticeReactionNetwork &model);
 
@@ -254,6 +231,11 @@ public:
                                               double e_free, double distance,
                                               double temperature, bool reduction);
 
+    // the rate coefficient of a charge transfer reaction in layer k of
+    // the lattice, from the lattice's table of them
+    double get_charge_transfer_rate(int reaction_id, int k,
+                                    std::unique_ptr<Lattice> &lattice);
+
     double get_marcus_rate_coefficient(double base_dg, double prefactor,
                                        double reorganization_energy,
                                        double electron_tunneling_coefficient,
@@ -274,8 +256,6 @@ public:
     bool isCheckpoint;
 
 private:
-    Sampler sampler;
-
     double factor_two;       // rate modifier for reactions with two reactants
     double factor_duplicate; // rate modifier for reactions of form A + A -> ...
 
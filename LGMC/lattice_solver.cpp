@@ -10,7 +10,242 @@ See the README file in the top-level RNMC directory.
 
 #include "lattice_solver.h"
 
-LatticeSolver::LatticeSolver(unsigned long int seed,
+void PropensityTree::resize(uint32_t new_number_of_leaves)
+{
+    uint32_t capacity = offset + 1;
+    number_of_leaves = std::max(number_of_leaves, new_number_of_leaves);
+
+    if (!tree.empty() && number_of_leaves <= capacity)
+        return;
+
+    uint32_t pow2 = 1;
+    while (pow2 < number_of_leaves)
+        pow2 *= 2;
+
+    std::vector<double> new_tree(2 * pow2 - 1, 0.0);
+    if (!tree.empty())
+        std::copy(tree.begin() + offset, tree.end(), new_tree.begin() + pow2 - 1);
+
+    tree = std::move(new_tree);
+    offset = pow2 - 1;
+
+    // every internal node is recomputed here, so nothing is stale
+    for (int parent = (int)offset - 1; parent >= 0; parent--)
+        tree[parent] = tree[2 * parent + 1] + tree[2 * parent + 2];
+
+    stale.clear();
+    is_stale.assign(tree.size(), 0);
+} // resize()
+
+/* ---------------------------------------------------------------------- */
+
+void PropensityTree::refresh()
+{
+    // all leaves are on the same level, so the stale nodes always are
+    while (!stale.empty())
+    {
+        next_stale.clear();
+
+        for (uint32_t node : stale)
+        {
+            is_stale[node] = 0;
+            if (node > 0 && !is_stale[(node - 1) / 2])
+            {
+                is_stale[(node - 1) / 2] = 1;
+                next_stale.push_back((node - 1) / 2);
+            }
+        }
+
+        for (uint32_t parent : next_stale)
+            tree[parent] = tree[2 * parent + 1] + tree[2 * parent + 2];
+
+        std::swap(stale, next_stale);
+    }
+} // refresh()
+
+/* ---------------------------------------------------------------------- */
+
+uint32_t PropensityTree::find(double &value) const
+{
+    uint32_t i = 0;
+    while (i < offset)
+    {
+        uint32_t left_child = 2 * i + 1;
+
+        // rounding can leave value just past the end of a subtree, so
+        // an empty subtree is never entered and a full one is entered
+        // when the other one is empty
+        if (tree[left_child] > 0.0 &&
+            (value <= tree[left_child] || !(tree[left_child + 1] > 0.0)))
+            i = left_child;
+        else
+        {
+            value -= tree[left_child];
+            i = left_child + 1;
+        }
+    }
+    return i - offset;
+} // find()
+
+/* ---------------------------------------------------------------------- */
+
+uint32_t LatticePropensities::slot(int site_one, int site_two)
+{
+    auto inserted = slot_of_key.try_emplace(pair_key(site_one, site_two), slots.size());
+
+    if (inserted.second)
+    {
+        slots.push_back(Slot{.key = inserted.first->first, .offset = 0, .size = 0, .capacity = 0});
+        slot_sums.resize(slots.size());
+    }
+
+    return inserted.first->second;
+} // slot()
+
+/* ---------------------------------------------------------------------- */
+
+std::optional<uint32_t> LatticePropensities::find(int site_one, int site_two) const
+{
+    auto it = slot_of_key.find(pair_key(site_one, site_two));
+
+    if (it == slot_of_key.end())
+        return std::optional<uint32_t>();
+
+    return it->second;
+} // find()
+
+/* ---------------------------------------------------------------------- */
+
+void LatticePropensities::add(uint32_t slot, double propensity, int reaction_id)
+{
+    Slot &s = slots[slot];
+
+    if (s.size == s.capacity)
+    {
+        uint32_t capacity = std::max(4u, 2 * s.capacity);
+        unsigned int size_class = __builtin_ctz(capacity);
+        if (free_chunks.size() <= size_class)
+            free_chunks.resize(size_class + 1);
+
+        uint32_t offset;
+        if (free_chunks[size_class].empty())
+        {
+            offset = pool.size();
+            pool.resize(pool.size() + capacity);
+        }
+        else
+        {
+            offset = free_chunks[size_class].back();
+            free_chunks[size_class].pop_back();
+        }
+
+        std::copy(pool.begin() + s.offset, pool.begin() + s.offset + s.size,
+                  pool.begin() + offset);
+
+        if (s.capacity > 0)
+            free_chunks[__builtin_ctz(s.capacity)].push_back(s.offset);
+
+        s.offset = offset;
+        s.capacity = capacity;
+    }
+
+    pool[s.offset + s.size] = LatticePropensity{.propensity = propensity, .reaction_id = reaction_id};
+    s.size++;
+
+    slot_sums.add(slot, propensity);
+} // add()
+
+/* ---------------------------------------------------------------------- */
+
+void LatticePropensities::clear(uint32_t slot)
+{
+    slots[slot].size = 0;
+    slot_sums.set(slot, 0.0);
+} // clear()
+
+/* ---------------------------------------------------------------------- */
+
+void LatticePropensities::select(double value, uint32_t &slot, uint32_t &entry) const
+{
+    slot = slot_sums.find(value);
+
+    const LatticePropensity *first = entries(slot);
+    double partial = 0.0;
+
+    // the last non zero entry takes whatever rounding leaves over
+    for (uint32_t i = 0; i < slots[slot].size; i++)
+    {
+        if (!(first[i].propensity > 0.0))
+            continue;
+
+        entry = i;
+        partial += first[i].propensity;
+        if (value <= partial)
+            break;
+    }
+} // select()
+
+/* ---------------------------------------------------------------------- */
+
+void LatticePropensities::set_adsorption(int reaction_id, double site_propensity)
+{
+    unsigned long int channel = std::find(adsorption_reactions.begin(),
+                                          adsorption_reactions.end(), reaction_id) -
+                                adsorption_reactions.begin();
+
+    if (channel == adsorption_reactions.size())
+    {
+        if (site_propensity == 0.0)
+            return;
+
+        adsorption_reactions.push_back(reaction_id);
+        adsorption_propensities.push_back(0.0);
+    }
+
+    if (adsorption_propensities[channel] == site_propensity)
+        return;
+
+    adsorption_propensities[channel] = site_propensity;
+
+    // there are only a few channels, so the sum is redone rather than
+    // adjusted and can't drift
+    adsorption_site_sum = 0.0;
+    for (double propensity : adsorption_propensities)
+        adsorption_site_sum += propensity;
+} // set_adsorption()
+
+/* ---------------------------------------------------------------------- */
+
+void LatticePropensities::select_adsorption(double value, int &reaction_id,
+                                            int &site_index) const
+{
+    double partial = 0.0;
+    double channel_total = 0.0;
+    double site_propensity = 0.0;
+
+    // the last non zero channel takes whatever rounding leaves over
+    for (unsigned long int channel = 0; channel < adsorption_reactions.size(); channel++)
+    {
+        if (!(adsorption_propensities[channel] > 0.0))
+            continue;
+
+        reaction_id = adsorption_reactions[channel];
+        site_propensity = adsorption_propensities[channel];
+        channel_total = site_propensity * adsorbable_sites;
+        partial += channel_total;
+        if (value <= partial)
+            break;
+    }
+
+    // where value lands within the channel is uniform, so it also picks
+    // the site
+    double within = value - (partial - channel_total);
+    site_index = std::clamp(static_cast<int>(within / site_propensity), 0, adsorbable_sites - 1);
+} // select_adsorption()
+
+/* ---------------------------------------------------------------------- */
+
+LatticeSolver::LatticeSolver(SamplerSeed seed,
                              std::vector<double> &&initial_propensities) : propensity_sum(0.0),
                                                                            number_of_active_indices(0),
                                                                            // if this move isn't here, the semantics is that initial
@@ -19,9 +254,12 @@ LatticeSolver::LatticeSolver(unsigned long int seed,
                                                                            propensities(std::move(initial_propensities)),
                                                                            sampler(Sampler(seed))
 {
+    homogeneous_tree.resize(propensities.size());
+
     for (unsigned long i = 0; i < propensities.size(); i++)
     {
         propensity_sum += propensities[i];
+        homogeneous_tree.set(i, propensities[i]);
         if (propensities[i] > 0)
         {
             number_of_active_indices += 1;
@@ -31,15 +269,18 @@ LatticeSolver::LatticeSolver(unsigned long int seed,
 
 /* ---------------------------------------------------------------------- */
 
-LatticeSolver::LatticeSolver(unsigned long int seed,
+LatticeSolver::LatticeSolver(SamplerSeed seed,
                              std::vector<double> &initial_propensities) : propensity_sum(0.0),
                                                                           number_of_active_indices(0),
                                                                           propensities(initial_propensities),
                                                                           sampler(Sampler(seed))
 {
+    homogeneous_tree.resize(propensities.size());
+
     for (unsigned long i = 0; i < propensities.size(); i++)
     {
         propensity_sum += propensities[i];
+        homogeneous_tree.set(i, propensities[i]);
         if (propensities[i] > 0)
         {
             number_of_active_indices += 1;
@@ -64,26 +305,25 @@ void LatticeSolver::update(Update update)
     propensity_sum += update.propensity;
 
     propensities[update.index] = update.propensity;
+    homogeneous_tree.set(update.index, update.propensity);
 } // update()
 
 /* ---------------------------------------------------------------------- */
 
-void LatticeSolver::update(LatticeUpdate lattice_update, std::unordered_map<std::string,
-                                                                            std::vector<std::pair<double, int>>> &props)
+void LatticeSolver::update(LatticeUpdate lattice_update, LatticePropensities &props)
 {
 
     propensity_sum += lattice_update.propensity;
     number_of_active_indices++;
 
-    std::string hash = make_string(lattice_update.site_one, lattice_update.site_two);
-    props[hash].push_back(std::make_pair(lattice_update.propensity, lattice_update.index));
+    props.add(props.slot(lattice_update.site_one, lattice_update.site_two),
+              lattice_update.propensity, lattice_update.index);
 } // update()
 
 /* ---------------------------------------------------------------------- */
 
 void LatticeSolver::update(std::vector<LatticeUpdate> lattice_updates,
-                           std::unordered_map<std::string,
-                                              std::vector<std::pair<double, int>>> &props)
+                           LatticePropensities &props)
 {
     for (LatticeUpdate u : lattice_updates)
     {
@@ -103,136 +343,101 @@ void LatticeSolver::update(std::vector<Update> updates)
 
 /* ---------------------------------------------------------------------- */
 
-std::optional<LatticeEvent> LatticeSolver::event_lattice(std::unordered_map<std::string,
-                                                                            std::vector<std::pair<double, int>>> &props)
+std::optional<LatticeEvent> LatticeSolver::event_lattice(LatticePropensities &props,
+                                                        const EdgeSet &edges)
 {
-    if (!(propensity_sum > 0))
+    // the reaction network keeps propensity_sum up to date as it goes,
+    // but the trees are exact sums of the current propensities, so they
+    // are what the event is drawn from
+    homogeneous_tree.refresh();
+    props.refresh();
+
+    double homogeneous_sum = homogeneous_tree.total();
+    double adsorption_sum = props.adsorption_total();
+    double lattice_sum = props.total();
+    propensity_sum = homogeneous_sum + adsorption_sum + lattice_sum;
+
+#ifdef DEBUG
+    check_propensity_sum(props);
+#endif
+
+    if (number_of_active_indices == 0 && !(adsorption_sum > 0.0))
     {
-        double sum = 0;
-        for (int i = 0; i < int(propensities.size()); i++)
-        {
-            sum += propensities[i];
-        }
-        for (auto it = props.begin(); it != props.end(); it++)
-        {
-            for (int i = 0; i < int(it->second.size()); i++)
-            {
-                sum += it->second[i].first;
-            }
-        }
-        propensity_sum = sum;
-
-        if (!(propensity_sum > 0))
-        {
-            return std::optional<LatticeEvent>();
-        }
+        propensity_sum = 0.0;
+        return std::optional<LatticeEvent>();
     }
-    if (number_of_active_indices == 0)
+    if (!(propensity_sum > 0))
     {
-        propensity_sum = 0.0;
         return std::optional<LatticeEvent>();
     }
 
-    bool isFound = false;
-    unsigned long m;
-    unsigned long int reaction_id;
     std::optional<int> site_one;
     std::optional<int> site_two;
-    std::string hash;
-    double dt;
+    unsigned long int reaction_id;
+    bool flip_sites = false;
+
+    double r1 = sampler.generate();
+    double waiting_time = sampler.exponential();
+    double fraction = propensity_sum * r1;
 
-    while (!isFound)
+    if (homogeneous_sum > 0.0 &&
+        (fraction <= homogeneous_sum || !(adsorption_sum + lattice_sum > 0.0)))
     {
-        reaction_id = 0;
-        site_one = std::optional<int>();
-        site_two = std::optional<int>();
-        dt = 0.;
+        // Gillespie reaction
+        reaction_id = homogeneous_tree.find(fraction);
+    }
+    else if (adsorption_sum > 0.0 &&
+             (fraction - homogeneous_sum <= adsorption_sum || !(lattice_sum > 0.0)))
+    {
+        int adsorption_reaction, site_index;
+        props.select_adsorption(fraction - homogeneous_sum, adsorption_reaction, site_index);
 
-        double r1 = sampler.generate();
-        double r2 = sampler.generate();
-        double fraction = propensity_sum * r1;
-        long double partial = 0.0;
+        reaction_id = adsorption_reaction;
+        site_one = std::optional<int>(edges.adsorbable(site_index));
+        site_two = std::optional<int>(SITE_HOMOGENEOUS);
+    }
+    else
+    {
+        uint32_t slot, entry;
+        props.select(fraction - homogeneous_sum - adsorption_sum, slot, entry);
 
-        // start with Gillespie propensities
-        for (m = 0; m < propensities.size(); m++)
-        {
-            partial += propensities[m];
-            if (partial > fraction)
-            {
-                isFound = true;
-                reaction_id = m;
-                break;
-            }
-        }
+        reaction_id = props.entries(slot)[entry].reaction_id;
 
-        // go through lattice propensities if not found
-        if (!isFound)
-        {
-            auto it = props.begin();
-            while (!isFound && it != props.end())
-            {
-                for (int i = 0; i < int(it->second.size()); i++)
-                {
-
-                    partial += it->second[i].first;
-
-                    if (partial > fraction)
-                    {
-
-                        isFound = true;
-                        hash = it->first;
-                        reaction_id = it->second[i].second;
-
-                        std::size_t pos = hash.find(".");
-                        site_one = std::optional<int>(stoi(hash.substr(0, pos)));
-                        site_two = std::optional<int>(stoi(hash.substr(pos + 1)));
-                        if (site_one < site_two)
-                        {
-                            assert(false);
-                        }
-                        isFound = true;
-                        break;
-                    }
-                }
-                it++;
-            }
-        }
+        uint64_t key = props.key(slot);
+        site_one = std::optional<int>(LatticePropensities::first_site(key));
+        site_two = std::optional<int>(LatticePropensities::second_site(key));
 
-        dt = -std::log(r2) / propensity_sum;
+        if (site_two.value() >= 0)
+            flip_sites = sampler.generate() > 0.5;
+    }
 
-        // check if found, if not propensity sum is incorrect
-        if (!isFound || !(propensity_sum > 0))
-        {
-            double sum = 0;
-            for (int i = 0; i < static_cast<int>(propensities.size()); i++)
-            {
-                sum += propensities[i];
-            }
-            for (auto it = props.begin(); it != props.end(); it++)
-            {
-                for (int i = 0; i < int(it->second.size()); i++)
-                {
-                    sum += it->second[i].first;
-                }
-            }
-            propensity_sum = sum;
+    sampler.next_step();
 
-            if (!(propensity_sum > 0))
-            {
-                return std::optional<LatticeEvent>();
-            }
-        }
-    }
+    double dt = waiting_time / propensity_sum;
 
-    return std::optional<LatticeEvent>(LatticeEvent{.site_one = site_one, .site_two = site_two, .index = reaction_id, .dt = dt});
+    return std::optional<LatticeEvent>(LatticeEvent{.site_one = site_one, .site_two = site_two, .index = reaction_id, .dt = dt, .flip_sites = flip_sites});
 } // event_lattice()
 
 /* ---------------------------------------------------------------------- */
 
-std::string LatticeSolver::make_string(int site_one, int site_two)
+void LatticeSolver::check_propensity_sum(LatticePropensities &props)
 {
-    return (site_one > site_two) ? std::to_string(site_one) + "." +
-                                       std::to_string(site_two)
-                                 : std::to_string(site_two) + "." + std::to_string(site_one);
+    long double sum = props.adsorption_total();
+    for (int i = 0; i < static_cast<int>(propensities.size()); i++)
+    {
+        sum += propensities[i];
+    }
+    for (uint32_t slot = 0; slot < props.number_of_slots(); slot++)
+    {
+        for (uint32_t i = 0; i < props.size(slot); i++)
+        {
+            sum += props.entries(slot)[i].propensity;
+        }
+    }
 
-} // make_string()
+    if (std::abs(sum - propensity_sum) > 1e-9 * std::max(sum, 1e-300L))
+    {
+        std::cerr << "lattice propensity sum is " << (double)propensity_sum
+                  << " but the propensities add up to " << (double)sum << "\n";
+    }
+} // check_propensity_sum()
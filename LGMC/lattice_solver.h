@@ -10,15 +10,21 @@ See the README file in the top-level RNMC directory.
 
 #include "../core/sampler.h"
 #include "../core/RNMC_types.h"
+#include "lattice.h"
 
 #include <vector>
 #include <unordered_map>
 #include <string>
+#include <cstdint>
+#include <algorithm>
 #include <numeric>
 #include <cmath>
 #include <assert.h>
 #include <optional>
 
+const int SITE_SELF_REACTION = -3;
+const int SITE_HOMOGENEOUS = -2;
+
 struct LatticeUpdate
 {
     unsigned long int index;
@@ -33,29 +39,186 @@ struct LatticeEvent
     std::optional<int> site_two;
     unsigned long int index;
     double dt;
+
+    // whether a reaction between two sites puts its first product on
+    // the second site. Drawn with the event so that it comes from the
+    // simulation's own stream.
+    bool flip_sites;
+};
+
+// partial sums of a growable list of non negative values, stored as a
+// binary heap in the same layout as the GMC TreeSolver. Every internal
+// node is recomputed from its children rather than adjusted, so the
+// total never drifts from the values.
+//
+// set and add only write the leaf. The internal nodes above the leaves
+// written since the last refresh are recomputed by refresh, once each
+// and level by level, which is much cheaper than a walk to the root per
+// write when a lattice event rewrites thousands of propensities. total
+// and find need the tree to have been refreshed.
+class PropensityTree
+{
+public:
+    PropensityTree() : offset(0), number_of_leaves(0){};
+
+    // make room for number_of_leaves values, keeping the current ones.
+    // New values are 0.
+    void resize(uint32_t number_of_leaves);
+
+    void set(uint32_t leaf, double value)
+    {
+        tree[offset + leaf] = value;
+        mark(offset + leaf);
+    };
+
+    void add(uint32_t leaf, double value)
+    {
+        tree[offset + leaf] += value;
+        mark(offset + leaf);
+    };
+
+    void refresh();
+
+    double get(uint32_t leaf) const { return tree[offset + leaf]; };
+    double total() const { return tree.empty() ? 0.0 : tree[0]; };
+
+    // the leaf which value falls in. value is reduced to its position
+    // within the leaf. Leaves which are 0 are never returned as long as
+    // the total is positive.
+    uint32_t find(double &value) const;
+
+private:
+    std::vector<double> tree;
+    uint32_t offset; // index where the leaves start
+    uint32_t number_of_leaves;
+
+    // nodes whose ancestors are out of date, all on the same level
+    std::vector<uint32_t> stale;
+    std::vector<uint32_t> next_stale;
+    std::vector<char> is_stale;
+
+    void mark(uint32_t node)
+    {
+        if (!is_stale[node])
+        {
+            is_stale[node] = 1;
+            stale.push_back(node);
+        }
+    };
+};
+
+struct LatticePropensity
+{
+    double propensity;
+    int reaction_id;
+};
+
+// the propensities of the lattice reactions, grouped by the pair of
+// sites they happen on. The second site of a pair can also be
+// SITE_HOMOGENEOUS or SITE_SELF_REACTION. A pair is keyed by both site
+// ids packed into 64 bits, larger id first, and once it has been seen
+// it keeps a slot for the rest of the simulation. The entries of all
+// slots live in one pool. A slot which outgrows its chunk of the pool
+// moves to a chunk twice the size, and its old chunk is reused by the
+// next slot needing one of that size, so once the lattice has been
+// through a few updates nothing is allocated. The sum of each slot is
+// kept in a PropensityTree, so that selecting an entry only scans the
+// one slot it is in.
+//
+// adsorption is the exception. It has the same propensity at every
+// adsorbable edge site, so rather than an entry per site, each
+// adsorption reaction is a channel holding its propensity at one site,
+// and the channel's total is that times the number of adsorbable sites.
+// Firing a channel picks one of those sites uniformly.
+class LatticePropensities
+{
+public:
+    LatticePropensities() : adsorption_site_sum(0.0), adsorbable_sites(0){};
+
+    static uint64_t pair_key(int site_one, int site_two)
+    {
+        int larger = std::max(site_one, site_two);
+        int smaller = std::min(site_one, site_two);
+        return ((uint64_t)(uint32_t)larger << 32) | (uint32_t)smaller;
+    };
+
+    static int first_site(uint64_t key) { return (int32_t)(uint32_t)(key >> 32); };
+    static int second_site(uint64_t key) { return (int32_t)(uint32_t)key; };
+
+    // the slot of a pair, which is created empty the first time. only
+    // LatticeSolver::update creates slots, so a pair has one only once
+    // a reaction has been possible there
+    uint32_t slot(int site_one, int site_two);
+
+    // the slot of a pair, if it has one
+    std::optional<uint32_t> find(int site_one, int site_two) const;
+
+    void add(uint32_t slot, double propensity, int reaction_id);
+    void clear(uint32_t slot);
+    double sum(uint32_t slot) const { return slot_sums.get(slot); };
+    double total() const { return slot_sums.total(); };
+    void refresh() { slot_sums.refresh(); };
+
+    // the slot and entry which value in [0, total) falls in
+    void select(double value, uint32_t &slot, uint32_t &entry) const;
+
+    uint32_t number_of_slots() const { return slots.size(); };
+    uint64_t key(uint32_t slot) const { return slots[slot].key; };
+    uint32_t size(uint32_t slot) const { return slots[slot].size; };
+    const LatticePropensity *entries(uint32_t slot) const
+    {
+        return pool.data() + slots[slot].offset;
+    };
+
+    void set_adsorption(int reaction_id, double site_propensity);
+    void set_adsorbable_sites(int number_of_sites) { adsorbable_sites = number_of_sites; };
+    double adsorption_total() const { return adsorption_site_sum * adsorbable_sites; };
+
+    // the adsorption reaction and the index of the adsorbable site
+    // which value in [0, adsorption_total) falls in
+    void select_adsorption(double value, int &reaction_id, int &site_index) const;
+
+private:
+    struct Slot
+    {
+        uint64_t key;
+        uint32_t offset;
+        uint32_t size;
+        uint32_t capacity;
+    };
+
+    std::unordered_map<uint64_t, uint32_t> slot_of_key;
+    std::vector<Slot> slots;
+    std::vector<LatticePropensity> pool;
+    PropensityTree slot_sums;
+
+    // free chunks of the pool by log2 of their capacity
+    std::vector<std::vector<uint32_t>> free_chunks;
+
+    // one adsorption channel per reaction which has been set
+    std::vector<int> adsorption_reactions;
+    std::vector<double> adsorption_propensities;
+    double adsorption_site_sum;
+    int adsorbable_sites;
 };
 
 class LatticeSolver
 {
 public:
     LatticeSolver() : sampler(Sampler(0)){}; 
-    LatticeSolver(unsigned long int seed, std::vector<double> &&initial_propensities);
-    LatticeSolver(unsigned long int seed, std::vector<double> &initial_propensities);
+    LatticeSolver(SamplerSeed seed, std::vector<double> &&initial_propensities);
+    LatticeSolver(SamplerSeed seed, std::vector<double> &initial_propensities);
 
     void update(Update update);
     void update(std::vector<Update> updates);
 
-    void update(LatticeUpdate lattice_update, std::unordered_map<std::string,
-                std::vector<std::pair<double, int>>> &props);
+    void update(LatticeUpdate lattice_update, LatticePropensities &props);
 
     void update(std::vector<LatticeUpdate> lattice_updates,
-                std::unordered_map<std::string,
-                std::vector<std::pair<double, int>>> &props);
-
-    std::optional<LatticeEvent> event_lattice(std::unordered_map<std::string,
-                                              std::vector<std::pair<double, int>>> &props);
+                LatticePropensities &props);
 
-    std::string make_string(int site_one, int site_two);
+    std::optional<LatticeEvent> event_lattice(LatticePropensities &props,
+                                              const EdgeSet &edges);
 
     long double propensity_sum;
     int number_of_active_indices; // end simulation of no sites with non zero propensity
@@ -64,6 +227,11 @@ public:
 
 private:
     Sampler sampler;
+    PropensityTree homogeneous_tree;
+
+    // compare the tree totals with a sum over every propensity, which
+    // is what event_lattice used to do on each step
+    void check_propensity_sum(LatticePropensities &props);
 };
 
 #endif
\ No newline at end of file
@@ -67,6 +67,15 @@ void LatticeWriteTrajectoriesSql::action(LatticeWriteTrajectoriesSql &t, sqlite3
     sqlite3_bind_int(stmt, 6, t.site_2_mapping);
 }
 
+std::string LatticeWriteTrajectoriesSql::binary_column_names = "reaction_id,site_1_mapping,site_2_mapping";
+
+void LatticeWriteTrajectoriesSql::binary_columns(LatticeWriteTrajectoriesSql &t, int *columns)
+{
+    columns[0] = t.reaction_id;
+    columns[1] = t.site_1_mapping;
+    columns[2] = t.site_2_mapping;
+}
+
 /* ---------------------------- LatticeStateSql -------------------------- */
 
 std::string LatticeReadStateSql::sql_statement =
@@ -69,6 +69,11 @@ public:
     int site_2_mapping;
     static std::string sql_statement;
     static void action(LatticeWriteTrajectoriesSql &r, sqlite3_stmt *stmt);
+
+    // integer columns after step and time in binary trajectory files
+    static constexpr int number_of_binary_columns = 3;
+    static std::string binary_column_names;
+    static void binary_columns(LatticeWriteTrajectoriesSql &r, int *columns);
 };
 
 /* --------- I/O State SQL ---------*/
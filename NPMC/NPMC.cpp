@@ -20,7 +20,14 @@ void print_usage()
               << "--base_seed\n"
               << "--thread_count\n"
               << "--step_cutoff|time_cutoff\n"
-              << "--checkpoint\n";
+              << "--checkpoint\n"
+              << "--history_chunk_size (optional)\n"
+              << "--max_history_mb (optional)\n"
+              << "--journal_mode=delete|truncate|persist|memory|wal|off (optional)\n"
+              << "--synchronous=off|normal|full|extra (optional)\n"
+              << "--output_format=sqlite|binary (optional)\n"
+              << "--model_cache=path (optional)\n"
+              << "--rng=gsl|philox (optional)\n";
 
 } // print_usage()
 
@@ -28,7 +35,7 @@ void print_usage()
 
 int main(int argc, char **argv)
 {
-    if (argc != 8)
+    if (argc < 8 || argc > 15)
     {
         print_usage();
         exit(EXIT_FAILURE);
@@ -43,6 +50,13 @@ int main(int argc, char **argv)
         {"step_cutoff", optional_argument, NULL, 6},
         {"time_cutoff", optional_argument, NULL, 7},
         {"checkpoint", required_argument, NULL, 8},
+        {"history_chunk_size", required_argument, NULL, 9},
+        {"max_history_mb", required_argument, NULL, 10},
+        {"journal_mode", required_argument, NULL, 11},
+        {"synchronous", required_argument, NULL, 12},
+        {"output_format", required_argument, NULL, 13},
+        {"model_cache", required_argument, NULL, 14},
+        {"rng", required_argument, NULL, 15},
         {NULL, 0, NULL, 0}
         // last element of options array needs to be filled with zeros
     };
@@ -56,6 +70,15 @@ int main(int argc, char **argv)
     int base_seed = 0;
     int thread_count = 0;
     bool isCheckpoint = false;
+    std::string model_cache;
+
+    HistoryParameters history_parameters = {
+        .history_chunk_size = default_history_chunk_size,
+        .max_bytes_in_flight = 0,
+        .journal_mode = "",
+        .synchronous = "",
+        .output_format = sqlite_output,
+        .trajectory_directory = ""};
 
     Cutoff cutoff = {
         .bound = {.step = 0},
@@ -104,6 +127,60 @@ int main(int argc, char **argv)
             isCheckpoint = atof(optarg);
             break;
 
+        case 9:
+            history_parameters.history_chunk_size = atol(optarg);
+            break;
+
+        case 10:
+            history_parameters.max_bytes_in_flight = atol(optarg) * 1024 * 1024;
+            break;
+
+        case 11:
+            history_parameters.journal_mode = optarg;
+            if (!is_journal_mode(history_parameters.journal_mode))
+            {
+                std::cerr << "unknown journal mode " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 12:
+            history_parameters.synchronous = optarg;
+            if (!is_synchronous_mode(history_parameters.synchronous))
+            {
+                std::cerr << "unknown synchronous mode " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 13:
+            if (std::string(optarg) == "sqlite")
+                history_parameters.output_format = sqlite_output;
+            else if (std::string(optarg) == "binary")
+                history_parameters.output_format = binary_output;
+            else
+            {
+                std::cerr << "unknown output format " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 14:
+            model_cache = optarg;
+            break;
+
+        case 15:
+            if (!parse_sampler_backend(optarg, sampler_backend))
+            {
+                std::cerr << "unknown rng " << optarg << '\n';
+                print_usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+
         default:
             // if an unexpected argument is passed, exit
             print_usage();
@@ -112,8 +189,22 @@ int main(int argc, char **argv)
         }
     }
 
+    if (history_parameters.history_chunk_size == 0)
+    {
+        std::cerr << "history_chunk_size must be positive\n";
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+
+    // binary trajectories go next to the initial state database, which
+    // still holds the checkpoint tables
+    if (history_parameters.output_format == binary_output)
+        history_parameters.trajectory_directory =
+            std::string(initial_state_database) + ".trajectories";
+
     NanoParticleParameters parameters{
-        .isCheckpoint = isCheckpoint};
+        .isCheckpoint = isCheckpoint,
+        .model_cache = model_cache};
 
     Dispatcher<
         NanoSolver,
@@ -138,6 +229,7 @@ int main(int argc, char **argv)
             base_seed,
             thread_count,
             cutoff,
+            history_parameters,
             parameters);
 
     dispatcher.run_dispatcher();
@@ -8,9 +8,16 @@ See the README file in the top-level RNMC directory.
 #ifndef RNMC_NPMC_TYPES_H
 #define RNMC_NPMC_TYPES_H
 
+#include <string>
+
 struct NanoParticleParameters
 {
     bool isCheckpoint;
+
+    // model cache file to read the species, sites, interactions and
+    // distance matrix from, or to write them to if there is no valid
+    // one. See core/model_cache.h.
+    std::string model_cache = "";
 };
 
 struct Interaction
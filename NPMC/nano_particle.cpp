@@ -88,6 +88,89 @@ NanoParticle::NanoParticle(
         std::abort();
     }
 
+    // the species, sites, interactions and distance matrix only depend
+    // on the nano particle database, so they come from the model cache
+    // when there is a valid one
+    uint64_t fingerprint = database_fingerprint(
+        nano_particle_database.database_file_path, 0);
+
+    std::vector<double> flat_distance_matrix;
+    ModelCacheReader cache_reader;
+    bool from_cache = !parameters.model_cache.empty() &&
+                      cache_reader.open(parameters.model_cache,
+                                        nano_particle_model_cache, fingerprint) &&
+                      cache_reader.read(degrees_of_freedom) &&
+                      cache_reader.read(sites) &&
+                      cache_reader.read(all_interactions) &&
+                      cache_reader.read(flat_distance_matrix) &&
+                      degrees_of_freedom.size() == (unsigned long int)metadata_row.number_of_species &&
+                      sites.size() == (unsigned long int)metadata_row.number_of_sites &&
+                      flat_distance_matrix.size() == sites.size() * sites.size();
+
+    if (from_cache)
+    {
+        std::cerr << time::time_stamp() << "read " << all_interactions.size()
+                  << " interactions from model cache " << parameters.model_cache << '\n';
+
+        distance_matrix.resize(sites.size());
+        for (unsigned int i = 0; i < sites.size(); i++)
+            distance_matrix[i].assign(flat_distance_matrix.begin() + i * sites.size(),
+                                      flat_distance_matrix.begin() + (i + 1) * sites.size());
+    }
+    else
+    {
+        degrees_of_freedom.clear();
+        sites.clear();
+        all_interactions.clear();
+        read_nano_particle(species_reader, site_reader, interactions_reader,
+                           metadata_row);
+
+        // Pre-compute the distance matrix so that it doesn't need to be computed multiple times
+        compute_distance_matrix();
+
+        if (!parameters.model_cache.empty())
+        {
+            flat_distance_matrix.clear();
+            for (std::vector<double> &row : distance_matrix)
+                flat_distance_matrix.insert(flat_distance_matrix.end(), row.begin(), row.end());
+
+            ModelCacheWriter cache_writer(parameters.model_cache,
+                                          nano_particle_model_cache, fingerprint);
+            cache_writer.write(degrees_of_freedom);
+            cache_writer.write(sites);
+            cache_writer.write(all_interactions);
+            cache_writer.write(flat_distance_matrix);
+            if (cache_writer.finish())
+                std::cerr << time::time_stamp() << "wrote model cache "
+                          << parameters.model_cache << '\n';
+            else
+                std::cerr << time::time_stamp() << "could not write model cache "
+                          << parameters.model_cache << '\n';
+        }
+    }
+
+    site_reaction_dependency.resize(metadata_row.number_of_sites);
+    compute_interaction_maps(metadata_row.number_of_species);
+
+    // initialize initial_state
+    initial_state.resize(metadata_row.number_of_sites);
+
+    while (std::optional<NanoInitialStateSql> maybe_initial_state_row =
+               initial_state_reader.next())
+    {
+        NanoInitialStateSql initial_state_row = maybe_initial_state_row.value();
+        initial_state[initial_state_row.site_id] = initial_state_row.degree_of_freedom;
+    }
+} // NanoParticle()
+
+/* ---------------------------------------------------------------------- */
+
+void NanoParticle::read_nano_particle(
+    SqlReader<SpeciesSql> &species_reader,
+    SqlReader<SiteSql> &site_reader,
+    SqlReader<InteractionSql> &interactions_reader,
+    NanoMetadataSql &metadata_row)
+{
     // initializing degrees of freedom
     degrees_of_freedom.resize(metadata_row.number_of_species);
     while (std::optional<SpeciesSql> maybe_species_row =
@@ -101,10 +184,6 @@ NanoParticle::NanoParticle(
 
     // initializing sites
     sites.resize(metadata_row.number_of_sites);
-    site_reaction_dependency.resize(metadata_row.number_of_sites);
-    // for ( unsigned int i = 0; i < site_reaction_dependency.size(); i++) {
-    //     site_reaction_dependency[i].resize(0);
-    // }
 
     while (std::optional<SiteSql> maybe_site_row =
                site_reader.next())
@@ -120,9 +199,7 @@ NanoParticle::NanoParticle(
 
     // initialize interactions
     // interactions.resize(metadata_row.number_of_interactions);
-    int num_species = metadata_row.number_of_species;
     int interaction_counter = 0;
-    int num_states = 0; // Keep track of number of states, so axis 2 and 3 in interaction_map can be resized
     while (std::optional<InteractionSql> maybe_interaction_row =
                interactions_reader.next())
     {
@@ -138,23 +215,33 @@ NanoParticle::NanoParticle(
             .rate = interaction_row.rate};
 
         all_interactions.push_back(interaction);
-        if (interaction_row.number_of_sites == 1)
+
+        // Increment the interaction counter
+        interaction_counter++;
+    }
+} // read_nano_particle()
+
+/* ---------------------------------------------------------------------- */
+
+void NanoParticle::compute_interaction_maps(int num_species)
+{
+    int num_states = 0; // Keep track of number of states, so axis 2 and 3 in interaction_map can be resized
+    for (Interaction &interaction : all_interactions)
+    {
+        if (interaction.number_of_sites == 1)
         {
             one_site_interactions.push_back(interaction);
         }
-        else if (interaction_row.number_of_sites == 2)
+        else if (interaction.number_of_sites == 2)
         {
             two_site_interactions.push_back(interaction);
         }
 
-        if (num_states < interaction_row.left_state_1)
+        if (num_states < interaction.left_state[0])
         {
             // Keep track of the max number of states
-            num_states = interaction_row.left_state_1;
+            num_states = interaction.left_state[0];
         }
-
-        // Increment the interaction counter
-        interaction_counter++;
     }
     // Increment the state counter, since this value will be off by 1
     num_states++;
@@ -192,20 +279,7 @@ NanoParticle::NanoParticle(
         Interaction interaction = two_site_interactions[i];
         two_site_interactions_map[interaction.species_id[0]][interaction.species_id[1]][interaction.left_state[0]][interaction.left_state[1]].push_back(interaction);
     }
-
-    // initialize initial_state
-    initial_state.resize(metadata_row.number_of_sites);
-
-    while (std::optional<NanoInitialStateSql> maybe_initial_state_row =
-               initial_state_reader.next())
-    {
-        NanoInitialStateSql initial_state_row = maybe_initial_state_row.value();
-        initial_state[initial_state_row.site_id] = initial_state_row.degree_of_freedom;
-    }
-
-    // Pre-compute the distance matrix so that it doesn't need to be computed multiple times
-    compute_distance_matrix();
-} // NanoParticle()
+} // compute_interaction_maps()
 
 /* ---------------------------------------------------------------------- */
 
@@ -602,22 +676,13 @@ WriteCutoffSql NanoParticle::cutoff_history_element_to_sql(
 void NanoParticle::checkpoint(SqlReader<NanoReadStateSql> state_reader,
                               SqlReader<ReadCutoffSql> cutoff_reader,
                               SqlReader<NanoReadTrajectoriesSql> trajectory_reader,
-                              std::map<int, std::vector<int>> &temp_seed_state_map,
+                              SeedStateStore<std::vector<int>> &temp_seed_state_map,
                               std::map<int, int> &temp_seed_step_map,
-                              SeedQueue &temp_seed_queue,
                               std::map<int, double> &temp_seed_time_map,
                               NanoParticle &model)
 {
 
     bool read_interrupt_states = false;
-    std::vector<int> default_state = model.initial_state;
-
-    while (std::optional<unsigned long int> maybe_seed =
-               temp_seed_queue.get_seed())
-    {
-        unsigned long int seed = maybe_seed.value();
-        temp_seed_state_map.insert(std::make_pair(seed, default_state));
-    }
 
     while (std::optional<ReadCutoffSql> maybe_cutoff_row = cutoff_reader.next())
     {
@@ -4,6 +4,7 @@
 #include "../core/sql.h"
 #include "../core/sql_types.h"
 #include "../core/queues.h"
+#include "../core/model_cache.h"
 #include "sql_types.h"
 #include "NPMC_types.h"
 
@@ -69,6 +70,18 @@ struct NanoParticle {
         SqlConnection &initial_state_database,
         NanoParticleParameters parameters);
 
+    // the species, sites and interactions, read from the nano particle
+    // database when there is no model cache
+    void read_nano_particle(
+        SqlReader<SpeciesSql> &species_reader,
+        SqlReader<SiteSql> &site_reader,
+        SqlReader<InteractionSql> &interactions_reader,
+        NanoMetadataSql &metadata_row);
+
+    // split all_interactions by number of sites and index them by
+    // species and state
+    void compute_interaction_maps(int num_species);
+
     double site_distance_squared(NanoSite s1, NanoSite s2);
 
     // maps a site index to the indices of its neighbors
@@ -126,9 +139,8 @@ struct NanoParticle {
     void checkpoint(SqlReader<NanoReadStateSql> state_reader, 
         SqlReader<ReadCutoffSql> cutoff_reader, 
         SqlReader<NanoReadTrajectoriesSql> trajectory_reader, 
-        std::map<int, std::vector<int>> &temp_seed_state_map, 
+        SeedStateStore<std::vector<int>> &temp_seed_state_map, 
         std::map<int, int> &temp_seed_step_map, 
-        SeedQueue &temp_seed_queue, 
         std::map<int, double> &temp_seed_time_map, 
         NanoParticle &model);
 
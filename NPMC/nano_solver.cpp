@@ -8,7 +8,7 @@ See the README file in the top-level RNMC directory.
 #include "nano_solver.h"
 
 NanoSolver::NanoSolver(
-    unsigned long int seed,
+    SamplerSeed seed,
     std::vector<NanoReaction> &&current_reactions) : sampler(Sampler(seed)),
                                                      cumulative_propensities(current_reactions.size()),
                                                      number_of_active_indices(0),
@@ -25,7 +25,7 @@ NanoSolver::NanoSolver(
 /* ---------------------------------------------------------------------- */
 
 NanoSolver::NanoSolver(
-    unsigned long int seed,
+    SamplerSeed seed,
     std::vector<NanoReaction> &current_reactions) : sampler(Sampler(seed)),
                                                     cumulative_propensities(current_reactions.size()),
                                                     number_of_active_indices(0),
@@ -71,7 +71,8 @@ std::optional<Event> NanoSolver::event()
     }
 
     double r1 = sampler.generate();
-    double r2 = sampler.generate();
+    double waiting_time = sampler.exponential();
+    sampler.next_step();
     double fraction = propensity_sum * r1;
 
     unsigned long m;
@@ -84,7 +85,7 @@ std::optional<Event> NanoSolver::event()
     }
     // std::cerr << "Propensity sum: " << propensity_sum << "\n";
 
-    double dt = -std::log(r2) / propensity_sum;
+    double dt = waiting_time / propensity_sum;
     if (m < current_reactions.size())
         return std::optional<Event>(Event{.index = m, .dt = dt});
     else
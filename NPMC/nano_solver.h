@@ -36,8 +36,8 @@ private:
 
 public:
     std::vector<NanoReaction> current_reactions;
-    NanoSolver(unsigned long int seed, std::vector<NanoReaction> &current_reactions);
-    NanoSolver(unsigned long int seed, std::vector<NanoReaction> &&current_reactions);
+    NanoSolver(SamplerSeed seed, std::vector<NanoReaction> &current_reactions);
+    NanoSolver(SamplerSeed seed, std::vector<NanoReaction> &&current_reactions);
     void update();
     void update(NanoUpdate update);
     void update(std::vector<NanoUpdate> updates);
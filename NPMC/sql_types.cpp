@@ -125,6 +125,15 @@ void NanoWriteTrajectoriesSql::action(NanoWriteTrajectoriesSql &r, sqlite3_stmt
     sqlite3_bind_int(stmt, 6, r.interaction_id);
 }
 
+std::string NanoWriteTrajectoriesSql::binary_column_names = "site_id_1,site_id_2,interaction_id";
+
+void NanoWriteTrajectoriesSql::binary_columns(NanoWriteTrajectoriesSql &r, int *columns)
+{
+    columns[0] = r.site_id_1;
+    columns[1] = r.site_id_2;
+    columns[2] = r.interaction_id;
+}
+
 /* -------------------------- Read State SQL ---------------------------- */
 
 std::string NanoReadStateSql::sql_statement =
@@ -119,6 +119,11 @@ public:
     int interaction_id;
     static std::string sql_statement;
     static void action(NanoWriteTrajectoriesSql &r, sqlite3_stmt *stmt);
+
+    // integer columns after step and time in binary trajectory files
+    static constexpr int number_of_binary_columns = 3;
+    static std::string binary_column_names;
+    static void binary_columns(NanoWriteTrajectoriesSql &r, int *columns);
 };
 
 /* ----------------------------- I/O state SQL ----------------------- */
@@ -0,0 +1,127 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../GMC/gillespie_reaction_network.h"
+#include "../GMC/linear_solver.h"
+#include "../GMC/tree_solver.h"
+#include "../GMC/wide_tree_solver.h"
+#include "../GMC/sparse_solver.h"
+#include "../GMC/composition_rejection_solver.h"
+#include "../GMC/next_reaction_solver.h"
+#include "../GMC/partial_propensity_solver.h"
+#include "../core/reaction_network_simulation.h"
+#include "../core/partial_propensity_simulation.h"
+
+// measures the throughput of the GMC simulation loop. Every solver runs
+// the same seeds on the same network and only the time spent inside
+// execute_steps is counted, so model loading, solver construction and
+// writing trajectories to the database are excluded.
+//
+// usage: GMC_step_rate [network directory] [number of simulations] [step cutoff]
+//
+// the network directory must contain rn.sqlite and initial_state.sqlite
+// and defaults to the SEI example.
+
+constexpr int benchmark_history_chunk_size = 20000;
+
+/*---------------------------------------------------------------------------*/
+
+template <typename Solver, typename Sim = ReactionNetworkSimulation<Solver>>
+void run_benchmark(const char *solver_name,
+                   GillespieReactionNetwork &reaction_network,
+                   unsigned long int number_of_simulations,
+                   int step_cutoff)
+{
+    HistoryQueue<HistoryPacket<ReactionNetworkTrajectoryHistoryElement>> history_queue;
+
+    unsigned long int total_steps = 0;
+    std::chrono::duration<double> elapsed(0.0);
+
+    for (unsigned long int seed = 1000; seed < 1000 + number_of_simulations; seed++)
+    {
+        Sim simulation(reaction_network,
+                       seed,
+                       0,
+                       0.0,
+                       reaction_network.initial_state,
+                       benchmark_history_chunk_size,
+                       history_queue);
+        simulation.init();
+
+        auto start = std::chrono::steady_clock::now();
+        simulation.execute_steps(step_cutoff);
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        total_steps += simulation.step;
+
+        // drop any full history chunks so memory stays bounded
+        while (history_queue.get_history())
+            ;
+    }
+
+    printf("%-24s %12lu steps %10.3f s %14.0f steps/s\n",
+           solver_name,
+           total_steps,
+           elapsed.count(),
+           total_steps / elapsed.count());
+} // run_benchmark()
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    std::string network_directory = "../examples/GMC/SEI/e-0.0V_dist0.0A_co250_h2o10";
+    unsigned long int number_of_simulations = 200;
+    int step_cutoff = 5000;
+
+    if (argc > 1)
+        network_directory = argv[1];
+    if (argc > 2)
+        number_of_simulations = std::atol(argv[2]);
+    if (argc > 3)
+        step_cutoff = std::atoi(argv[3]);
+
+    SqlConnection reaction_database(network_directory + "/rn.sqlite",
+                                    SQLITE_OPEN_READONLY);
+    SqlConnection initial_state_database(network_directory + "/initial_state.sqlite",
+                                         SQLITE_OPEN_READONLY);
+
+    ReactionNetworkParameters parameters{.isCheckpoint = false};
+    GillespieReactionNetwork reaction_network(reaction_database,
+                                              initial_state_database,
+                                              parameters);
+
+    printf("%s: %lu reactions, %lu simulations, step cutoff %d\n",
+           network_directory.c_str(),
+           reaction_network.reactions.size(),
+           number_of_simulations,
+           step_cutoff);
+
+    run_benchmark<LinearSolver>("linear", reaction_network,
+                                number_of_simulations, step_cutoff);
+    run_benchmark<TreeSolver>("tree", reaction_network,
+                              number_of_simulations, step_cutoff);
+    run_benchmark<WideTreeSolver>("wide_tree", reaction_network,
+                                  number_of_simulations, step_cutoff);
+    run_benchmark<SparseSolver>("sparse", reaction_network,
+                                number_of_simulations, step_cutoff);
+    run_benchmark<CompositionRejectionSolver>("composition_rejection", reaction_network,
+                                              number_of_simulations, step_cutoff);
+    run_benchmark<NextReactionSolver>("next_reaction", reaction_network,
+                                      number_of_simulations, step_cutoff);
+
+    reaction_network.compute_reactant_groups();
+    run_benchmark<PartialPropensitySolver, PartialPropensitySimulation>(
+        "partial_propensity", reaction_network, number_of_simulations, step_cutoff);
+
+    return 0;
+} // main()
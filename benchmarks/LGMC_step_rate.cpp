@@ -0,0 +1,121 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "../LGMC/lattice_reaction_network.h"
+#include "../LGMC/lattice_solver.h"
+#include "../core/lattice_simulation.h"
+
+// measures the throughput of the LGMC simulation loop, the same way as
+// GMC_step_rate. Every seed starts from the initial state of the
+// network and only the time spent inside execute_steps is counted.
+//
+// usage: LGMC_step_rate [network directory] [number of simulations] [step cutoff]
+//
+// the network directory must contain rn.sqlite, initial_state.sqlite and
+// LGMC_params.txt and defaults to the SEI example.
+
+constexpr int benchmark_history_chunk_size = 20000;
+
+/*---------------------------------------------------------------------------*/
+
+// the parameter file format read by LGMC
+LatticeParameters read_parameters(std::string path)
+{
+    std::ifstream fin(path);
+    if (!fin.is_open())
+    {
+        printf("Failed to open file: %s\n", path.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    LatticeParameters parameters{};
+    char add_site;
+    char ct_style;
+
+    fin >> parameters.latconst >> parameters.boxxhi >> parameters.boxyhi >>
+        parameters.boxzhi >> parameters.temperature >> parameters.g_e >>
+        add_site >> ct_style;
+
+    parameters.is_add_sites = add_site == 'T';
+    parameters.charge_transfer_style = ct_style == 'B' ? ChargeTransferStyle::BUTLER_VOLMER
+                                                       : ChargeTransferStyle::MARCUS;
+    parameters.isCheckpoint = false;
+
+    return parameters;
+} // read_parameters()
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    std::string network_directory = "../examples/LGMC/SEI";
+    unsigned long int number_of_simulations = 20;
+    int step_cutoff = 20000;
+
+    if (argc > 1)
+        network_directory = argv[1];
+    if (argc > 2)
+        number_of_simulations = std::atol(argv[2]);
+    if (argc > 3)
+        step_cutoff = std::atoi(argv[3]);
+
+    SqlConnection reaction_database(network_directory + "/rn.sqlite",
+                                    SQLITE_OPEN_READONLY);
+    SqlConnection initial_state_database(network_directory + "/initial_state.sqlite",
+                                         SQLITE_OPEN_READONLY);
+
+    LatticeReactionNetwork lattice_network(
+        reaction_database, initial_state_database,
+        read_parameters(network_directory + "/LGMC_params.txt"));
+
+    printf("%s: %lu reactions, %lu simulations, step cutoff %d\n",
+           network_directory.c_str(),
+           lattice_network.reactions.size(),
+           number_of_simulations,
+           step_cutoff);
+
+    HistoryQueue<HistoryPacket<LatticeTrajectoryHistoryElement>> history_queue;
+
+    unsigned long int total_steps = 0;
+    std::chrono::duration<double> elapsed(0.0);
+
+    for (unsigned long int seed = 1000; seed < 1000 + number_of_simulations; seed++)
+    {
+        LatticeSimulation simulation(lattice_network,
+                                     seed,
+                                     0,
+                                     0.0,
+                                     LatticeState(lattice_network.initial_state),
+                                     benchmark_history_chunk_size,
+                                     history_queue);
+        simulation.init();
+
+        auto start = std::chrono::steady_clock::now();
+        simulation.execute_steps(step_cutoff);
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        total_steps += simulation.step;
+
+        // drop any full history chunks so memory stays bounded
+        while (history_queue.get_history())
+            ;
+    }
+
+    printf("%-24s %12lu steps %10.3f s %14.0f steps/s\n",
+           "lattice",
+           total_steps,
+           elapsed.count(),
+           total_steps / elapsed.count());
+
+    return 0;
+} // main()
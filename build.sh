@@ -20,4 +20,10 @@ echo "building LGMC"
 cd LGMC
 make clean
 make LGMC
-cd ..
\ No newline at end of file
+cd ..
+
+echo "building tools"
+cd tools
+make clean
+make all
+cd ..
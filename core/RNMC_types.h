@@ -9,6 +9,7 @@ See the README file in the top-level RNMC directory.
 #define RNMC_RNMC_TYPES_H
 
 #include <vector>
+#include <string>
 
 enum TypeOfCutoff
 {
@@ -26,6 +27,24 @@ struct Cutoff
     TypeOfCutoff type_of_cutoff;
 };
 
+enum TrajectoryOutputFormat
+{
+    sqlite_output, // trajectories table of the initial state database
+    binary_output  // one binary file per seed, see core/trajectory_file.h
+};
+
+// controls how trajectory histories flow from the simulator threads to
+// the dispatcher
+struct HistoryParameters
+{
+    unsigned long int history_chunk_size; // number of steps in each trajectory packet
+    unsigned long int max_bytes_in_flight; // trajectory memory waiting to be written, 0 for no limit
+    std::string journal_mode; // PRAGMA journal_mode for the initial state database, empty for the sqlite default
+    std::string synchronous;  // PRAGMA synchronous for the initial state database, empty for the sqlite default
+    TrajectoryOutputFormat output_format;
+    std::string trajectory_directory; // where binary trajectory files are written
+};
+
 template <typename T>
 struct HistoryPacket
 {
@@ -33,6 +52,13 @@ struct HistoryPacket
     std::vector<T> history;
 };
 
+// memory held by a packet while it waits in a HistoryQueue
+template <typename T>
+unsigned long int history_packet_bytes(HistoryPacket<T> &history_packet)
+{
+    return history_packet.history.capacity() * sizeof(T);
+}
+
 struct Update
 {
     unsigned long int index;
@@ -37,6 +37,7 @@ Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
     unsigned long int base_seed,
     int number_of_threads,
     Cutoff cutoff,
+    HistoryParameters history_parameters,
     Parameters parameters) : model_database(model_database_file,
                                             SQLITE_OPEN_READWRITE),
                              initial_state_database(
@@ -51,18 +52,145 @@ Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
                              state_writer(state_stmt),
                              cutoff_stmt(initial_state_database),
                              cutoff_writer(cutoff_stmt),
-                             history_queue(),
-                             state_history_queue(),
-                             cutoff_history_queue(),
+                             history_queue(history_queue_capacity(number_of_threads)),
+                             state_history_queue(history_queue_capacity(number_of_threads)),
+                             cutoff_history_queue(history_queue_capacity(number_of_threads)),
                              seed_queue(number_of_simulations, base_seed),
                              threads(), // don't want to start threads in the constructor.
-                             running(number_of_threads, false),
+                             running(number_of_threads),
                              cutoff(cutoff),
+                             history_parameters(history_parameters),
                              number_of_simulations(number_of_simulations),
                              number_of_threads(number_of_threads),
-                             seed_state_map(),
+                             seed_state_store(),
                              seed_step_map(),
-                             seed_time_map()
+                             seed_time_map(),
+                             writer_busy(false),
+                             writer_stop(false)
+{
+    apply_history_parameters();
+    read_checkpoint();
+} // Dispatcher()
+
+/* ------------------------------------------------------------------- */
+
+template <
+    typename Solver,
+    typename Model,
+    typename Parameters,
+    typename WriteTrajectoriesSql,
+    typename ReadTrajectoriesSql,
+    typename WriteStateSql,
+    typename ReadStateSql,
+    typename WriteCutoffSql,
+    typename ReadCutoffSql,
+    typename StateHistory,
+    typename TrajHistory,
+    typename CutoffHistory,
+    typename Sim,
+    typename State>
+
+Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
+           ReadTrajectoriesSql, WriteStateSql, ReadStateSql,
+           WriteCutoffSql, ReadCutoffSql, StateHistory, TrajHistory,
+           CutoffHistory, Sim, State>::Dispatcher(
+
+    SqlConnection &&model_database,
+    SqlConnection &&initial_state_database,
+    Model &&model,
+    unsigned long int number_of_simulations,
+    unsigned long int base_seed,
+    int number_of_threads,
+    Cutoff cutoff,
+    HistoryParameters history_parameters) : model_database(std::move(model_database)),
+                     initial_state_database(std::move(initial_state_database)),
+                     model(std::move(model)),
+                     trajectories_stmt(this->initial_state_database),
+                     trajectories_writer(trajectories_stmt),
+                     state_stmt(this->initial_state_database),
+                     state_writer(state_stmt),
+                     cutoff_stmt(this->initial_state_database),
+                     cutoff_writer(cutoff_stmt),
+                     history_queue(history_queue_capacity(number_of_threads)),
+                     state_history_queue(history_queue_capacity(number_of_threads)),
+                     cutoff_history_queue(history_queue_capacity(number_of_threads)),
+                     seed_queue(number_of_simulations, base_seed),
+                     threads(), // don't want to start threads in the constructor.
+                     running(number_of_threads),
+                     cutoff(cutoff),
+                     history_parameters(history_parameters),
+                     number_of_simulations(number_of_simulations),
+                     number_of_threads(number_of_threads),
+                     seed_state_store(),
+                     seed_step_map(),
+                     seed_time_map(),
+                     writer_busy(false),
+                     writer_stop(false)
+{
+    apply_history_parameters();
+    read_checkpoint();
+} // Dispatcher()
+
+/* ------------------------------------------------------------------- */
+
+template <
+    typename Solver,
+    typename Model,
+    typename Parameters,
+    typename WriteTrajectoriesSql,
+    typename ReadTrajectoriesSql,
+    typename WriteStateSql,
+    typename ReadStateSql,
+    typename WriteCutoffSql,
+    typename ReadCutoffSql,
+    typename StateHistory,
+    typename TrajHistory,
+    typename CutoffHistory,
+    typename Sim,
+    typename State>
+
+void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
+                ReadTrajectoriesSql, WriteStateSql, ReadStateSql,
+                WriteCutoffSql, ReadCutoffSql, StateHistory, TrajHistory,
+                CutoffHistory, Sim, State>::apply_history_parameters()
+{
+    history_queue.max_bytes_in_flight = history_parameters.max_bytes_in_flight;
+
+    if (!history_parameters.journal_mode.empty())
+        initial_state_database.exec(
+            "PRAGMA journal_mode=" + history_parameters.journal_mode + ";");
+
+    if (!history_parameters.synchronous.empty())
+        initial_state_database.exec(
+            "PRAGMA synchronous=" + history_parameters.synchronous + ";");
+
+    if (history_parameters.output_format == binary_output)
+        trajectory_file_writer = TrajectoryFileWriter(
+            history_parameters.trajectory_directory);
+} // apply_history_parameters()
+
+/* ------------------------------------------------------------------- */
+
+template <
+    typename Solver,
+    typename Model,
+    typename Parameters,
+    typename WriteTrajectoriesSql,
+    typename ReadTrajectoriesSql,
+    typename WriteStateSql,
+    typename ReadStateSql,
+    typename WriteCutoffSql,
+    typename ReadCutoffSql,
+    typename StateHistory,
+    typename TrajHistory,
+    typename CutoffHistory,
+    typename Sim,
+    typename State>
+
+void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
+                ReadTrajectoriesSql, WriteStateSql, ReadStateSql,
+                WriteCutoffSql, ReadCutoffSql, StateHistory, TrajHistory,
+                CutoffHistory, Sim, State>::read_checkpoint()
 {
 
     SqlStatement<ReadStateSql> state_statement(initial_state_database);
@@ -74,21 +202,14 @@ Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
     SqlStatement<ReadTrajectoriesSql> trajectory_statement(initial_state_database);
     SqlReader<ReadTrajectoriesSql> trajectory_reader(trajectory_statement);
 
-    SeedQueue temp_seed_queue = SeedQueue(number_of_simulations,
-                                          base_seed);
-
-    std::map<int, State> temp_seed_state_map;
-    std::map<int, int> temp_seed_step_map;
-    std::map<int, double> temp_seed_time_map;
+    // seeds the checkpoint doesn't mention start from the initial state
+    // of the model. The model may replace this while reading.
+    seed_state_store.set_default([this]()
+                                 { return State(model.initial_state); });
 
     model.checkpoint(state_reader, cutoff_reader, trajectory_reader,
-                     temp_seed_state_map, temp_seed_step_map,
-                     temp_seed_queue, temp_seed_time_map, model);
-
-    seed_state_map = std::move(temp_seed_state_map);
-    seed_step_map = temp_seed_step_map;
-    seed_time_map = temp_seed_time_map;
-} // Dispatcher()
+                     seed_state_store, seed_step_map, seed_time_map, model);
+} // read_checkpoint()
 
 /* ------------------------------------------------------------------- */
 
@@ -191,11 +312,15 @@ void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
                 cutoff_history_queue,
                 seed_queue,
                 cutoff,
+                history_parameters.history_chunk_size,
                 running.begin() + i,
-                seed_state_map,
+                seed_state_store,
                 seed_step_map,
                 seed_time_map));
     }
+    writer_thread = std::thread([this]
+                                { run_writer(); });
+
     // Unset the sigmask so that the parent thread
     // resumes catching errors as normal
     pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
@@ -206,67 +331,86 @@ void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
     sigaction(SIGINT, &action, NULL);
     sigaction(SIGTERM, &action, NULL);
 
+    HistoryBatch batch;
     bool finished = false;
     while (!finished)
     {
-
-        if (history_queue.empty())
+        // take the ticket before looking for work. Any packet inserted
+        // or simulator finishing after this point will wake us up.
+        unsigned long int ticket = history_queue.consumer_ticket();
+
+        // a simulator queues all of its packets before clearing its
+        // running flag, so if every flag is already clear, draining the
+        // queues below collects everything that is left.
+        bool all_simulations_finished = true;
+        for (std::atomic<bool> &flag : running)
         {
-
-            bool all_simulations_finished = true;
-
-            for (bool flag : running)
+            if (flag.load())
             {
-                if (flag)
-                {
-                    all_simulations_finished = false;
-                    break;
-                }
+                all_simulations_finished = false;
+                break;
             }
-
-            if (all_simulations_finished)
-                finished = true;
         }
 
-        std::optional<HistoryPacket<TrajHistory>>
-            maybe_history_packet = history_queue.get_history();
-
-        if (maybe_history_packet)
+        // packets keep their bytes counted against max_bytes_in_flight
+        // until the writer has written them, so producers stay blocked
+        // while the batches are full and the drain can't run away.
+        unsigned long int bytes = 0;
+        while (std::optional<HistoryPacket<TrajHistory>>
+                   maybe_history_packet = history_queue.take_history(bytes))
         {
-            HistoryPacket<TrajHistory> history_packet = std::move(maybe_history_packet.value());
-            record_simulation_history(std::move(history_packet));
+            batch.trajectory_packets.push_back(std::move(maybe_history_packet.value()));
+            batch.trajectory_bytes += bytes;
         }
+
         if (model.isCheckpoint)
         {
-            std::optional<HistoryPacket<StateHistory>>
-                maybe_state_history_packet = state_history_queue.get_history();
-
-            if (maybe_state_history_packet)
+            while (std::optional<HistoryPacket<StateHistory>>
+                       maybe_state_history_packet = state_history_queue.take_history(bytes))
             {
-                HistoryPacket<StateHistory> state_history_packet = std::move(maybe_state_history_packet.value());
-                record_state(std::move(state_history_packet));
+                batch.state_packets.push_back(std::move(maybe_state_history_packet.value()));
+                batch.state_bytes += bytes;
             }
 
-            std::optional<HistoryPacket<CutoffHistory>>
-                maybe_cutoff_history_packet = cutoff_history_queue.get_history();
-
-            if (maybe_cutoff_history_packet)
+            while (std::optional<HistoryPacket<CutoffHistory>>
+                       maybe_cutoff_history_packet = cutoff_history_queue.take_history(bytes))
             {
-                HistoryPacket<CutoffHistory> cutoff_history_packet = std::move(maybe_cutoff_history_packet.value());
-                record_cutoff(std::move(cutoff_history_packet));
+                batch.cutoff_packets.push_back(std::move(maybe_cutoff_history_packet.value()));
+                batch.cutoff_bytes += bytes;
             }
         }
+
+        bool collected_history = !batch.empty();
+        if (collected_history)
+            hand_off_batch(batch);
+
+        if (all_simulations_finished)
+            finished = true;
+        else if (!collected_history)
+        {
+            // sleep until a simulator inserts a trajectory packet or
+            // finishes. State and cutoff packets are always followed by
+            // a trajectory packet from the same simulator.
+            history_queue.wait_for_history(ticket);
+        }
     }
 
+    stop_writer();
+
     for (int i = 0; i < number_of_threads; i++)
         threads[i].join();
 
-    initial_state_database.exec(
-        "DELETE FROM trajectories WHERE rowid NOT IN"
-        "(SELECT MIN(rowid) FROM trajectories GROUP BY seed, step);");
+    // binary trajectory files are append only. Readers keep the first
+    // record of any (seed, step) pair instead.
+    if (history_parameters.output_format == sqlite_output)
+    {
+        initial_state_database.exec(
+            "DELETE FROM trajectories WHERE rowid NOT IN"
+            "(SELECT MIN(rowid) FROM trajectories GROUP BY seed, step);");
 
-    std::cerr << time::time_stamp()
-              << "removing duplicate trajectories...\n";
+        std::cerr << time::time_stamp()
+                  << "removing duplicate trajectories...\n";
+    }
 
 } // run_dispatcher()
 
@@ -291,11 +435,180 @@ template <
 void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
                 ReadTrajectoriesSql, WriteStateSql, ReadStateSql,
                 WriteCutoffSql, ReadCutoffSql, StateHistory, TrajHistory,
-                CutoffHistory, Sim, State>::record_simulation_history(HistoryPacket<TrajHistory> history_packet)
+                CutoffHistory, Sim, State>::run_writer()
 {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+
+    while (true)
+    {
+        writer_condition.wait(lock, [&]
+                              { return writer_busy || writer_stop; });
+
+        if (!writer_busy)
+            break;
+
+        lock.unlock();
+        write_batch(writer_batch);
+        history_queue.release_bytes(writer_batch.trajectory_bytes);
+        state_history_queue.release_bytes(writer_batch.state_bytes);
+        cutoff_history_queue.release_bytes(writer_batch.cutoff_bytes);
+        writer_batch.clear();
+        lock.lock();
+
+        writer_busy = false;
+        writer_condition.notify_all();
+    }
+} // run_writer()
 
+/* ------------------------------------------------------------------- */
+
+template <
+    typename Solver,
+    typename Model,
+    typename Parameters,
+    typename WriteTrajectoriesSql,
+    typename ReadTrajectoriesSql,
+    typename WriteStateSql,
+    typename ReadStateSql,
+    typename WriteCutoffSql,
+    typename ReadCutoffSql,
+    typename StateHistory,
+    typename TrajHistory,
+    typename CutoffHistory,
+    typename Sim,
+    typename State>
+
+void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
+                ReadTrajectoriesSql, WriteStateSql, ReadStateSql,
+                WriteCutoffSql, ReadCutoffSql, StateHistory, TrajHistory,
+                CutoffHistory, Sim, State>::hand_off_batch(HistoryBatch &batch)
+{
+    // wait for the writer to finish the previous batch. Meanwhile the
+    // simulators keep filling the history queues. Packets in both
+    // batches still count against max_bytes_in_flight, so the queue and
+    // the two batches together never hold more than the cap.
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    writer_condition.wait(lock, [&]
+                          { return !writer_busy; });
+
+    std::swap(writer_batch, batch);
+    writer_busy = true;
+    writer_condition.notify_all();
+} // hand_off_batch()
+
+/* ------------------------------------------------------------------- */
+
+template <
+    typename Solver,
+    typename Model,
+    typename Parameters,
+    typename WriteTrajectoriesSql,
+    typename ReadTrajectoriesSql,
+    typename WriteStateSql,
+    typename ReadStateSql,
+    typename WriteCutoffSql,
+    typename ReadCutoffSql,
+    typename StateHistory,
+    typename TrajHistory,
+    typename CutoffHistory,
+    typename Sim,
+    typename State>
+
+void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
+                ReadTrajectoriesSql, WriteStateSql, ReadStateSql,
+                WriteCutoffSql, ReadCutoffSql, StateHistory, TrajHistory,
+                CutoffHistory, Sim, State>::stop_writer()
+{
+    {
+        std::unique_lock<std::mutex> lock(writer_mutex);
+        writer_condition.wait(lock, [&]
+                              { return !writer_busy; });
+        writer_stop = true;
+        writer_condition.notify_all();
+    }
+
+    writer_thread.join();
+} // stop_writer()
+
+/* ------------------------------------------------------------------- */
+
+template <
+    typename Solver,
+    typename Model,
+    typename Parameters,
+    typename WriteTrajectoriesSql,
+    typename ReadTrajectoriesSql,
+    typename WriteStateSql,
+    typename ReadStateSql,
+    typename WriteCutoffSql,
+    typename ReadCutoffSql,
+    typename StateHistory,
+    typename TrajHistory,
+    typename CutoffHistory,
+    typename Sim,
+    typename State>
+
+void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
+                ReadTrajectoriesSql, WriteStateSql, ReadStateSql,
+                WriteCutoffSql, ReadCutoffSql, StateHistory, TrajHistory,
+                CutoffHistory, Sim, State>::write_batch(HistoryBatch &batch)
+{
+    // one transaction for the whole batch. Committing is what forces
+    // sqlite to sync, so coalescing packets is much cheaper than a
+    // transaction per packet once there are many simulator threads.
     initial_state_database.exec("BEGIN;");
 
+    for (HistoryPacket<TrajHistory> &history_packet : batch.trajectory_packets)
+        record_simulation_history(std::move(history_packet));
+
+    for (HistoryPacket<StateHistory> &state_history_packet : batch.state_packets)
+        record_state(std::move(state_history_packet));
+
+    for (HistoryPacket<CutoffHistory> &cutoff_history_packet : batch.cutoff_packets)
+        record_cutoff(std::move(cutoff_history_packet));
+
+    initial_state_database.exec("COMMIT;");
+} // write_batch()
+
+/* ------------------------------------------------------------------- */
+
+template <
+    typename Solver,
+    typename Model,
+    typename Parameters,
+    typename WriteTrajectoriesSql,
+    typename ReadTrajectoriesSql,
+    typename WriteStateSql,
+    typename ReadStateSql,
+    typename WriteCutoffSql,
+    typename ReadCutoffSql,
+    typename StateHistory,
+    typename TrajHistory,
+    typename CutoffHistory,
+    typename Sim,
+    typename State>
+
+void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
+                ReadTrajectoriesSql, WriteStateSql, ReadStateSql,
+                WriteCutoffSql, ReadCutoffSql, StateHistory, TrajHistory,
+                CutoffHistory, Sim, State>::record_simulation_history(HistoryPacket<TrajHistory> history_packet)
+{
+
+    if (history_parameters.output_format == binary_output)
+    {
+        trajectory_rows.clear();
+        for (unsigned long int i = 0; i < history_packet.history.size(); i++)
+        {
+            trajectory_rows.push_back(
+                model.history_element_to_sql(
+                    (int)history_packet.seed,
+                    history_packet.history[i]));
+        }
+
+        trajectory_file_writer.write(history_packet.seed, trajectory_rows);
+        return;
+    }
+
     for (unsigned long int i = 0; i < history_packet.history.size(); i++)
     {
         trajectories_writer.insert(
@@ -304,8 +617,6 @@ void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
                 history_packet.history[i]));
     }
 
-    initial_state_database.exec("COMMIT;");
-
     // std::cerr << time::time_stamp()
     //           << "wrote "
     //           << history_packet.history.size()
@@ -344,8 +655,6 @@ void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
 
     initial_state_database.exec(delete_statement);
 
-    initial_state_database.exec("BEGIN;");
-
     for (unsigned long int i = 0; i < state_history_packet.history.size(); i++)
     {
         state_writer.insert(
@@ -353,7 +662,6 @@ void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
                 (int)state_history_packet.seed,
                 state_history_packet.history[i]));
     }
-    initial_state_database.exec("COMMIT;");
 
     // std::cerr << time::time_stamp()
     //           << "wrote "
@@ -393,8 +701,6 @@ void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
 
     initial_state_database.exec(delete_statement);
 
-    initial_state_database.exec("BEGIN;");
-
     for (unsigned long int i = 0; i < cutoff_history_packet.history.size(); i++)
     {
         cutoff_writer.insert(
@@ -402,7 +708,6 @@ void Dispatcher<Solver, Model, Parameters, WriteTrajectoriesSql,
                 (int)cutoff_history_packet.seed,
                 cutoff_history_packet.history[i]));
     }
-    initial_state_database.exec("COMMIT;");
 
     // std::cerr << time::time_stamp()
     //           << "wrote cutoff for trajectory "
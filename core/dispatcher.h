@@ -9,7 +9,9 @@ See the README file in the top-level RNMC directory.
 #define RNMC_DISPATCHER_H
 
 #include <mutex>
+#include <atomic>
 #include <thread>
+#include <condition_variable>
 #include <csignal>
 #include <iostream>
 #include <string>
@@ -18,6 +20,7 @@ See the README file in the top-level RNMC directory.
 
 #include "sql.h"
 #include "queues.h"
+#include "trajectory_file.h"
 #include "RNMC_types.h"
 #include "simulation.h"
 #include "simulator_payload.h"
@@ -48,6 +51,10 @@ public:
     SqlStatement<WriteTrajectoriesSql> trajectories_stmt;
     SqlWriter<WriteTrajectoriesSql> trajectories_writer;
 
+    // used instead of trajectories_writer with --output_format=binary
+    TrajectoryFileWriter trajectory_file_writer;
+    std::vector<WriteTrajectoriesSql> trajectory_rows;
+
     SqlStatement<WriteStateSql> state_stmt;
     SqlWriter<WriteStateSql> state_writer;
 
@@ -60,16 +67,59 @@ public:
 
     SeedQueue seed_queue;
     std::vector<std::thread> threads;
-    std::vector<bool> running;
+    std::vector<std::atomic<bool>> running;
     Cutoff cutoff;
+    HistoryParameters history_parameters;
     TypeOfCutoff type_of_cutoff;
     int number_of_simulations;
     int number_of_threads;
     struct sigaction action;
-    std::map<int, State> seed_state_map;
+    SeedStateStore<State> seed_state_store;
     std::map<int, int> seed_step_map;
     std::map<int, double> seed_time_map;
 
+    // packets drained from the history queues. A batch is written to
+    // the initial state database in a single transaction.
+    struct HistoryBatch
+    {
+        std::vector<HistoryPacket<TrajHistory>> trajectory_packets;
+        std::vector<HistoryPacket<StateHistory>> state_packets;
+        std::vector<HistoryPacket<CutoffHistory>> cutoff_packets;
+
+        // bytes taken out of each history queue, released once the
+        // batch has been written
+        unsigned long int trajectory_bytes = 0;
+        unsigned long int state_bytes = 0;
+        unsigned long int cutoff_bytes = 0;
+
+        bool empty()
+        {
+            return trajectory_packets.empty() &&
+                   state_packets.empty() &&
+                   cutoff_packets.empty();
+        };
+
+        void clear()
+        {
+            trajectory_packets.clear();
+            state_packets.clear();
+            cutoff_packets.clear();
+            trajectory_bytes = 0;
+            state_bytes = 0;
+            cutoff_bytes = 0;
+        };
+    };
+
+    // the writer thread owns writer_batch while writer_busy is set. The
+    // dispatcher thread fills the next batch while the writer commits,
+    // so draining the queues never waits on an fsync.
+    std::thread writer_thread;
+    std::mutex writer_mutex;
+    std::condition_variable writer_condition;
+    HistoryBatch writer_batch;
+    bool writer_busy;
+    bool writer_stop;
+
     Dispatcher(
         std::string model_database_file,
         std::string initial_state_database_file,
@@ -77,10 +127,30 @@ public:
         unsigned long int base_seed,
         int number_of_threads,
         Cutoff cutoff,
+        HistoryParameters history_parameters,
         Parameters parameters);
 
+    // construct a dispatcher around a model which has already been
+    // loaded. This lets the caller inspect the model before deciding
+    // which solver to instantiate the dispatcher with.
+    Dispatcher(
+        SqlConnection &&model_database,
+        SqlConnection &&initial_state_database,
+        Model &&model,
+        unsigned long int number_of_simulations,
+        unsigned long int base_seed,
+        int number_of_threads,
+        Cutoff cutoff,
+        HistoryParameters history_parameters);
+
+    void apply_history_parameters();
+    void read_checkpoint();
     void static signalHandler(int signum);
     void run_dispatcher();
+    void run_writer();
+    void hand_off_batch(HistoryBatch &batch);
+    void stop_writer();
+    void write_batch(HistoryBatch &batch);
     void record_simulation_history(HistoryPacket<TrajHistory> traj_history_packet);
     void record_state(HistoryPacket<StateHistory> state_history_packet);
     void record_cutoff(HistoryPacket<CutoffHistory> cutoff_history_packet);
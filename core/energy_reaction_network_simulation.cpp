@@ -10,12 +10,24 @@ See the README file in the top-level RNMC directory.
 template <typename Solver>
 void EnergyReactionNetworkSimulation<Solver>::init()
 {
+    // seeds starting from the initial state share the propensities
+    // computed when the network was loaded
+    EnergyState &initial_state = energy_reaction_network.initial_state;
+    if (state.homogeneous == initial_state.homogeneous &&
+        state.energy_budget == initial_state.energy_budget &&
+        energy_reaction_network.initial_state_propensities.size() ==
+            energy_reaction_network.reactions.size())
+    {
+        solver = Solver(sampler_seed(this->seed, this->step),
+                        std::ref(energy_reaction_network.initial_state_propensities));
+        return;
+    }
+
     std::vector<double> initial_propensities_temp;
 
-    energy_reaction_network.compute_initial_propensities(state.homogeneous, initial_propensities_temp);
-    solver = Solver(this->seed, std::ref(initial_propensities_temp));
-    this->update_function = [&](Update update)
-    { solver.update(update); };
+    energy_reaction_network.compute_initial_propensities(
+        state.homogeneous, state.energy_budget, initial_propensities_temp);
+    solver = Solver(sampler_seed(this->seed, this->step), std::ref(initial_propensities_temp));
 } // init()
 
 /* ------------------------------------------------------------------- */
@@ -64,16 +76,21 @@ bool EnergyReactionNetworkSimulation<Solver>::execute_step()
         // update state
         energy_reaction_network.update_state(std::ref(state.homogeneous), next_reaction);
 
-        // update propensities
+        // update energy budget
+        double previous_energy_budget = state.energy_budget;
         energy_reaction_network.update_energy_budget(std::ref(state.energy_budget), next_reaction);
 
         // update propensities
+        updates.clear();
         energy_reaction_network.update_propensities(
-            this->update_function,
+            updates,
             std::ref(state.homogeneous),
             next_reaction,
+            previous_energy_budget,
             state.energy_budget);
 
+        solver.update(updates);
+
         return true;
     }
 } // execute_step()
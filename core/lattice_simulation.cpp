@@ -14,19 +14,13 @@ void LatticeSimulation::init()
 
     lattice_network.compute_initial_propensities(state.homogeneous, state.lattice, temp_initial_props);
 
-    latSolver = LatticeSolver(seed, std::ref(temp_initial_props));
-    this->update_function = [&](Update update)
-    { latSolver.update(update); };
-    lattice_update_function = [&](LatticeUpdate lattice_update,
-                                  std::unordered_map<std::string,
-                                                     std::vector<std::pair<double, int>>> &props)
-    { latSolver.update(lattice_update, props); };
+    latSolver = LatticeSolver(sampler_seed(seed, step), std::ref(temp_initial_props));
 
     lattice_network.update_adsorp_state(state.lattice, this->props,
                                         latSolver.propensity_sum,
                                         latSolver.number_of_active_indices);
-    lattice_network.update_adsorp_props(state.lattice, lattice_update_function,
-                                        state.homogeneous, std::ref(props));
+    lattice_network.update_adsorp_props(state.lattice, state.homogeneous,
+                                        std::ref(props));
 
     // only call if checkpointing
     if (state.lattice->isCheckpoint)
@@ -34,7 +28,7 @@ void LatticeSimulation::init()
         lattice_network.update_all_propensities(state.lattice, props,
                                                 latSolver.propensity_sum,
                                                 latSolver.number_of_active_indices,
-                                                lattice_update_function);
+                                                latSolver);
     }
 } // init()
 
@@ -43,7 +37,7 @@ void LatticeSimulation::init()
 bool LatticeSimulation::execute_step()
 {
 
-    std::optional<LatticeEvent> maybe_event = latSolver.event_lattice(props);
+    std::optional<LatticeEvent> maybe_event = latSolver.event_lattice(props, state.lattice->edges);
 
     if (!maybe_event)
     {
@@ -58,7 +52,7 @@ bool LatticeSimulation::execute_step()
 
         // randomly assign sites when two products
         // use boolean to determine order for trajectories
-        bool flip_sites = false;
+        bool flip_sites = event.flip_sites;
 
         // update_state
         lattice_network.update_state(state.lattice, std::ref(props),
@@ -93,7 +87,7 @@ bool LatticeSimulation::execute_step()
             }
             else
             {
-                assert(state.lattice->sites.find(site_1) != state.lattice->sites.end());
+                assert(state.lattice->sites.contains(site_1));
                 site_1_mapping = lattice_network.combine(state.lattice->sites[site_1].i,
                                                          state.lattice->sites[site_1].j,
                                                          state.lattice->sites[site_1].k);
@@ -113,7 +107,7 @@ bool LatticeSimulation::execute_step()
             }
             else
             {
-                assert(state.lattice->sites.find(site_2) != state.lattice->sites.end());
+                assert(state.lattice->sites.contains(site_2));
                 site_2_mapping = lattice_network.combine(state.lattice->sites[site_2].i,
                                                          state.lattice->sites[site_2].j,
                                                          state.lattice->sites[site_2].k);
@@ -148,7 +142,7 @@ bool LatticeSimulation::execute_step()
         // update_propensities
         lattice_network.update_propensities(state.lattice,
                                             std::ref(this->state.homogeneous),
-                                            this->update_function, lattice_update_function,
+                                            latSolver,
                                             next_reaction, event.site_one, event.site_two, props);
 
         // increment step
@@ -17,25 +17,20 @@ See the README file in the top-level RNMC directory.
 #include "../LGMC/lattice_solver.h"
 #include "../LGMC/lattice_reaction_network.h"
 
-class LatticeSimulation : public Simulation<LatticeSolver>
+class LatticeSimulation : public Simulation<LatticeSimulation>
 {
 public:
-    std::unordered_map<std::string, std::vector<std::pair<double, int>>> props;
+    LatticePropensities props;
     LatticeSolver latSolver;
     LatticeReactionNetwork &lattice_network;
     LatticeState state;
-    std::function<void(LatticeUpdate, std::unordered_map<std::string,
-                                                         std::vector<std::pair<double, int>>> &)>
-        lattice_update_function;
-
-    std::function<void(Update)> update_function;
     std::vector<LatticeTrajectoryHistoryElement> history;
     HistoryQueue<HistoryPacket<LatticeTrajectoryHistoryElement>> &history_queue;
 
     LatticeSimulation(LatticeReactionNetwork &lattice_network, unsigned long int seed,
                       int step, double time, LatticeState state_in, int history_chunk_size,
                       HistoryQueue<HistoryPacket<LatticeTrajectoryHistoryElement>> &history_queue) : // call base class constructor
-                                                                                                     Simulation<LatticeSolver>(seed, history_chunk_size, step, time),
+                                                                                                     Simulation<LatticeSimulation>(seed, history_chunk_size, step, time),
                                                                                                      lattice_network(lattice_network),
                                                                                                      history_queue(history_queue)
     {
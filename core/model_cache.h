@@ -0,0 +1,360 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_MODEL_CACHE_H
+#define RNMC_MODEL_CACHE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sql.h"
+
+// compiled model files, read and written with --model_cache. A model
+// cache holds the parts of a model which are built from its network
+// database alone, so that later runs on the same network can skip
+// reading the database row by row and rebuilding the dependency
+// graphs. What goes in is up to each model: the reactions and
+// dependency graphs for GMC and LGMC, and the species, sites,
+// interactions and distance matrix for NPMC. Anything read from the
+// initial state database is still read from there on every run.
+//
+// the file is a 40 byte header followed by the payload:
+//
+//     magic          8 bytes  "RNMCMDL1"
+//     version        4 bytes  model_cache_version
+//     kind           4 bytes  the ModelCacheKind which wrote it
+//     fingerprint    8 bytes  see database_fingerprint
+//     payload bytes  8 bytes
+//     checksum       8 bytes  of the payload, see model_cache_checksum
+//
+// the payload is a sequence of sections, each an 8 byte element count
+// and an 8 byte element size followed by the raw elements, padded to a
+// multiple of 8 bytes. Everything is in the byte order and layout of
+// the machine and build which wrote the file, which is what the
+// element sizes and version guard against. A file which doesn't match
+// is rebuilt rather than trusted.
+//
+// the reader maps the file read-only, so concurrent runs on a node
+// share its pages through the page cache, and copies each section out
+// with a single memcpy.
+
+constexpr char model_cache_magic[8] = {'R', 'N', 'M', 'C', 'M', 'D', 'L', '1'};
+constexpr uint32_t model_cache_version = 1;
+constexpr unsigned long int model_cache_header_bytes = 40;
+
+enum ModelCacheKind
+{
+    gillespie_model_cache = 1,
+    energy_model_cache = 2,
+    lattice_model_cache = 3,
+    nano_particle_model_cache = 4
+};
+
+/* ------------------------------------------------------------------- */
+
+// FNV-1a over 64 bit words. The payload is always a whole number of
+// words, and hashing a word at a time keeps up with reading the file.
+inline uint64_t model_cache_checksum(uint64_t hash, const uint8_t *data, unsigned long int bytes)
+{
+    for (unsigned long int i = 0; i + 8 <= bytes; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ul;
+    }
+    return hash;
+} // model_cache_checksum()
+
+constexpr uint64_t model_cache_checksum_seed = 0xcbf29ce484222325ul;
+
+/* ------------------------------------------------------------------- */
+
+// identifies the contents of a network database by its size and
+// modification time, mixed with any parameters which change what the
+// model builds from it. A cache is only used if its fingerprint
+// matches, so editing the database invalidates it.
+inline uint64_t database_fingerprint(const std::string &database_file_path,
+                                     uint64_t parameters)
+{
+    struct stat status;
+    if (stat(database_file_path.c_str(), &status) != 0)
+        return 0;
+
+    uint64_t values[4] = {(uint64_t)status.st_size,
+                          (uint64_t)status.st_mtim.tv_sec,
+                          (uint64_t)status.st_mtim.tv_nsec,
+                          parameters};
+
+    return model_cache_checksum(model_cache_checksum_seed,
+                                reinterpret_cast<const uint8_t *>(values),
+                                sizeof(values));
+} // database_fingerprint()
+
+/* ------------------------------------------------------------------- */
+
+class ModelCacheWriter
+{
+private:
+    FILE *file;
+    std::string path;
+    std::string temporary_path;
+    uint64_t payload_bytes;
+    uint64_t checksum;
+
+    // sections don't have to end on a word, so the bytes past the last
+    // whole word are held back until the next append completes it
+    uint8_t partial_word[8];
+
+    void append(const void *data, unsigned long int bytes)
+    {
+        if (file && std::fwrite(data, 1, bytes, file) != bytes)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+
+        const uint8_t *first = static_cast<const uint8_t *>(data);
+        unsigned long int held = payload_bytes % 8;
+        payload_bytes += bytes;
+
+        if (held > 0)
+        {
+            unsigned long int taken = std::min(bytes, 8 - held);
+            std::memcpy(partial_word + held, first, taken);
+            first += taken;
+            bytes -= taken;
+
+            if (held + taken < 8)
+                return;
+            checksum = model_cache_checksum(checksum, partial_word, 8);
+        }
+
+        checksum = model_cache_checksum(checksum, first, bytes);
+        std::memcpy(partial_word, first + bytes - bytes % 8, bytes % 8);
+    };
+
+public:
+    // the file is written under a temporary name and renamed into place
+    // by finish, so a run reading the cache never sees half of it
+    ModelCacheWriter(std::string path, ModelCacheKind kind, uint64_t fingerprint) : path(path),
+                                                                                    temporary_path(path + ".tmp." + std::to_string(getpid())),
+                                                                                    payload_bytes(0),
+                                                                                    checksum(model_cache_checksum_seed)
+    {
+        file = std::fopen(temporary_path.c_str(), "wb");
+        if (!file)
+            return;
+
+        // the header is written again by finish once the payload size
+        // and checksum are known
+        uint8_t header[model_cache_header_bytes] = {};
+        std::memcpy(header, model_cache_magic, 8);
+        uint32_t fields[2] = {model_cache_version, (uint32_t)kind};
+        std::memcpy(header + 8, fields, 8);
+        std::memcpy(header + 16, &fingerprint, 8);
+
+        if (std::fwrite(header, 1, model_cache_header_bytes, file) != model_cache_header_bytes)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+    };
+
+    ~ModelCacheWriter()
+    {
+        if (file)
+        {
+            std::fclose(file);
+            std::remove(temporary_path.c_str());
+        }
+    };
+
+    ModelCacheWriter(ModelCacheWriter &other) = delete;
+    ModelCacheWriter &operator=(ModelCacheWriter &other) = delete;
+
+    template <typename T>
+    void write(const T *elements, uint64_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        uint64_t section[2] = {count, sizeof(T)};
+        append(section, sizeof(section));
+        append(elements, count * sizeof(T));
+
+        uint64_t padding = 0;
+        append(&padding, (8 - (count * sizeof(T)) % 8) % 8);
+    };
+
+    template <typename T>
+    void write(const std::vector<T> &elements)
+    {
+        write(elements.data(), elements.size());
+    };
+
+    template <typename T>
+    void write_value(const T &value)
+    {
+        write(&value, 1);
+    };
+
+    // returns false if anything failed to write, in which case there is
+    // no cache file
+    bool finish()
+    {
+        if (!file)
+            return false;
+
+        bool ok = std::fseek(file, 24, SEEK_SET) == 0 &&
+                  std::fwrite(&payload_bytes, 1, 8, file) == 8 &&
+                  std::fwrite(&checksum, 1, 8, file) == 8;
+
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+
+        if (!ok || std::rename(temporary_path.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary_path.c_str());
+            return false;
+        }
+
+        return true;
+    };
+};
+
+/* ------------------------------------------------------------------- */
+
+class ModelCacheReader
+{
+private:
+    const uint8_t *contents;
+    unsigned long int size;
+    unsigned long int position;
+
+public:
+    ModelCacheReader() : contents(nullptr), size(0), position(0) {};
+
+    ~ModelCacheReader()
+    {
+        if (contents)
+            munmap(const_cast<uint8_t *>(contents), size);
+    };
+
+    ModelCacheReader(ModelCacheReader &other) = delete;
+    ModelCacheReader &operator=(ModelCacheReader &other) = delete;
+
+    // map the file and check its header and checksum. Returns false if
+    // the file is missing, was written by another kind of model or
+    // version, doesn't match fingerprint or is damaged.
+    bool open(std::string path, ModelCacheKind kind, uint64_t fingerprint)
+    {
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            return false;
+
+        struct stat status;
+        if (fstat(descriptor, &status) != 0 ||
+            (unsigned long int)status.st_size < model_cache_header_bytes)
+        {
+            ::close(descriptor);
+            return false;
+        }
+
+        size = status.st_size;
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+        ::close(descriptor);
+
+        if (mapping == MAP_FAILED)
+            return false;
+
+        contents = static_cast<const uint8_t *>(mapping);
+        position = model_cache_header_bytes;
+
+        uint32_t fields[2];
+        uint64_t file_fingerprint, payload_bytes, checksum;
+        std::memcpy(fields, contents + 8, 8);
+        std::memcpy(&file_fingerprint, contents + 16, 8);
+        std::memcpy(&payload_bytes, contents + 24, 8);
+        std::memcpy(&checksum, contents + 32, 8);
+
+        if (std::memcmp(contents, model_cache_magic, 8) != 0 ||
+            fields[0] != model_cache_version ||
+            fields[1] != (uint32_t)kind ||
+            file_fingerprint != fingerprint ||
+            payload_bytes != size - model_cache_header_bytes)
+            return false;
+
+        // the sections are read in order straight after this, so
+        // checking the whole payload up front costs little extra
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        return checksum == model_cache_checksum(model_cache_checksum_seed,
+                                                contents + model_cache_header_bytes,
+                                                payload_bytes);
+    };
+
+    // the next section, which must have been written from elements of
+    // type T. Returns a pointer into the mapping, valid for the life of
+    // the reader, or nullptr if the section doesn't match.
+    template <typename T>
+    const T *section(uint64_t &count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        uint64_t header[2];
+        if (!contents || position + sizeof(header) > size)
+            return nullptr;
+
+        std::memcpy(header, contents + position, sizeof(header));
+        count = header[0];
+        uint64_t bytes = count * sizeof(T);
+
+        if (header[1] != sizeof(T) ||
+            count > (size - position - sizeof(header)) / sizeof(T))
+            return nullptr;
+
+        const T *elements = reinterpret_cast<const T *>(contents + position + sizeof(header));
+        position += sizeof(header) + bytes + (8 - bytes % 8) % 8;
+        return elements;
+    };
+
+    template <typename T>
+    bool read(std::vector<T> &elements)
+    {
+        uint64_t count;
+        const T *first = section<T>(count);
+        if (!first)
+            return false;
+
+        elements.resize(count);
+        if (count > 0)
+            std::memcpy(elements.data(), first, count * sizeof(T));
+        return true;
+    };
+
+    template <typename T>
+    bool read_value(T &value)
+    {
+        uint64_t count;
+        const T *first = section<T>(count);
+        if (!first || count != 1)
+            return false;
+
+        std::memcpy(&value, first, sizeof(T));
+        return true;
+    };
+};
+
+#endif
@@ -14,7 +14,7 @@ void NanoParticleSimulation::init()
 
     seed_site_reaction_dependency.resize(nano_particle.sites.size());
     nano_particle.compute_reactions(state, std::ref(seed_reactions), std::ref(seed_site_reaction_dependency));
-    nanoSolver = NanoSolver(this->seed, std::ref(seed_reactions));
+    nanoSolver = NanoSolver(sampler_seed(this->seed, this->step), std::ref(seed_reactions));
     site_reaction_dependency = seed_site_reaction_dependency;
 } // init()
 
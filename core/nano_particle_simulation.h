@@ -17,7 +17,7 @@ See the README file in the top-level RNMC directory.
 #include "../NPMC/nano_solver.h"
 #include "../NPMC/nano_particle.h"
 
-class NanoParticleSimulation : public Simulation<NanoSolver>
+class NanoParticleSimulation : public Simulation<NanoParticleSimulation>
 {
 public:
     NanoParticle &nano_particle;
@@ -32,9 +32,9 @@ public:
                            double time, std::vector<int> state,
                            int history_chunk_size,
                            HistoryQueue<HistoryPacket<NanoTrajectoryHistoryElement>> &history_queue) : // call base class constructor
-                                                                                                       Simulation<NanoSolver>(seed, history_chunk_size, step, time),
+                                                                                                       Simulation<NanoParticleSimulation>(seed, history_chunk_size, step, time),
                                                                                                        nano_particle(nano_particle),
-                                                                                                       state(state),
+                                                                                                       state(std::move(state)),
                                                                                                        history_queue(history_queue)
     {
         history.reserve(this->history_chunk_size);
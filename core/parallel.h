@@ -0,0 +1,45 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_PARALLEL_H
+#define RNMC_PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// the number of ranges parallel_ranges splits [0, n) into
+inline int parallel_range_count(int thread_count, unsigned long int n)
+{
+    return std::max(1ul, std::min((unsigned long int)std::max(thread_count, 1), n));
+} // parallel_range_count()
+
+// split [0, n) into thread_count contiguous ranges of nearly equal size
+// and call f(thread_id, begin, end) for each of them, one range per
+// thread. Range 0 runs on the calling thread. Returns once every range
+// is done. Used for the startup work which touches every reaction, so
+// each range writes to its own slice of the output and no locking is
+// needed.
+template <typename F>
+void parallel_ranges(int thread_count, unsigned long int n, F f)
+{
+    unsigned long int number_of_ranges = parallel_range_count(thread_count, n);
+
+    auto range_begin = [&](unsigned long int i)
+    { return n / number_of_ranges * i + std::min(i, n % number_of_ranges); };
+
+    std::vector<std::thread> threads;
+    for (unsigned long int i = 1; i < number_of_ranges; i++)
+        threads.push_back(std::thread(f, (int)i, range_begin(i), range_begin(i + 1)));
+
+    f(0, range_begin(0), range_begin(1));
+
+    for (std::thread &thread : threads)
+        thread.join();
+} // parallel_ranges()
+
+#endif
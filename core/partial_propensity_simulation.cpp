@@ -0,0 +1,71 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include "partial_propensity_simulation.h"
+
+void PartialPropensitySimulation::init()
+{
+    // no per reaction propensities are computed, the solver only needs
+    // the species counts
+    solver = PartialPropensitySolver(sampler_seed(this->seed, this->step),
+                                     reaction_network.reactant_groups,
+                                     state);
+} // init()
+
+/* ------------------------------------------------------------------- */
+
+bool PartialPropensitySimulation::execute_step()
+{
+    std::optional<Event> maybe_event = solver.event(state);
+
+    if (!maybe_event)
+    {
+
+        return false;
+    }
+    else
+    {
+        // an event happens
+        Event event = maybe_event.value();
+        int next_reaction = event.index;
+
+        // update time
+        this->time += event.dt;
+
+        // record what happened
+        history.push_back(ReactionNetworkTrajectoryHistoryElement{
+            .seed = this->seed,
+            .reaction_id = next_reaction,
+            .time = this->time,
+            .step = this->step});
+
+        if (history.size() == this->history_chunk_size)
+        {
+            history_queue.insert_history(
+                std::move(
+                    HistoryPacket<ReactionNetworkTrajectoryHistoryElement>{
+                        .seed = this->seed,
+                        .history = std::move(this->history)}));
+
+            history = std::vector<ReactionNetworkTrajectoryHistoryElement>();
+            history.reserve(this->history_chunk_size);
+        }
+
+        // increment step
+        this->step++;
+
+        // update state
+        reaction_network.update_state(std::ref(state), next_reaction);
+
+        // update partial propensities
+        int species[4];
+        int number_of_species = reaction_network.changed_species(next_reaction, species);
+        solver.update(state, species, number_of_species);
+
+        return true;
+    }
+} // execute_step()
@@ -0,0 +1,50 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_PARTIAL_PROPENSITY_SIMULATION_H
+#define RNMC_PARTIAL_PROPENSITY_SIMULATION_H
+
+#include "../GMC/gillespie_reaction_network.h"
+#include "../GMC/partial_propensity_solver.h"
+#include "simulation.h"
+
+// a GMC simulation driven by the partial propensity solver. The
+// reaction network must have computed its reactant groups before any
+// simulation is constructed.
+class PartialPropensitySimulation : public Simulation<PartialPropensitySimulation>
+{
+private:
+    PartialPropensitySolver solver;
+
+public:
+    GillespieReactionNetwork &reaction_network;
+    std::vector<int> state;
+    std::vector<ReactionNetworkTrajectoryHistoryElement> history;
+    HistoryQueue<HistoryPacket<ReactionNetworkTrajectoryHistoryElement>> &history_queue;
+
+    PartialPropensitySimulation(GillespieReactionNetwork &reaction_network,
+                                unsigned long int seed,
+                                int step,
+                                double time,
+                                std::vector<int> state,
+                                int history_chunk_size,
+                                HistoryQueue<HistoryPacket<ReactionNetworkTrajectoryHistoryElement>> &history_queue) : // call base class constructor
+                                                                                                                       Simulation<PartialPropensitySimulation>(seed, history_chunk_size, step, time),
+                                                                                                                       reaction_network(reaction_network),
+                                                                                                                       state(std::move(state)),
+                                                                                                                       history_queue(history_queue)
+    {
+        history.reserve(this->history_chunk_size);
+    };
+
+    void init();
+    bool execute_step();
+};
+
+#include "partial_propensity_simulation.cpp"
+
+#endif
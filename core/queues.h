@@ -9,9 +9,16 @@ See the README file in the top-level RNMC directory.
 #define RNMC_QUEUES_H
 
 #include <queue>
+#include <vector>
+#include <map>
+#include <functional>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <optional>
 
+#include "RNMC_types.h"
+
 struct SeedQueue
 {
     std::queue<unsigned long int> seeds;
@@ -46,6 +53,86 @@ struct SeedQueue
 
 /* ------------------------------------------------------------------- */
 
+// the states simulations start from, shared by all the simulator
+// threads. Only seeds whose state was read from a checkpoint are held.
+// Every other seed starts from a default state, which is made by the
+// thread that claims the seed from the SeedQueue. Each seed is taken
+// exactly once, so a stored state is moved out rather than copied and
+// the states alive at any time scale with the number of threads, not
+// the number of seeds.
+template <typename State>
+class SeedStateStore
+{
+private:
+    std::map<unsigned long int, State> states;
+    std::function<State()> make_default;
+    std::mutex mutex;
+
+public:
+    SeedStateStore() {};
+
+    SeedStateStore(SeedStateStore &other) = delete;
+    SeedStateStore &operator=(SeedStateStore &other) = delete;
+
+    // make_default is called from the simulator threads, so it must
+    // only read what it shares with them
+    void set_default(std::function<State()> make_default_in)
+    {
+        make_default = std::move(make_default_in);
+    };
+
+    // the stored state of seed, made from the default the first time it
+    // is used. For reading checkpoints before the simulator threads
+    // start, so it doesn't lock.
+    State &operator[](unsigned long int seed)
+    {
+        auto it = states.find(seed);
+        if (it == states.end())
+            it = states.emplace(seed, make_default()).first;
+
+        return it->second;
+    };
+
+    template <typename F>
+    void for_each(F f)
+    {
+        for (auto &entry : states)
+            f(entry.first, entry.second);
+    };
+
+    State take(unsigned long int seed)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = states.find(seed);
+            if (it != states.end())
+            {
+                State result = std::move(it->second);
+                states.erase(it);
+                return result;
+            }
+        }
+
+        return make_default();
+    };
+};
+
+/* ------------------------------------------------------------------- */
+
+// minimum number of packets a HistoryQueue can hold. The capacity is
+// rounded up to a power of two so a position maps to a slot with a mask.
+constexpr unsigned long int minimum_history_queue_capacity = 64;
+
+// a simulator thread only queues a packet every history_chunk_size steps
+// plus a state, cutoff and trajectory packet when a simulation finishes,
+// so a few slots per thread keep producers from blocking unless the
+// dispatcher is genuinely behind.
+inline unsigned long int history_queue_capacity(int number_of_threads)
+{
+    return 4 * (unsigned long int)number_of_threads;
+}
+
 template <typename T>
 struct HistoryQueue
 {
@@ -64,35 +151,220 @@ struct HistoryQueue
     // to exactly the same memory as the vector which is used to write
     // to the initial state database, and every time a move is
     // supposed to happen, the old reference is actually zerod out).
-    std::queue<T> history_packets;
+    //
+    // the queue itself is Dmitry Vyukov's bounded MPMC ring buffer,
+    // used with many producers (the simulator threads) and a single
+    // consumer (the dispatcher). Each slot carries a sequence number:
+    // a slot at position p is free for a producer when its sequence is
+    // p and holds a packet for the consumer when its sequence is p + 1.
+    // Producers claim a position with a CAS on enqueue_position, so
+    // neither side takes a lock while packets are flowing.
+    //
+    // the mutex and condition variables are only used to sleep. The
+    // consumer sleeps when the queue is empty and producers sleep when
+    // it is full. Each side publishes that it is sleeping before its
+    // final check, and the other side bumps a counter before checking
+    // for sleepers, so a wakeup can't be lost between the two.
+    //
+    // if max_bytes_in_flight is set, producers also wait while the
+    // packets sitting in the queue, or taken out with take_history and
+    // not yet released, hold more than that much memory. A packet is
+    // always accepted when no other packet is holding memory, so a
+    // single packet larger than the limit can't block forever.
+    struct Slot
+    {
+        std::atomic<unsigned long int> sequence;
+        unsigned long int bytes;
+        T packet;
+    };
+
+    std::vector<Slot> slots;
+    unsigned long int mask;
+    alignas(64) std::atomic<unsigned long int> enqueue_position;
+    alignas(64) std::atomic<unsigned long int> dequeue_position;
+
+    unsigned long int max_bytes_in_flight; // 0 for no limit
+    std::atomic<unsigned long int> bytes_in_flight;
+
     std::mutex mutex;
+    std::condition_variable consumer_condition;
+    std::condition_variable producer_condition;
+    std::atomic<unsigned long int> consumer_wakeups; // bumped by every insert and notify_consumer
+    std::atomic<unsigned long int> producer_wakeups; // bumped by every successful get_history and release_bytes
+    std::atomic<bool> consumer_sleeping;
+    std::atomic<int> number_of_sleeping_producers;
+
+    HistoryQueue(unsigned long int capacity = minimum_history_queue_capacity) : enqueue_position(0),
+                                                                               dequeue_position(0),
+                                                                               max_bytes_in_flight(0),
+                                                                               bytes_in_flight(0),
+                                                                               consumer_wakeups(0),
+                                                                               producer_wakeups(0),
+                                                                               consumer_sleeping(false),
+                                                                               number_of_sleeping_producers(0)
+    {
+        unsigned long int size = minimum_history_queue_capacity;
+        while (size < capacity)
+            size *= 2;
+
+        slots = std::vector<Slot>(size);
+        mask = size - 1;
+        for (unsigned long int i = 0; i < size; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
 
     bool empty()
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        return history_packets.empty();
+        unsigned long int position = dequeue_position.load(std::memory_order_relaxed);
+        return slots[position & mask].sequence.load(std::memory_order_acquire) != position + 1;
     }
 
+    // returns false without touching history_packet if the queue is full
+    // or the packet would take it over max_bytes_in_flight
+    bool try_insert_history(T &history_packet)
+    {
+        unsigned long int bytes = history_packet_bytes(history_packet);
+        unsigned long int current_bytes = bytes_in_flight.load();
+        do
+        {
+            if (max_bytes_in_flight > 0 &&
+                current_bytes > 0 &&
+                current_bytes + bytes > max_bytes_in_flight)
+                return false;
+        } while (!bytes_in_flight.compare_exchange_weak(current_bytes, current_bytes + bytes));
+
+        unsigned long int position = enqueue_position.load(std::memory_order_relaxed);
+        Slot *slot;
+
+        while (true)
+        {
+            slot = &slots[position & mask];
+            unsigned long int sequence = slot->sequence.load(std::memory_order_acquire);
+            long int difference = (long int)sequence - (long int)position;
+
+            if (difference == 0)
+            {
+                if (enqueue_position.compare_exchange_weak(position, position + 1,
+                                                           std::memory_order_relaxed))
+                    break;
+            }
+            else if (difference < 0)
+            {
+                bytes_in_flight -= bytes;
+                return false;
+            }
+            else
+                position = enqueue_position.load(std::memory_order_relaxed);
+        }
+
+        slot->bytes = bytes;
+        slot->packet = std::move(history_packet);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // blocks while the queue is full or over max_bytes_in_flight
     void insert_history(T history_packet)
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        history_packets.push(std::move(history_packet));
+        while (true)
+        {
+            unsigned long int ticket = producer_wakeups.load();
+            if (try_insert_history(history_packet))
+                break;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            number_of_sleeping_producers++;
+            producer_condition.wait(lock, [&]
+                                    { return producer_wakeups.load() != ticket; });
+            number_of_sleeping_producers--;
+        }
+
+        notify_consumer();
     }
 
+    // only the dispatcher thread may call get_history
     std::optional<T> get_history()
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        if (history_packets.empty())
+        unsigned long int bytes = 0;
+        std::optional<T> maybe_packet = take_history(bytes);
+        if (maybe_packet)
+            release_bytes(bytes);
+
+        return maybe_packet;
+    };
+
+    // like get_history, but the packet's bytes stay counted against
+    // max_bytes_in_flight until they are handed back with release_bytes,
+    // e.g. once the packet has been written. Only the dispatcher thread
+    // may call take_history.
+    std::optional<T> take_history(unsigned long int &bytes)
+    {
+        unsigned long int position = dequeue_position.load(std::memory_order_relaxed);
+        Slot &slot = slots[position & mask];
+
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1)
         {
+            // empty, or a producer has claimed the slot but not yet
+            // filled it. Either way it will wake the consumer once the
+            // packet is visible.
             return std::optional<T>();
         }
-        else
+
+        T result = std::move(slot.packet);
+        bytes = slot.bytes;
+        slot.sequence.store(position + mask + 1, std::memory_order_release);
+        dequeue_position.store(position + 1, std::memory_order_relaxed);
+
+        wake_producers();
+
+        return std::optional<T>(std::move(result));
+    };
+
+    // any thread may release bytes taken with take_history
+    void release_bytes(unsigned long int bytes)
+    {
+        bytes_in_flight -= bytes;
+        wake_producers();
+    };
+
+    void wake_producers()
+    {
+        producer_wakeups++;
+        if (number_of_sleeping_producers.load() > 0)
         {
-            T result = std::move(history_packets.front());
-            history_packets.pop();
-            return std::optional<T>(std::move(result));
+            std::lock_guard<std::mutex> lock(mutex);
+            producer_condition.notify_all();
         }
     };
+
+    // the consumer takes a ticket before checking for work, and
+    // wait_for_history returns as soon as anything has been inserted or
+    // notify_consumer has been called since the ticket was taken.
+    unsigned long int consumer_ticket()
+    {
+        return consumer_wakeups.load();
+    }
+
+    void wait_for_history(unsigned long int ticket)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        consumer_sleeping = true;
+        consumer_condition.wait(lock, [&]
+                                { return consumer_wakeups.load() != ticket; });
+        consumer_sleeping = false;
+    }
+
+    // wake the consumer without inserting anything, e.g. when a
+    // simulator thread has finished
+    void notify_consumer()
+    {
+        consumer_wakeups++;
+        if (consumer_sleeping.load())
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            consumer_condition.notify_one();
+        }
+    }
 };
 
 #endif
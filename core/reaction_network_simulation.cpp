@@ -11,11 +11,18 @@ See the README file in the top-level RNMC directory.
 template <typename Solver>
 void ReactionNetworkSimulation<Solver>::init()
 {
+    // seeds starting from the initial state share the propensities
+    // computed when the network was loaded
+    if (state == reaction_network.initial_state &&
+        reaction_network.initial_state_propensities.size() == reaction_network.reactions.size())
+    {
+        solver = Solver(sampler_seed(this->seed, this->step), std::ref(reaction_network.initial_state_propensities));
+        return;
+    }
+
     std::vector<double> initial_propensities_temp;
     reaction_network.compute_initial_propensities(state, initial_propensities_temp);
-    solver = Solver(this->seed, std::ref(initial_propensities_temp));
-    this->update_function = [&](Update update)
-    { solver.update(update); };
+    solver = Solver(sampler_seed(this->seed, this->step), std::ref(initial_propensities_temp));
 
 } // init()
 
@@ -66,11 +73,14 @@ bool ReactionNetworkSimulation<Solver>::execute_step()
         reaction_network.update_state(std::ref(state), next_reaction);
 
         // update propensities
+        updates.clear();
         reaction_network.update_propensities(
-            this->update_function,
+            updates,
             std::ref(state),
             next_reaction);
 
+        solver.update(updates);
+
         return true;
     }
 } // execute_step()
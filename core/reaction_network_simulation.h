@@ -10,12 +10,14 @@ See the README file in the top-level RNMC directory.
 
 #include "../GMC/gillespie_reaction_network.h"
 #include "simulation.h"
+#include "sampler.h"
 
 template <typename Solver>
-class ReactionNetworkSimulation : public Simulation<Solver>
+class ReactionNetworkSimulation : public Simulation<ReactionNetworkSimulation<Solver>>
 {
 private:
     Solver solver;
+    std::vector<Update> updates; // propensity updates for the current step
 
 public:
     GillespieReactionNetwork &reaction_network;
@@ -30,9 +32,9 @@ public:
                               std::vector<int> state,
                               int history_chunk_size,
                               HistoryQueue<HistoryPacket<ReactionNetworkTrajectoryHistoryElement>> &history_queue) : // call base class constructor
-                                                                                                                     Simulation<Solver>(seed, history_chunk_size, step, time),
+                                                                                                                     Simulation<ReactionNetworkSimulation<Solver>>(seed, history_chunk_size, step, time),
                                                                                                                      reaction_network(reaction_network),
-                                                                                                                     state(state),
+                                                                                                                     state(std::move(state)),
                                                                                                                      history_queue(history_queue)
     {
         history.reserve(this->history_chunk_size);
@@ -9,26 +9,316 @@ See the README file in the top-level RNMC directory.
 #define RNMC_SAMPLER_H
 
 #include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
 #include <utility>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
 
 // we are using GSL random number generation because i don't trust
 // random number generation to be consistent across various C++ stdlib
 // implementations, and for the kind of MC simulator we are writing here,
 // we want to be able to run it deterministically for testing purposes.
+//
+// the philox backend is a counter based generator (Salmon et al.,
+// "Parallel random numbers: as easy as 1, 2, 3", SC11). Each number is a
+// pure function of the seed and a counter, and the counter of a draw is
+// the step it is drawn for and how many draws of its kind came before
+// it in that step. A simulation resumed at step n from a checkpoint
+// therefore draws exactly the numbers an uninterrupted one would. Solvers
+// draw one or two numbers a step, so the sampler computes those for 16
+// steps at a time in loops the compiler can vectorize, and any further
+// draws in a step one at a time. The poisson and binomial draws used by
+// tau leaping and slow scale still come from GSL.
+
+enum SamplerBackend
+{
+    gsl_sampler,
+    philox_sampler
+};
+
+// chosen once with --rng before any simulation starts
+inline SamplerBackend sampler_backend = gsl_sampler;
+
+inline bool parse_sampler_backend(std::string name, SamplerBackend &backend)
+{
+    if (name == "gsl")
+        backend = gsl_sampler;
+    else if (name == "philox")
+        backend = philox_sampler;
+    else
+        return false;
+
+    return true;
+} // parse_sampler_backend()
+
+/* ------------------------------------------------------------------- */
+
+// what a sampler is constructed with: the seed, and the step of the
+// first draws, which is where a simulation resuming from a checkpoint
+// picks up. The GSL backend only uses the seed, so a resumed run
+// starts its seed's stream again.
+struct SamplerSeed
+{
+    unsigned long int seed;
+    int step;
+
+    SamplerSeed(unsigned long int seed, int step = 0) : seed(seed), step(step){};
+};
+
+inline SamplerSeed sampler_seed(unsigned long int seed, int step)
+{
+    return SamplerSeed(seed, step);
+} // sampler_seed()
+
+/* ------------------------------------------------------------------- */
+
+// Philox4x32-10 on a batch of counters at once. Lane i gets the counter
+// (block + i, word2, word3), with block + i taking the first two words,
+// and its four output words are written to out[4 * i] to out[4 * i + 3].
+// The 32 bit words are held in 64 bit lanes so that the widening
+// multiplies vectorize.
+constexpr int philox_lanes = 16;
+
+template <int lanes = philox_lanes>
+inline void philox4x32_10(const uint32_t key[2], uint64_t block, uint32_t word2,
+                          uint32_t word3, uint32_t out[4 * lanes])
+{
+    const uint64_t low_word = 0xffffffffu;
+    uint64_t c0[lanes], c1[lanes], c2[lanes], c3[lanes];
+
+    for (int i = 0; i < lanes; i++)
+    {
+        c0[i] = (block + i) & low_word;
+        c1[i] = (block + i) >> 32;
+        c2[i] = word2;
+        c3[i] = word3;
+    }
+
+    uint64_t k0 = key[0];
+    uint64_t k1 = key[1];
+
+    for (int round = 0; round < 10; round++)
+    {
+        for (int i = 0; i < lanes; i++)
+        {
+            uint64_t product0 = 0xd2511f53ul * (c0[i] & low_word);
+            uint64_t product1 = 0xcd9e8d57ul * (c2[i] & low_word);
+
+            uint64_t next0 = (product1 >> 32) ^ c1[i] ^ k0;
+            uint64_t next2 = (product0 >> 32) ^ c3[i] ^ k1;
+
+            c0[i] = next0;
+            c1[i] = product1 & low_word;
+            c2[i] = next2;
+            c3[i] = product0 & low_word;
+        }
+
+        k0 = (k0 + 0x9e3779b9u) & low_word;
+        k1 = (k1 + 0xbb67ae85u) & low_word;
+    }
+
+    for (int i = 0; i < lanes; i++)
+    {
+        out[4 * i] = (uint32_t)c0[i];
+        out[4 * i + 1] = (uint32_t)c1[i];
+        out[4 * i + 2] = (uint32_t)c2[i];
+        out[4 * i + 3] = (uint32_t)c3[i];
+    }
+} // philox4x32_10()
+
+// 52 random bits from two words, mapped to the centre of one of 2^52
+// equal intervals of (0, 1), so the result is never 0 or 1. The bits
+// become the mantissa of a number in [1, 2), which avoids an integer
+// to double conversion, and every step is exact.
+inline double philox_uniform(uint32_t high, uint32_t low)
+{
+    uint64_t bits = ((((uint64_t)high << 32) | low) >> 12) | 0x3ff0000000000000ull;
+
+    double one_to_two;
+    std::memcpy(&one_to_two, &bits, 8);
+    return (one_to_two - 1.0) + 0x1p-53;
+} // philox_uniform()
+
+// natural log of a positive normal double, without branches so that a
+// loop over it vectorizes. The mantissa is reduced to [sqrt(1/2), sqrt(2))
+// and log(m) = 2 atanh((m - 1) / (m + 1)) summed as a series, which is
+// within a few ulp of std::log. Being our own, it also gives the same
+// waiting times on every platform.
+inline double sampler_log(double x)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &x, 8);
+
+    // mantissas above sqrt(2) are halved and the exponent raised. The
+    // test is on the high word, which is close enough to sqrt(2) for the
+    // series, and is done in integers because compilers won't turn a
+    // floating point comparison into a select.
+    uint64_t mantissa_bits = (bits & 0xfffffffffffffull) | 0x3ff0000000000000ull;
+    uint64_t large = (uint32_t)(mantissa_bits >> 32) > 0x3ff6a09eu;
+    mantissa_bits -= large << 52;
+
+    // the biased exponent is placed in the mantissa of 2^52, which gives
+    // it as a double without an integer conversion
+    uint64_t exponent_bits = ((bits >> 52) + large) | 0x4330000000000000ull;
+
+    double e, m;
+    std::memcpy(&e, &exponent_bits, 8);
+    std::memcpy(&m, &mantissa_bits, 8);
+    e -= 0x1p52 + 1023.0;
+
+    double s = (m - 1.0) / (m + 1.0);
+    double z = s * s;
+
+    // 2 / (2k + 1) for k = 1 to 10. |s| < 0.172, so the next term is
+    // below 1e-16 of the sum.
+    double series =
+        z * (0.6666666666666666 +
+             z * (0.4 +
+                  z * (0.2857142857142857 +
+                       z * (0.2222222222222222 +
+                            z * (0.18181818181818182 +
+                                 z * (0.15384615384615385 +
+                                      z * (0.13333333333333333 +
+                                           z * (0.11764705882352941 +
+                                                z * (0.10526315789473684 +
+                                                     z * 0.09523809523809523)))))))));
+
+    double log_m = 2.0 * s + s * series;
+
+    // ln 2 split so that e * ln2_high is exact
+    const double ln2_high = 6.93147180369123816490e-01;
+    const double ln2_low = 1.90821492927058770002e-10;
+
+    return e * ln2_high + (e * ln2_low + log_m);
+} // sampler_log()
+
+/* ------------------------------------------------------------------- */
 
 class Sampler
 {
 private:
     gsl_rng *internal_rng_state;
 
+    // philox backend. Draw d of a kind in step n uses half of the
+    // output of the counter (n, stream + 2 * (d / 2 >> 32), d / 2), so
+    // uniforms and exponentials come from separate streams and the
+    // numbers a solver draws don't depend on the order it asks for the
+    // two kinds. The first two draws of each kind are buffered for
+    // philox_lanes steps, starting at the buffer's block.
+    static constexpr int buffer_size = 2 * philox_lanes;
+    static constexpr uint32_t uniform_stream = 0;
+    static constexpr uint32_t exponential_stream = 1;
+
+    SamplerBackend backend;
+    uint32_t key[2];
+    uint64_t step;
+    uint64_t uniform_draw;     // uniforms drawn so far in this step
+    uint64_t exponential_draw; // exponentials drawn so far in this step
+    uint64_t uniform_block;
+    uint64_t exponential_block;
+    double uniforms[buffer_size];
+    double exponentials[buffer_size];
+
+    bool buffered(uint64_t block)
+    {
+        return step >= block && step - block < philox_lanes;
+    };
+
+    void fill(uint32_t stream, uint64_t &block, double *buffer)
+    {
+        uint32_t words[4 * philox_lanes];
+        philox4x32_10(key, step, stream, 0, words);
+        block = step;
+
+        for (int i = 0; i < buffer_size; i++)
+            buffer[i] = philox_uniform(words[2 * i], words[2 * i + 1]);
+    };
+
+    // the uniform for a draw past the buffered ones
+    double draw_one(uint32_t stream, uint64_t draw)
+    {
+        uint32_t words[4];
+        uint64_t pair = draw / 2;
+        philox4x32_10<1>(key, step, stream + 2 * (uint32_t)(pair >> 32), (uint32_t)pair, words);
+
+        int half = 2 * (draw % 2);
+        return philox_uniform(words[half], words[half + 1]);
+    };
+
 public:
     unsigned long int seed;
     double generate()
     {
-        return gsl_rng_uniform_pos(internal_rng_state);
+        if (backend == gsl_sampler)
+            return gsl_rng_uniform_pos(internal_rng_state);
+
+        uint64_t draw = uniform_draw++;
+        if (draw >= 2)
+            return draw_one(uniform_stream, draw);
+
+        if (!buffered(uniform_block))
+            fill(uniform_stream, uniform_block, uniforms);
+
+        return uniforms[2 * (step - uniform_block) + draw];
+    };
+
+    // waiting time of a poisson process with rate 1. With GSL this is
+    // -log of the next uniform, so it draws exactly as the solvers did
+    // before it existed.
+    double exponential()
+    {
+        if (backend == gsl_sampler)
+            return -std::log(gsl_rng_uniform_pos(internal_rng_state));
+
+        uint64_t draw = exponential_draw++;
+        if (draw >= 2)
+            return -sampler_log(draw_one(exponential_stream, draw));
+
+        if (!buffered(exponential_block))
+        {
+            fill(exponential_stream, exponential_block, exponentials);
+            for (int i = 0; i < buffer_size; i++)
+                exponentials[i] = -sampler_log(exponentials[i]);
+        }
+
+        return exponentials[2 * (step - exponential_block) + draw];
     };
 
-    Sampler(unsigned long int n) : seed(n)
+    // called by a solver once it has drawn everything for an event, so
+    // that the next event's draws are counted from the next step
+    void next_step()
+    {
+        step++;
+        uniform_draw = 0;
+        exponential_draw = 0;
+    };
+
+    // number of events of a poisson process with the given mean
+    unsigned int poisson(double mean)
+    {
+        return gsl_ran_poisson(internal_rng_state, mean);
+    };
+
+    // number of successes in n independent trials with probability p
+    unsigned int binomial(double p, unsigned int n)
+    {
+        return gsl_ran_binomial(internal_rng_state, p, n);
+    };
+
+    // the buffers start out empty, which a block past the first step
+    // stands for
+    Sampler(SamplerSeed n) : backend(sampler_backend),
+                             key{(uint32_t)n.seed, (uint32_t)((uint64_t)n.seed >> 32)},
+                             step(n.step),
+                             uniform_draw(0),
+                             exponential_draw(0),
+                             uniform_block(step + 1),
+                             exponential_block(step + 1),
+                             uniforms(),
+                             exponentials(),
+                             seed(n.seed)
     {
         internal_rng_state = gsl_rng_alloc(gsl_rng_default);
         gsl_rng_set(internal_rng_state, seed);
@@ -45,7 +335,18 @@ public:
 
     // move constructor
     Sampler(Sampler &&other) : internal_rng_state(std::exchange(other.internal_rng_state, nullptr)),
-                               seed(other.seed) {};
+                               backend(other.backend),
+                               key{other.key[0], other.key[1]},
+                               step(other.step),
+                               uniform_draw(other.uniform_draw),
+                               exponential_draw(other.exponential_draw),
+                               uniform_block(other.uniform_block),
+                               exponential_block(other.exponential_block),
+                               seed(other.seed)
+    {
+        std::memcpy(uniforms, other.uniforms, sizeof(uniforms));
+        std::memcpy(exponentials, other.exponentials, sizeof(exponentials));
+    };
 
     // since we don't have access to gsl internal state, can't write
     // copy assignment operator
@@ -55,6 +356,16 @@ public:
     Sampler &operator=(Sampler &&other)
     {
         seed = other.seed;
+        backend = other.backend;
+        key[0] = other.key[0];
+        key[1] = other.key[1];
+        step = other.step;
+        uniform_draw = other.uniform_draw;
+        exponential_draw = other.exponential_draw;
+        uniform_block = other.uniform_block;
+        exponential_block = other.exponential_block;
+        std::memcpy(uniforms, other.uniforms, sizeof(uniforms));
+        std::memcpy(exponentials, other.exponentials, sizeof(exponentials));
 
         // we move the existing internal_rng_state into other so
         // it gets freed when other is dropped.
@@ -63,4 +374,4 @@ public:
     };
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -9,10 +9,10 @@ See the README file in the top-level RNMC directory.
 
 #include "simulation.h"
 
-template <typename Solver>
-void Simulation<Solver>::execute_steps(int step_cutoff)
+template <typename Derived>
+void Simulation<Derived>::execute_steps(int step_cutoff)
 {
-    while (execute_step())
+    while (derived().execute_step())
     {
         if (this->step > step_cutoff)
         {
@@ -29,10 +29,12 @@ void Simulation<Solver>::execute_steps(int step_cutoff)
 
 /* ------------------------------------------------------------------- */
 
-template <typename Solver>
-void Simulation<Solver>::execute_time(double time_cutoff)
+template <typename Derived>
+void Simulation<Derived>::execute_time(double time_cutoff)
 {
-    while (execute_step())
+    this->time_cutoff = time_cutoff;
+
+    while (derived().execute_step())
     {
         if (time > time_cutoff)
         {
@@ -49,16 +51,8 @@ void Simulation<Solver>::execute_time(double time_cutoff)
 
 /* ------------------------------------------------------------------- */
 
-template <typename Solver>
-bool Simulation<Solver>::execute_step()
-{
-    return false;
-} // execute_steps()
-
-/* ------------------------------------------------------------------- */
-
-template <typename Solver>
-void Simulation<Solver>::write_error_message(std::string s)
+template <typename Derived>
+void Simulation<Derived>::write_error_message(std::string s)
 {
     char char_array[s.length() + 1];
     strcpy(char_array, s.c_str());
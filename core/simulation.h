@@ -8,13 +8,13 @@ See the README file in the top-level RNMC directory.
 #ifndef RNMC_SIMULATION_H
 #define RNMC_SIMULATION_H
 
-#include <functional>
 #include <csignal>
 #include <set>
 #include <atomic>
 #include <unistd.h>
 #include <string>
 #include <cstring>
+#include <limits>
 
 #include "../GMC/tree_solver.h"
 
@@ -30,7 +30,12 @@ static_assert(std::atomic<bool>::is_always_lock_free);
 
 /* ------------------------------------------------------------------- */
 
-template <typename Solver>
+// Simulation is a CRTP base: each simulator derives from
+// Simulation<itself> and provides bool execute_step(). The loops below
+// call execute_step through a static cast, so the model and solver types
+// are known at compile time and the whole step can be inlined into the
+// loop instead of going through a virtual call.
+template <typename Derived>
 class Simulation
 {
 public:
@@ -38,7 +43,10 @@ public:
     double time;
     int step; // number of reactions which have occoured
     unsigned long int history_chunk_size;
-    std::function<void(Update)> update_function;
+
+    // set by execute_time, for simulations which advance time in
+    // leaps and shouldn't leap past it
+    double time_cutoff;
 
     Simulation(unsigned long int seed,
                int history_chunk_size,
@@ -46,12 +54,15 @@ public:
                double time) : seed(seed),
                               time(time),
                               step(step),
-                              history_chunk_size(history_chunk_size) {};
+                              history_chunk_size(history_chunk_size),
+                              time_cutoff(std::numeric_limits<double>::infinity()) {};
 
     void execute_steps(int step_cutoff);
     void execute_time(double time_cutoff);
-    virtual bool execute_step();
     void write_error_message(std::string s);
+
+private:
+    Derived &derived() { return static_cast<Derived &>(*this); };
 };
 
 #include "simulation.cpp"
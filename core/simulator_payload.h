@@ -17,10 +17,11 @@ See the README file in the top-level RNMC directory.
     if you make this too small, it will force the dispatcher to
     perform lots of really small DB transactions which is bad.
     20000 is a good value. Only change this if you fully understand the
-    performance implications
+    performance implications. It can be overridden at runtime with
+    --history_chunk_size
 ---------------------------------------------------------------------- */
 
-constexpr int history_chunk_size = 20000;
+constexpr unsigned long int default_history_chunk_size = 20000;
 
 template <
     typename Solver,
@@ -41,10 +42,11 @@ public:
     HistoryQueue<HistoryPacket<CutoffHistory>> &cutoff_history_queue;
     SeedQueue &seed_queue;
     Cutoff cutoff;
-    std::vector<bool>::iterator running;
-    std::map<int, State> seed_state_map;
-    std::map<int, int> seed_step_map;
-    std::map<int, double> seed_time_map;
+    unsigned long int history_chunk_size;
+    std::vector<std::atomic<bool>>::iterator running;
+    SeedStateStore<State> &seed_state_store;
+    const std::map<int, int> &seed_step_map;
+    const std::map<int, double> &seed_time_map;
 
     SimulatorPayload(
         Model &model,
@@ -53,17 +55,19 @@ public:
         HistoryQueue<HistoryPacket<CutoffHistory>> &cutoff_history_queue,
         SeedQueue &seed_queue,
         Cutoff cutoff,
-        std::vector<bool>::iterator running,
-        std::map<int, State> seed_state_map,
-        std::map<int, int> seed_step_map,
-        std::map<int, double> seed_time_map) : model(model),
+        unsigned long int history_chunk_size,
+        std::vector<std::atomic<bool>>::iterator running,
+        SeedStateStore<State> &seed_state_store,
+        const std::map<int, int> &seed_step_map,
+        const std::map<int, double> &seed_time_map) : model(model),
                                                history_queue(history_queue),
                                                state_history_queue(state_history_queue),
                                                cutoff_history_queue(cutoff_history_queue),
                                                seed_queue(seed_queue),
                                                cutoff(cutoff),
+                                               history_chunk_size(history_chunk_size),
                                                running(running),
-                                               seed_state_map(std::move(seed_state_map)),
+                                               seed_state_store(seed_state_store),
                                                seed_step_map(seed_step_map),
                                                seed_time_map(seed_time_map) {};
 
@@ -75,10 +79,13 @@ public:
         {
 
             unsigned long int seed = maybe_seed.value();
-            int step = seed_step_map[seed];
-            double time = seed_time_map[seed];
+            // seeds which aren't resuming from a checkpoint start at 0
+            auto step_it = seed_step_map.find(seed);
+            int step = step_it == seed_step_map.end() ? 0 : step_it->second;
+            auto time_it = seed_time_map.find(seed);
+            double time = time_it == seed_time_map.end() ? 0.0 : time_it->second;
 
-            Sim simulation(model, seed, step, time, seed_state_map[seed],
+            Sim simulation(model, seed, step, time, seed_state_store.take(seed),
                            history_chunk_size, history_queue);
             simulation.init();
 
@@ -127,6 +134,7 @@ public:
         }
 
         *running = false;
+        history_queue.notify_consumer();
     };
 };
 
@@ -0,0 +1,211 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include "slow_scale_simulation.h"
+#include "../GMC/reaction_network.h"
+
+template <typename Solver>
+double SlowScaleSimulation<Solver>::mean_count(int species_id)
+{
+    const FastPairs &pairs = reaction_network.fast_pairs;
+    int pair = pairs.pair_of_species[species_id];
+    if (pair < 0)
+        return state[species_id];
+
+    double total = state[pairs.first[pair]] + state[pairs.second[pair]];
+    double fraction = pairs.first_fraction[pair];
+    return total * (species_id == pairs.first[pair] ? fraction : 1.0 - fraction);
+} // mean_count()
+
+/* ------------------------------------------------------------------- */
+
+// GillespieReactionNetwork::compute_propensity averaged over the
+// equilibrium of the pairs. The species counts of different pairs are
+// independent. Within a pair the count of A is binomial, so
+// E[n_A (n_A - 1)] = N (N - 1) p_A^2 and E[n_A n_B] = N (N - 1) p_A p_B,
+// where N is the total count of the pair.
+template <typename Solver>
+double SlowScaleSimulation<Solver>::expected_propensity(int reaction_index)
+{
+    const FastPairs &pairs = reaction_network.fast_pairs;
+    const ReactionArrays<GillespieReaction> &reactions = reaction_network.reactions;
+
+    int number_of_reactants = reactions.number_of_reactants[reaction_index];
+    const SpeciesIndex *reactants = &reactions.reactants[2 * reaction_index];
+    double rate = reactions.rate[reaction_index];
+
+    if (number_of_reactants == 0)
+        return reaction_network.factor_zero * rate;
+
+    if (number_of_reactants == 1)
+        return mean_count(reactants[0]) * rate;
+
+    int pair = pairs.pair_of_species[reactants[0]];
+    if (pair < 0 || pair != pairs.pair_of_species[reactants[1]])
+    {
+        if (reactants[0] == reactants[1])
+        {
+            double count = state[reactants[0]];
+            return reaction_network.factor_duplicate * reaction_network.factor_two *
+                   count * (count - 1) * rate;
+        }
+
+        return reaction_network.factor_two * mean_count(reactants[0]) *
+               mean_count(reactants[1]) * rate;
+    }
+
+    // both reactants in the same pair
+    double total = state[pairs.first[pair]] + state[pairs.second[pair]];
+    if (total < 2)
+        return 0.0;
+
+    double mean_product = (mean_count(reactants[0]) / total) *
+                          (mean_count(reactants[1]) / total) *
+                          total * (total - 1);
+
+    if (reactants[0] == reactants[1])
+        return reaction_network.factor_duplicate * reaction_network.factor_two *
+               mean_product * rate;
+    else
+        return reaction_network.factor_two * mean_product * rate;
+} // expected_propensity()
+
+/* ------------------------------------------------------------------- */
+
+template <typename Solver>
+void SlowScaleSimulation<Solver>::resample_pair(int pair)
+{
+    const FastPairs &pairs = reaction_network.fast_pairs;
+    int first = pairs.first[pair];
+    int second = pairs.second[pair];
+
+    // a slow reaction can take a molecule from a species whose sampled
+    // count is 0, but the total of the pair never goes negative
+    int total = state[first] + state[second];
+    state[first] = sampler.binomial(pairs.first_fraction[pair], total);
+    state[second] = total - state[first];
+} // resample_pair()
+
+/* ------------------------------------------------------------------- */
+
+template <typename Solver>
+void SlowScaleSimulation<Solver>::init()
+{
+    const FastPairs &pairs = reaction_network.fast_pairs;
+
+    // the fast reactions relax the initial state straight away
+    for (unsigned long int pair = 0; pair < pairs.size(); pair++)
+        resample_pair(pair);
+
+    unsigned long int number_of_reactions = reaction_network.reactions.size();
+    std::vector<double> initial_propensities_temp(number_of_reactions, 0.0);
+    for (unsigned long int i = 0; i < number_of_reactions; i++)
+        if (!pairs.fast_reaction[i])
+            initial_propensities_temp[i] = expected_propensity(i);
+
+    solver = Solver(sampler_seed(this->seed, this->step), std::ref(initial_propensities_temp));
+    dirty.assign(number_of_reactions, false);
+} // init()
+
+/* ------------------------------------------------------------------- */
+
+template <typename Solver>
+bool SlowScaleSimulation<Solver>::execute_step()
+{
+    std::optional<Event> maybe_event = solver.event();
+
+    if (!maybe_event)
+    {
+
+        return false;
+    }
+    else
+    {
+        // a slow event happens
+        Event event = maybe_event.value();
+        int next_reaction = event.index;
+
+        // update time
+        this->time += event.dt;
+
+        // record what happened
+        history.push_back(ReactionNetworkTrajectoryHistoryElement{
+            .seed = this->seed,
+            .reaction_id = next_reaction,
+            .time = this->time,
+            .step = this->step});
+
+        if (history.size() == this->history_chunk_size)
+        {
+            history_queue.insert_history(
+                std::move(
+                    HistoryPacket<ReactionNetworkTrajectoryHistoryElement>{
+                        .seed = this->seed,
+                        .history = std::move(this->history)}));
+
+            history = std::vector<ReactionNetworkTrajectoryHistoryElement>();
+            history.reserve(this->history_chunk_size);
+        }
+
+        // increment step
+        this->step++;
+
+        // update state, then bring the pairs it touched back to
+        // equilibrium
+        reaction_network.update_state(std::ref(state), next_reaction);
+
+        const FastPairs &pairs = reaction_network.fast_pairs;
+        int species[4];
+        int number_of_species = reaction_network.changed_species(next_reaction, species);
+
+        touched_pairs.clear();
+        for (int k = 0; k < number_of_species; k++)
+        {
+            int pair = pairs.pair_of_species[species[k]];
+            if (pair >= 0 &&
+                std::find(touched_pairs.begin(), touched_pairs.end(), pair) == touched_pairs.end())
+                touched_pairs.push_back(pair);
+        }
+
+        for (int pair : touched_pairs)
+            resample_pair(pair);
+
+        // a change in the total of a pair changes the expected counts of
+        // both its species
+        updates.clear();
+        auto update_dependents = [&](int species_id)
+        {
+            for (int dependent : reaction_network.dependents[species_id])
+            {
+                if (dirty[dependent] || pairs.fast_reaction[dependent])
+                    continue;
+
+                dirty[dependent] = true;
+                updates.push_back(Update{
+                    .index = (unsigned long int)dependent,
+                    .propensity = expected_propensity(dependent)});
+            }
+        };
+
+        for (int k = 0; k < number_of_species; k++)
+            if (pairs.pair_of_species[species[k]] < 0)
+                update_dependents(species[k]);
+
+        for (int pair : touched_pairs)
+        {
+            update_dependents(pairs.first[pair]);
+            update_dependents(pairs.second[pair]);
+        }
+
+        for (Update update : updates)
+            dirty[update.index] = false;
+
+        solver.update(updates);
+
+        return true;
+    }
+} // execute_step()
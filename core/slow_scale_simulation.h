@@ -0,0 +1,70 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_SLOW_SCALE_SIMULATION_H
+#define RNMC_SLOW_SCALE_SIMULATION_H
+
+#include "../GMC/gillespie_reaction_network.h"
+#include "sampler.h"
+#include "simulation.h"
+
+// a GMC simulation which treats the fast reversible pairs of the
+// reaction network (see fast_pairs.h) as always at equilibrium. The
+// fast reactions never fire. The solver only sees the slow reactions,
+// with propensities averaged over the equilibrium of the pairs. After
+// every slow event, the split of each pair it touched between its two
+// species is drawn again from the equilibrium, so state is always a
+// sample of the species counts.
+//
+// history only records slow events, and step counts them. The reaction
+// network must have computed its fast pairs before any simulation is
+// constructed.
+template <typename Solver>
+class SlowScaleSimulation : public Simulation<SlowScaleSimulation<Solver>>
+{
+private:
+    Solver solver;
+    Sampler sampler;             // pairs draw from their own stream
+    std::vector<Update> updates; // propensity updates for the current step
+    std::vector<bool> dirty;
+    std::vector<int> touched_pairs;
+
+    // expected count of a species over the equilibrium of its pair
+    double mean_count(int species_id);
+    double expected_propensity(int reaction_index);
+    void resample_pair(int pair);
+
+public:
+    GillespieReactionNetwork &reaction_network;
+    std::vector<int> state;
+    std::vector<ReactionNetworkTrajectoryHistoryElement> history;
+    HistoryQueue<HistoryPacket<ReactionNetworkTrajectoryHistoryElement>> &history_queue;
+
+    SlowScaleSimulation(GillespieReactionNetwork &reaction_network,
+                        unsigned long int seed,
+                        int step,
+                        double time,
+                        std::vector<int> state,
+                        int history_chunk_size,
+                        HistoryQueue<HistoryPacket<ReactionNetworkTrajectoryHistoryElement>> &history_queue) : // call base class constructor
+                                                                                                               Simulation<SlowScaleSimulation<Solver>>(seed, history_chunk_size, step, time),
+                                                                                                               // the complement keeps the stream apart from the solver's
+                                                                                                               sampler(Sampler(sampler_seed(~seed, step))),
+                                                                                                               reaction_network(reaction_network),
+                                                                                                               state(std::move(state)),
+                                                                                                               history_queue(history_queue)
+    {
+        history.reserve(this->history_chunk_size);
+    };
+
+    void init();
+    bool execute_step();
+};
+
+#include "slow_scale_simulation.cpp"
+
+#endif
@@ -36,6 +36,18 @@ public:
     };
 };
 
+// values accepted by PRAGMA journal_mode and PRAGMA synchronous
+inline bool is_journal_mode(std::string mode)
+{
+    return mode == "delete" || mode == "truncate" || mode == "persist" ||
+           mode == "memory" || mode == "wal" || mode == "off";
+}
+
+inline bool is_synchronous_mode(std::string mode)
+{
+    return mode == "off" || mode == "normal" || mode == "full" || mode == "extra";
+}
+
 class SqlConnection
 {
 public:
@@ -130,11 +142,15 @@ public:
     void reset() { sqlite3_reset(stmt); };
     int step() { return sqlite3_step(stmt); };
 
-    SqlStatement(SqlConnection &sql_connection) : sql_connection(sql_connection)
+    SqlStatement(SqlConnection &sql_connection) : SqlStatement(sql_connection, T::sql_statement) {};
+
+    // prepare a variant of T::sql_statement, for example one restricted
+    // to a range of rows. It must return the columns T::action expects.
+    SqlStatement(SqlConnection &sql_connection, const std::string &sql_statement) : sql_connection(sql_connection)
     {
         int rc = sqlite3_prepare_v2(
             sql_connection.connection,
-            T::sql_statement.c_str(),
+            sql_statement.c_str(),
             -1,
             &stmt,
             nullptr);
@@ -0,0 +1,395 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include <limits>
+#include <algorithm>
+
+#include "tau_leaping_simulation.h"
+#include "../GMC/reaction_network.h"
+
+template <typename Solver>
+void TauLeapingSimulation<Solver>::init()
+{
+    if (state == reaction_network.initial_state &&
+        reaction_network.initial_state_propensities.size() == reaction_network.reactions.size())
+        solver = Solver(sampler_seed(this->seed, this->step), std::ref(reaction_network.initial_state_propensities));
+    else
+    {
+        std::vector<double> initial_propensities_temp;
+        reaction_network.compute_initial_propensities(state, initial_propensities_temp);
+        solver = Solver(sampler_seed(this->seed, this->step), std::ref(initial_propensities_temp));
+    }
+
+    unsigned long int number_of_reactions = reaction_network.reactions.size();
+    unsigned long int number_of_species = state.size();
+
+    propensities.resize(number_of_reactions);
+    critical.resize(number_of_reactions);
+    firings.resize(number_of_reactions);
+    dirty.assign(number_of_reactions, false);
+    mean_change.assign(number_of_species, 0.0);
+    variance_change.assign(number_of_species, 0.0);
+    bounded.assign(number_of_species, false);
+    touched.assign(number_of_species, false);
+
+    exact_steps_remaining = 0;
+} // init()
+
+/* ------------------------------------------------------------------- */
+
+template <typename Solver>
+int TauLeapingSimulation<Solver>::stoichiometry(int reaction_index,
+                                                int species[4],
+                                                int change[4])
+{
+    int number_of_species = 0;
+    auto add = [&](int species_id, int delta)
+    {
+        for (int k = 0; k < number_of_species; k++)
+        {
+            if (species[k] == species_id)
+            {
+                change[k] += delta;
+                return;
+            }
+        }
+        species[number_of_species] = species_id;
+        change[number_of_species] = delta;
+        number_of_species++;
+    };
+
+    const ReactionArrays<GillespieReaction> &reactions = reaction_network.reactions;
+    for (int k = 0; k < reactions.number_of_reactants[reaction_index]; k++)
+        add(reactions.reactants[2 * reaction_index + k], -1);
+    for (int k = 0; k < reactions.number_of_products[reaction_index]; k++)
+        add(reactions.products[2 * reaction_index + k], 1);
+
+    // drop species which are given back, like catalysts
+    int kept = 0;
+    for (int k = 0; k < number_of_species; k++)
+    {
+        if (change[k] != 0)
+        {
+            species[kept] = species[k];
+            change[kept] = change[k];
+            kept++;
+        }
+    }
+
+    return kept;
+} // stoichiometry()
+
+/* ------------------------------------------------------------------- */
+
+template <typename Solver>
+void TauLeapingSimulation<Solver>::record(int reaction_index, int count)
+{
+    history.push_back(ReactionNetworkLeapHistoryElement{
+        .seed = this->seed,
+        .reaction_id = reaction_index,
+        .count = count,
+        .time = this->time,
+        .step = this->step});
+
+    this->step += count;
+
+    if (history.size() >= this->history_chunk_size)
+    {
+        history_queue.insert_history(
+            std::move(
+                HistoryPacket<ReactionNetworkLeapHistoryElement>{
+                    .seed = this->seed,
+                    .history = std::move(this->history)}));
+
+        history = std::vector<ReactionNetworkLeapHistoryElement>();
+        history.reserve(this->history_chunk_size);
+    }
+} // record()
+
+/* ------------------------------------------------------------------- */
+
+// returns the largest leap which keeps the expected relative change of
+// every propensity below epsilon and stays inside the time cutoff, or 0
+// if leaping isn't worthwhile.
+// Also marks the critical reactions and copies the propensities out of
+// the solver.
+template <typename Solver>
+double TauLeapingSimulation<Solver>::select_tau()
+{
+    unsigned long int number_of_reactions = propensities.size();
+    double epsilon = reaction_network.tau_leaping_epsilon;
+    const ReactionArrays<GillespieReaction> &reactions = reaction_network.reactions;
+
+    for (int species_id : touched_species)
+    {
+        mean_change[species_id] = 0.0;
+        variance_change[species_id] = 0.0;
+        bounded[species_id] = false;
+        touched[species_id] = false;
+    }
+    touched_species.clear();
+
+    auto touch = [&](int species_id)
+    {
+        if (!touched[species_id])
+        {
+            touched[species_id] = true;
+            touched_species.push_back(species_id);
+        }
+    };
+
+    double propensity_sum = 0.0;
+    for (unsigned long int i = 0; i < number_of_reactions; i++)
+    {
+        double propensity = solver.get_propensity(i);
+        propensities[i] = propensity;
+        propensity_sum += propensity;
+        critical[i] = false;
+
+        if (propensity <= 0.0)
+            continue;
+
+        int species[4];
+        int change[4];
+        int number_of_species = stoichiometry(i, species, change);
+
+        // how many times the reaction can fire before a reactant runs out
+        int firings_left = std::numeric_limits<int>::max();
+        for (int k = 0; k < number_of_species; k++)
+            if (change[k] < 0)
+                firings_left = std::min(firings_left, state[species[k]] / -change[k]);
+
+        if (firings_left < tau_leaping_critical_firings)
+        {
+            critical[i] = true;
+            continue;
+        }
+
+        for (int k = 0; k < number_of_species; k++)
+        {
+            touch(species[k]);
+            mean_change[species[k]] += change[k] * propensity;
+            variance_change[species[k]] += change[k] * change[k] * propensity;
+        }
+
+        for (int k = 0; k < reactions.number_of_reactants[i]; k++)
+        {
+            int species_id = reactions.reactants[2 * i + k];
+            touch(species_id);
+            bounded[species_id] = true;
+        }
+    }
+
+    if (propensity_sum <= 0.0)
+        return 0.0;
+
+    double tau = std::numeric_limits<double>::infinity();
+    for (int species_id : touched_species)
+    {
+        if (!bounded[species_id])
+            continue;
+
+        // the relative change in propensity caused by a unit change in
+        // the species is at most g / count
+        double count = state[species_id];
+        double g;
+        switch (reaction_network.highest_reactant_order[species_id])
+        {
+        case 1:
+            g = 1.0;
+            break;
+        case 2:
+            g = 2.0;
+            break;
+        default:
+            g = count > 1.0 ? 2.0 + 1.0 / (count - 1.0) : 3.0;
+            break;
+        }
+
+        double bound = std::max(epsilon * count / g, 1.0);
+        if (mean_change[species_id] != 0.0)
+            tau = std::min(tau, bound / std::abs(mean_change[species_id]));
+        if (variance_change[species_id] > 0.0)
+            tau = std::min(tau, bound * bound / variance_change[species_id]);
+    }
+
+    // don't leap past a time cutoff
+    tau = std::min(tau, this->time_cutoff - this->time);
+
+    // no non critical reactions, or a leap shorter than a few exact steps
+    if (std::isinf(tau) || tau < tau_leaping_min_steps / propensity_sum)
+        return 0.0;
+
+    return tau;
+} // select_tau()
+
+/* ------------------------------------------------------------------- */
+
+template <typename Solver>
+bool TauLeapingSimulation<Solver>::leap(double non_critical_tau)
+{
+    unsigned long int number_of_reactions = propensities.size();
+
+    double critical_propensity_sum = 0.0;
+    for (unsigned long int i = 0; i < number_of_reactions; i++)
+        if (critical[i])
+            critical_propensity_sum += propensities[i];
+
+    double tau;
+    while (true)
+    {
+        // time to the next critical reaction
+        double critical_tau = std::numeric_limits<double>::infinity();
+        if (critical_propensity_sum > 0.0)
+            critical_tau = sampler.exponential() / critical_propensity_sum;
+
+        tau = std::min(non_critical_tau, critical_tau);
+        fired_reactions.clear();
+        leap_state = state;
+        bool negative = false;
+
+        auto fire = [&](int reaction_index, int count)
+        {
+            firings[reaction_index] = count;
+            fired_reactions.push_back(reaction_index);
+
+            int species[4];
+            int change[4];
+            int number_of_species = stoichiometry(reaction_index, species, change);
+            for (int k = 0; k < number_of_species; k++)
+            {
+                leap_state[species[k]] += count * change[k];
+                if (leap_state[species[k]] < 0)
+                    negative = true;
+            }
+        };
+
+        if (critical_tau <= non_critical_tau)
+        {
+            double fraction = critical_propensity_sum * sampler.generate();
+            double partial = 0.0;
+            unsigned long int chosen = number_of_reactions;
+            for (unsigned long int i = 0; i < number_of_reactions; i++)
+            {
+                if (!critical[i])
+                    continue;
+
+                chosen = i;
+                partial += propensities[i];
+                if (partial > fraction)
+                    break;
+            }
+            fire(chosen, 1);
+        }
+
+        for (unsigned long int i = 0; i < number_of_reactions; i++)
+        {
+            if (critical[i] || propensities[i] <= 0.0)
+                continue;
+
+            int count = sampler.poisson(propensities[i] * tau);
+            if (count > 0)
+                fire(i, count);
+        }
+
+        if (!negative)
+            break;
+
+        // a non critical reaction overdrew a species, so try again with
+        // a shorter leap
+        non_critical_tau /= 2.0;
+    }
+
+    std::sort(fired_reactions.begin(), fired_reactions.end());
+    std::swap(state, leap_state);
+    this->time += tau;
+
+    for (int reaction_index : fired_reactions)
+        record(reaction_index, firings[reaction_index]);
+
+    // recompute the propensities of every reaction depending on a
+    // species which changed
+    updates.clear();
+    for (int reaction_index : fired_reactions)
+    {
+        int species[4];
+        int change[4];
+        int number_of_species = stoichiometry(reaction_index, species, change);
+        for (int k = 0; k < number_of_species; k++)
+        {
+            for (int dependent : reaction_network.dependents[species[k]])
+            {
+                if (dirty[dependent])
+                    continue;
+
+                dirty[dependent] = true;
+                updates.push_back(Update{
+                    .index = (unsigned long int)dependent,
+                    .propensity = reaction_network.compute_propensity(state, dependent)});
+            }
+        }
+    }
+
+    for (Update update : updates)
+        dirty[update.index] = false;
+
+    solver.update(updates);
+
+    return true;
+} // leap()
+
+/* ------------------------------------------------------------------- */
+
+template <typename Solver>
+bool TauLeapingSimulation<Solver>::exact_step()
+{
+    std::optional<Event> maybe_event = solver.event();
+
+    if (!maybe_event)
+        return false;
+
+    Event event = maybe_event.value();
+    int next_reaction = event.index;
+
+    this->time += event.dt;
+    record(next_reaction, 1);
+
+    reaction_network.update_state(std::ref(state), next_reaction);
+
+    updates.clear();
+    reaction_network.update_propensities(
+        updates,
+        std::ref(state),
+        next_reaction);
+
+    solver.update(updates);
+
+    return true;
+} // exact_step()
+
+/* ------------------------------------------------------------------- */
+
+template <typename Solver>
+bool TauLeapingSimulation<Solver>::execute_step()
+{
+    if (exact_steps_remaining > 0)
+    {
+        exact_steps_remaining--;
+        return exact_step();
+    }
+
+    double tau = select_tau();
+    if (tau == 0.0)
+    {
+        // populations are small, so run a batch of exact steps before
+        // looking at leaping again
+        exact_steps_remaining = tau_leaping_exact_steps - 1;
+        return exact_step();
+    }
+
+    return leap(tau);
+} // execute_step()
@@ -0,0 +1,98 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_TAU_LEAPING_SIMULATION_H
+#define RNMC_TAU_LEAPING_SIMULATION_H
+
+#include "../GMC/gillespie_reaction_network.h"
+#include "sampler.h"
+#include "simulation.h"
+
+// a GMC simulation which leaps over many reactions at once. The leap
+// size is chosen as in Cao, Gillespie and Petzold, J. Chem. Phys. 124,
+// 044109 (2006): the expected relative change of every propensity over
+// the leap is bounded by the epsilon of the reaction network, and each
+// non critical reaction fires a poisson distributed number of times.
+// Reactions which are within tau_leaping_critical_firings firings of
+// exhausting a reactant are critical, and at most one critical reaction
+// fires per leap.
+//
+// when the leap would be shorter than a few exact steps, which happens
+// when populations are small, the simulation instead runs
+// tau_leaping_exact_steps steps with the solver before trying again.
+//
+// history records each reaction fired in a leap once with its count,
+// so step counts firings rather than iterations. Leaps stop at a time
+// cutoff, but can overshoot a step cutoff.
+constexpr int tau_leaping_critical_firings = 10;
+
+// a leap must be worth at least this many exact steps
+constexpr double tau_leaping_min_steps = 10.0;
+
+constexpr int tau_leaping_exact_steps = 100;
+
+template <typename Solver>
+class TauLeapingSimulation : public Simulation<TauLeapingSimulation<Solver>>
+{
+private:
+    Solver solver;
+    Sampler sampler;              // leaps draw from their own stream
+    std::vector<Update> updates;  // propensity updates for the current step
+    int exact_steps_remaining;
+
+    // scratch space for leaps
+    std::vector<double> propensities;
+    std::vector<bool> critical;
+    std::vector<double> mean_change;     // expected change of each species per unit time
+    std::vector<double> variance_change; // and its variance
+    std::vector<bool> bounded;           // reactant of a non critical reaction
+    std::vector<bool> touched;
+    std::vector<int> touched_species;
+    std::vector<int> firings;
+    std::vector<int> fired_reactions;
+    std::vector<int> leap_state;
+    std::vector<bool> dirty;
+
+    // the species whose counts change when a reaction fires and by how
+    // much. Returns how many were written.
+    int stoichiometry(int reaction_index, int species[4], int change[4]);
+
+    void record(int reaction_index, int count);
+    double select_tau();
+    bool leap(double tau);
+    bool exact_step();
+
+public:
+    GillespieReactionNetwork &reaction_network;
+    std::vector<int> state;
+    std::vector<ReactionNetworkLeapHistoryElement> history;
+    HistoryQueue<HistoryPacket<ReactionNetworkLeapHistoryElement>> &history_queue;
+
+    TauLeapingSimulation(GillespieReactionNetwork &reaction_network,
+                         unsigned long int seed,
+                         int step,
+                         double time,
+                         std::vector<int> state,
+                         int history_chunk_size,
+                         HistoryQueue<HistoryPacket<ReactionNetworkLeapHistoryElement>> &history_queue) : // call base class constructor
+                                                                                                          Simulation<TauLeapingSimulation<Solver>>(seed, history_chunk_size, step, time),
+                                                                                                          // the complement keeps the stream apart from the solver's
+                                                                                                          sampler(Sampler(sampler_seed(~seed, step))),
+                                                                                                          reaction_network(reaction_network),
+                                                                                                          state(std::move(state)),
+                                                                                                          history_queue(history_queue)
+    {
+        history.reserve(this->history_chunk_size);
+    };
+
+    void init();
+    bool execute_step();
+};
+
+#include "tau_leaping_simulation.cpp"
+
+#endif
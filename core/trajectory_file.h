@@ -0,0 +1,483 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#ifndef RNMC_TRAJECTORY_FILE_H
+#define RNMC_TRAJECTORY_FILE_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <optional>
+#include <iostream>
+#include <sys/stat.h>
+
+#include "sql.h"
+#include "RNMC_types.h"
+
+// binary trajectory files, written instead of the trajectories table
+// with --output_format=binary. The full layout is described in
+// trajectory_format.md. In short, every seed gets its own append-only
+// file <seed>.trajectory holding a header followed by one block per
+// history packet. Inside a block the records are stored column by
+// column: steps as varint deltas, times as bit packed differences of
+// consecutive bit patterns (see append_times), and the model specific
+// integer columns as zigzag varints. Every block starts from scratch,
+// so a file resumed from a checkpoint is just more blocks appended to
+// the end.
+//
+// the integer columns come from the WriteTrajectoriesSql type of the
+// model, which provides step, time, number_of_binary_columns,
+// binary_column_names and binary_columns(row, columns).
+
+constexpr char trajectory_file_magic[8] = {'R', 'N', 'M', 'C', 'T', 'R', 'J', '2'};
+constexpr int max_binary_columns = 8;
+
+/* ------------------------------------------------------------------- */
+
+inline void append_varint(std::vector<uint8_t> &buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((uint8_t)value);
+} // append_varint()
+
+/* ------------------------------------------------------------------- */
+
+// returns false if the varint runs past end
+inline bool read_varint(const uint8_t *&position, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && position < end; shift += 7)
+    {
+        uint8_t byte = *position++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+} // read_varint()
+
+/* ------------------------------------------------------------------- */
+
+inline uint64_t zigzag_encode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+} // zigzag_encode()
+
+inline int64_t zigzag_decode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+} // zigzag_decode()
+
+/* ------------------------------------------------------------------- */
+
+inline uint64_t double_bits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+} // double_bits()
+
+inline double bits_double(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+} // bits_double()
+
+/* ------------------------------------------------------------------- */
+
+inline void append_fixed(std::vector<uint8_t> &buffer, uint64_t value, int bytes)
+{
+    // fixed width header fields are little endian
+    for (int i = 0; i < bytes; i++)
+        buffer.push_back((uint8_t)(value >> (8 * i)));
+} // append_fixed()
+
+inline uint64_t read_fixed(const uint8_t *position, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)position[i] << (8 * i);
+    return value;
+} // read_fixed()
+
+/* ------------------------------------------------------------------- */
+
+// bits are written most significant first. finish pads the last byte
+// with zeros.
+class BitWriter
+{
+public:
+    std::vector<uint8_t> &buffer;
+    uint64_t pending;
+    int pending_bits; // always less than 8 between calls
+
+    BitWriter(std::vector<uint8_t> &buffer) : buffer(buffer), pending(0), pending_bits(0) {};
+
+    void write(uint64_t value, int bits)
+    {
+        if (bits > 32)
+        {
+            write(value >> 32, bits - 32);
+            bits = 32;
+        }
+
+        pending = (pending << bits) | (value & ((1ul << bits) - 1));
+        pending_bits += bits;
+        while (pending_bits >= 8)
+        {
+            pending_bits -= 8;
+            buffer.push_back((uint8_t)(pending >> pending_bits));
+        }
+        pending &= (1ul << pending_bits) - 1;
+    };
+
+    void finish()
+    {
+        if (pending_bits > 0)
+            buffer.push_back((uint8_t)(pending << (8 - pending_bits)));
+        pending = 0;
+        pending_bits = 0;
+    };
+};
+
+// reads what BitWriter wrote, starting at position and never past end.
+// The padding of the last byte is skipped along with it.
+class BitReader
+{
+public:
+    const uint8_t *&position;
+    const uint8_t *end;
+    uint64_t pending;
+    int pending_bits;
+
+    BitReader(const uint8_t *&position, const uint8_t *end) : position(position),
+                                                              end(end),
+                                                              pending(0),
+                                                              pending_bits(0) {};
+
+    // returns false if the bits run past end
+    bool read(int bits, uint64_t &value)
+    {
+        if (bits > 32)
+        {
+            uint64_t high;
+            if (!read(bits - 32, high) || !read(32, value))
+                return false;
+            value |= high << 32;
+            return true;
+        }
+
+        while (pending_bits < bits)
+        {
+            if (position == end)
+                return false;
+            pending = (pending << 8) | *position++;
+            pending_bits += 8;
+        }
+
+        pending_bits -= bits;
+        value = (pending >> pending_bits) & ((1ul << bits) - 1);
+        pending &= (1ul << pending_bits) - 1;
+        return true;
+    };
+};
+
+/* ------------------------------------------------------------------- */
+
+// the times of a block are stored as the zigzag difference of the bit
+// patterns of consecutive times, which for increasing times is the
+// number of doubles between them. Each difference is written in width
+// bits, behind a 0 bit, while it fits and is no more than
+// time_width_slack bits narrower than width. Otherwise a 1 bit and the
+// new width in time_width_bits bits come first. The column is padded
+// to a whole byte.
+//
+// the low bits of the times are as random as the waiting times they
+// are summed from, so this only drops the high bits consecutive times
+// share. It saves the varint's continuation bits and the high bits
+// which an XOR of the bit patterns keeps when a carry runs into them.
+constexpr int time_width_bits = 7;
+constexpr int time_width_slack = 3;
+
+inline void append_times(std::vector<uint8_t> &buffer, const std::vector<double> &times)
+{
+    BitWriter writer(buffer);
+    uint64_t previous_bits = 0;
+    int width = 0;
+
+    for (double time : times)
+    {
+        uint64_t bits = double_bits(time);
+        uint64_t difference = zigzag_encode((int64_t)(bits - previous_bits));
+        previous_bits = bits;
+
+        int length = difference == 0 ? 0 : 64 - __builtin_clzll(difference);
+        if (length <= width && width - length <= time_width_slack)
+            writer.write(0, 1);
+        else
+        {
+            writer.write(1, 1);
+            writer.write(length, time_width_bits);
+            width = length;
+        }
+        writer.write(difference, width);
+    }
+
+    writer.finish();
+} // append_times()
+
+// reads times.size() times. Returns false if the column runs past end.
+inline bool read_times(const uint8_t *&position, const uint8_t *end,
+                       std::vector<double> &times)
+{
+    BitReader reader(position, end);
+    uint64_t previous_bits = 0;
+    int width = 0;
+    uint64_t value;
+
+    for (double &time : times)
+    {
+        if (!reader.read(1, value))
+            return false;
+
+        if (value == 1)
+        {
+            if (!reader.read(time_width_bits, value) || value > 64)
+                return false;
+            width = value;
+        }
+
+        if (!reader.read(width, value))
+            return false;
+
+        previous_bits += (uint64_t)zigzag_decode(value);
+        time = bits_double(previous_bits);
+    }
+
+    return true;
+} // read_times()
+
+/* ------------------------------------------------------------------- */
+
+class TrajectoryFileWriter
+{
+public:
+    std::string directory;
+    std::vector<uint8_t> block;   // reused between packets
+    std::vector<uint8_t> columns; // the encoded columns of the current block
+    std::vector<int> values;      // the columns of every row, row major
+    std::vector<double> times;
+
+    TrajectoryFileWriter() {};
+
+    TrajectoryFileWriter(std::string directory) : directory(directory)
+    {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            std::cerr << time::time_stamp()
+                      << "could not create trajectory directory "
+                      << directory << '\n';
+            std::abort();
+        }
+    };
+
+    std::string file_path(unsigned long int seed)
+    {
+        return directory + "/" + std::to_string(seed) + ".trajectory";
+    };
+
+    template <typename WriteTrajectoriesSql>
+    void write(unsigned long int seed, std::vector<WriteTrajectoriesSql> &rows)
+    {
+        static_assert(WriteTrajectoriesSql::number_of_binary_columns <= max_binary_columns);
+        constexpr int number_of_columns = WriteTrajectoriesSql::number_of_binary_columns;
+
+        if (rows.empty())
+            return;
+
+        std::string path = file_path(seed);
+        FILE *file = std::fopen(path.c_str(), "ab");
+        if (!file)
+        {
+            std::cerr << time::time_stamp()
+                      << "could not open trajectory file " << path << '\n';
+            std::abort();
+        }
+
+        block.clear();
+
+        // a new file starts with the header
+        std::fseek(file, 0, SEEK_END);
+        if (std::ftell(file) == 0)
+        {
+            const std::string &names = WriteTrajectoriesSql::binary_column_names;
+            block.insert(block.end(), trajectory_file_magic, trajectory_file_magic + 8);
+            append_fixed(block, seed, 8);
+            append_fixed(block, number_of_columns, 4);
+            append_fixed(block, names.size(), 4);
+            block.insert(block.end(), names.begin(), names.end());
+        }
+
+        columns.clear();
+
+        int64_t previous_step = 0;
+        for (WriteTrajectoriesSql &row : rows)
+        {
+            append_varint(columns, zigzag_encode((int64_t)row.step - previous_step));
+            previous_step = row.step;
+        }
+
+        times.resize(rows.size());
+        for (unsigned long int r = 0; r < rows.size(); r++)
+            times[r] = rows[r].time;
+        append_times(columns, times);
+
+        // each row is taken apart once, and the columns are then
+        // written out one after the other
+        values.resize(rows.size() * number_of_columns);
+        for (unsigned long int r = 0; r < rows.size(); r++)
+            WriteTrajectoriesSql::binary_columns(rows[r], values.data() + r * number_of_columns);
+
+        for (int c = 0; c < number_of_columns; c++)
+        {
+            for (unsigned long int r = 0; r < rows.size(); r++)
+                append_varint(columns, zigzag_encode(values[r * number_of_columns + c]));
+        }
+
+        append_varint(block, rows.size());
+        append_varint(block, columns.size());
+        block.insert(block.end(), columns.begin(), columns.end());
+
+        if (std::fwrite(block.data(), 1, block.size(), file) != block.size())
+        {
+            std::cerr << time::time_stamp()
+                      << "could not write trajectory file " << path << '\n';
+            std::abort();
+        }
+
+        std::fclose(file);
+    };
+};
+
+/* ------------------------------------------------------------------- */
+
+struct TrajectoryRecord
+{
+    int step;
+    double time;
+    int columns[max_binary_columns];
+};
+
+class TrajectoryFileReader
+{
+public:
+    std::vector<uint8_t> contents;
+    unsigned long int seed;
+    int number_of_columns;
+    std::string column_names;
+    unsigned long int position; // start of the next block
+    std::vector<double> times;  // reused between blocks
+
+    // returns an empty optional if the file can't be read or has a bad header
+    static std::optional<TrajectoryFileReader> open(std::string path)
+    {
+        TrajectoryFileReader reader;
+
+        FILE *file = std::fopen(path.c_str(), "rb");
+        if (!file)
+            return std::optional<TrajectoryFileReader>();
+
+        uint8_t buffer[65536];
+        size_t bytes_read;
+        while ((bytes_read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+            reader.contents.insert(reader.contents.end(), buffer, buffer + bytes_read);
+        std::fclose(file);
+
+        if (reader.contents.size() < 24 ||
+            std::memcmp(reader.contents.data(), trajectory_file_magic, 8) != 0)
+            return std::optional<TrajectoryFileReader>();
+
+        reader.seed = read_fixed(reader.contents.data() + 8, 8);
+        reader.number_of_columns = read_fixed(reader.contents.data() + 16, 4);
+        unsigned long int names_length = read_fixed(reader.contents.data() + 20, 4);
+
+        if (reader.number_of_columns > max_binary_columns ||
+            reader.contents.size() < 24 + names_length)
+            return std::optional<TrajectoryFileReader>();
+
+        reader.column_names = std::string(reader.contents.begin() + 24,
+                                          reader.contents.begin() + 24 + names_length);
+        reader.position = 24 + names_length;
+
+        return std::optional<TrajectoryFileReader>(std::move(reader));
+    };
+
+    // decode the next block into records. Returns false at the end of
+    // the file or if the block is truncated.
+    bool next_block(std::vector<TrajectoryRecord> &records)
+    {
+        records.clear();
+
+        const uint8_t *cursor = contents.data() + position;
+        const uint8_t *end = contents.data() + contents.size();
+
+        uint64_t number_of_records, block_bytes;
+        if (!read_varint(cursor, end, number_of_records) ||
+            !read_varint(cursor, end, block_bytes) ||
+            block_bytes > (uint64_t)(end - cursor))
+            return false;
+
+        // every record takes at least a byte for its step and each of
+        // its columns and a bit for its time, so a count the block can't
+        // hold means the file is corrupt. Checked before anything is
+        // allocated.
+        if (number_of_records > 8 * block_bytes / (8 * (1 + number_of_columns) + 1))
+            return false;
+
+        end = cursor + block_bytes;
+        records.resize(number_of_records);
+
+        uint64_t value;
+        int64_t step = 0;
+        for (TrajectoryRecord &record : records)
+        {
+            if (!read_varint(cursor, end, value))
+                return false;
+            step += zigzag_decode(value);
+            record.step = step;
+        }
+
+        times.resize(number_of_records);
+        if (!read_times(cursor, end, times))
+            return false;
+        for (unsigned long int i = 0; i < records.size(); i++)
+            records[i].time = times[i];
+
+        for (int c = 0; c < number_of_columns; c++)
+        {
+            for (TrajectoryRecord &record : records)
+            {
+                if (!read_varint(cursor, end, value))
+                    return false;
+                record.columns[c] = zigzag_decode(value);
+            }
+        }
+
+        position = end - contents.data();
+        return true;
+    };
+};
+
+#endif
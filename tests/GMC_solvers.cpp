@@ -7,6 +7,9 @@ All tests use googletest unit test framework
 #include "../GMC/linear_solver.h"
 #include "../GMC/tree_solver.h"
 #include "../GMC/sparse_solver.h"
+#include "../GMC/composition_rejection_solver.h"
+#include "../GMC/next_reaction_solver.h"
+#include "../GMC/wide_tree_solver.h"
 
 TEST(GMC_solvers, GMC_solvers)
 {
@@ -19,6 +22,7 @@ TEST(GMC_solvers, GMC_solvers)
         0.1, 0, 0};
 
     TreeSolver tree_solver(42, std::ref(initial_propensities));
+    WideTreeSolver wide_tree_solver(42, std::ref(initial_propensities));
     LinearSolver linear_solver_unused(42, std::ref(initial_propensities));
     SparseSolver sparse_solver(42, std::ref(initial_propensities));
     LinearSolver linear_solver(42, std::move(initial_propensities));
@@ -28,7 +32,319 @@ TEST(GMC_solvers, GMC_solvers)
         Event linear_event = linear_solver.event().value();
         Event tree_event = tree_solver.event().value();
         Event sparse_event = sparse_solver.event().value();
+        Event wide_tree_event = wide_tree_solver.event().value();
         EXPECT_EQ(linear_event.index, tree_event.index);
+        EXPECT_EQ(linear_event.index, wide_tree_event.index);
         EXPECT_EQ(linear_event.index, sparse_event.index);
     }
-}
\ No newline at end of file
+}
+
+// propensities spanning several binades, some sharing a binade, and
+// updates which move events between binades, switch some off and some
+// on. Solvers which consume random numbers differently from the linear
+// solver are compared with it through event frequencies and mean
+// waiting times rather than individual events.
+template <typename Solver>
+void compare_with_linear_solver(Solver &solver, LinearSolver &linear_solver,
+                                unsigned long int number_of_reactions)
+{
+    EXPECT_DOUBLE_EQ(linear_solver.get_propensity_sum(),
+                     solver.get_propensity_sum());
+
+    std::vector<Update> updates = {
+        Update{.index = 11, .propensity = 2.0},
+        Update{.index = 3, .propensity = 0.0},
+        Update{.index = 0, .propensity = 0.4},
+        Update{.index = 7, .propensity = 6.0},
+        Update{.index = 9, .propensity = 1.0e-6}};
+
+    for (Update update : updates)
+    {
+        linear_solver.update(update);
+        solver.update(update);
+        EXPECT_EQ(linear_solver.get_propensity(update.index),
+                  solver.get_propensity(update.index));
+    }
+
+    int number_of_events = 400000;
+    std::vector<int> linear_counts(number_of_reactions, 0);
+    std::vector<int> counts(number_of_reactions, 0);
+    double time = 0.0;
+
+    for (int i = 0; i < number_of_events; i++)
+    {
+        linear_counts[linear_solver.event().value().index]++;
+
+        Event event = solver.event().value();
+        counts[event.index]++;
+        EXPECT_GE(event.dt, 0.0);
+        time += event.dt;
+    }
+
+    double propensity_sum = linear_solver.get_propensity_sum();
+    EXPECT_NEAR(propensity_sum, solver.get_propensity_sum(), 1e-9);
+
+    // waiting times are exponential with mean 1 / propensity_sum
+    EXPECT_NEAR(time / number_of_events, 1.0 / propensity_sum,
+                5.0 / (propensity_sum * std::sqrt(number_of_events)));
+
+    for (unsigned long int i = 0; i < number_of_reactions; i++)
+    {
+        double p = linear_solver.get_propensity(i) / propensity_sum;
+
+        if (p == 0)
+        {
+            EXPECT_EQ(counts[i], 0);
+            continue;
+        }
+
+        // both counts are binomial, allow five standard deviations
+        // of their difference
+        double sigma = std::sqrt(2.0 * number_of_events * p * (1 - p));
+        EXPECT_NEAR(linear_counts[i], counts[i], 5 * sigma + 1);
+    }
+}
+
+std::vector<double> mixed_binade_propensities = {
+    0, 3.0e-4, 0, 0.1,
+    0, 0.15, 0, 7.0, 0.2,
+    0, 0.3, 1.0e3,
+    0, 0, 0.1, 5.0};
+
+TEST(GMC_solvers, composition_rejection_solver)
+{
+    std::vector<double> initial_propensities = mixed_binade_propensities;
+    LinearSolver linear_solver(42, std::ref(initial_propensities));
+    CompositionRejectionSolver composition_rejection_solver(42, std::ref(initial_propensities));
+
+    compare_with_linear_solver(composition_rejection_solver, linear_solver,
+                               initial_propensities.size());
+}
+
+TEST(GMC_solvers, next_reaction_solver)
+{
+    std::vector<double> initial_propensities = mixed_binade_propensities;
+    LinearSolver linear_solver(42, std::ref(initial_propensities));
+    NextReactionSolver next_reaction_solver(42, std::ref(initial_propensities));
+
+    compare_with_linear_solver(next_reaction_solver, linear_solver,
+                               initial_propensities.size());
+
+    // switching every reaction off ends the simulation
+    for (unsigned long int i = 0; i < initial_propensities.size(); i++)
+        next_reaction_solver.update(Update{.index = i, .propensity = 0.0});
+
+    EXPECT_FALSE(next_reaction_solver.event().has_value());
+}
+
+TEST(GMC_solvers, next_reaction_solver_interleaved_updates)
+{
+    // every step changes one propensity after the event, so firing times
+    // are rescaled about a non-zero time, and reactions are switched off
+    // and back on mid run. The last reaction is never updated, which
+    // keeps the simulation going. The propensities at each step don't
+    // depend on which events fired, so the expected event counts and
+    // total time are sums over the steps.
+    std::vector<double> propensities = {1.0, 2.0, 3.0, 4.0, 1.0};
+    std::vector<double> values = {0.5, 5.0, 0.0, 2.0};
+    NextReactionSolver next_reaction_solver(42, std::ref(propensities));
+
+    int number_of_events = 200000;
+    std::vector<int> counts(propensities.size(), 0);
+    std::vector<double> expected_counts(propensities.size(), 0.0);
+    std::vector<double> count_variances(propensities.size(), 0.0);
+    double time = 0.0;
+    double expected_time = 0.0;
+    double time_variance = 0.0;
+
+    for (int step = 0; step < number_of_events; step++)
+    {
+        double propensity_sum = 0.0;
+        for (double propensity : propensities)
+            propensity_sum += propensity;
+
+        EXPECT_NEAR(next_reaction_solver.get_propensity_sum(), propensity_sum, 1e-9);
+
+        for (unsigned long int i = 0; i < propensities.size(); i++)
+        {
+            double p = propensities[i] / propensity_sum;
+            expected_counts[i] += p;
+            count_variances[i] += p * (1 - p);
+        }
+        expected_time += 1.0 / propensity_sum;
+        time_variance += 1.0 / (propensity_sum * propensity_sum);
+
+        std::optional<Event> maybe_event = next_reaction_solver.event();
+        ASSERT_TRUE(maybe_event.has_value());
+        counts[maybe_event.value().index]++;
+        EXPECT_GE(maybe_event.value().dt, 0.0);
+        time += maybe_event.value().dt;
+
+        unsigned long int index = step % 4;
+        Update update = Update{.index = index,
+                               .propensity = values[(step / 4 + index) % values.size()]};
+        propensities[index] = update.propensity;
+        next_reaction_solver.update(update);
+    }
+
+    EXPECT_NEAR(time, expected_time, 5 * std::sqrt(time_variance));
+    for (unsigned long int i = 0; i < propensities.size(); i++)
+        EXPECT_NEAR(counts[i], expected_counts[i], 5 * std::sqrt(count_variances[i]) + 1);
+}
+
+TEST(GMC_solvers, wide_tree_solver)
+{
+    // a network large enough for several levels of the wide tree, with
+    // propensities switched on and off while events are drawn. Both
+    // tree solvers draw the same random numbers, so they should pick
+    // the same events.
+    int number_of_reactions = 5000;
+    std::vector<double> initial_propensities(number_of_reactions, 0.0);
+    for (int i = 0; i < number_of_reactions; i += 3)
+        initial_propensities[i] = 1.0 + (i % 17);
+
+    TreeSolver tree_solver(42, std::ref(initial_propensities));
+    WideTreeSolver wide_tree_solver(42, std::ref(initial_propensities));
+
+    EXPECT_DOUBLE_EQ(tree_solver.get_propensity_sum(),
+                     wide_tree_solver.get_propensity_sum());
+
+    for (int i = 0; i < 20000; i++)
+    {
+        Event tree_event = tree_solver.event().value();
+        Event wide_tree_event = wide_tree_solver.event().value();
+        EXPECT_EQ(tree_event.index, wide_tree_event.index);
+
+        Update update = Update{
+            .index = static_cast<unsigned long int>((7 * i) % number_of_reactions),
+            .propensity = (i % 5 == 0) ? 0.0 : 0.5 * (i % 11)};
+
+        tree_solver.update(update);
+        wide_tree_solver.update(update);
+        EXPECT_EQ(tree_solver.get_propensity(update.index),
+                  wide_tree_solver.get_propensity(update.index));
+    }
+}
+
+TEST(GMC_solvers, batched_updates)
+{
+    // applying a step's updates as one batch, including repeated indices,
+    // should leave the trees in the same state as applying them one by one
+    int number_of_reactions = 1000;
+    std::vector<double> initial_propensities(number_of_reactions, 0.0);
+    for (int i = 0; i < number_of_reactions; i += 2)
+        initial_propensities[i] = 0.25 * (1 + i % 7);
+
+    TreeSolver tree_solver(42, std::ref(initial_propensities));
+    TreeSolver batched_tree_solver(42, std::ref(initial_propensities));
+    WideTreeSolver wide_tree_solver(42, std::ref(initial_propensities));
+    WideTreeSolver batched_wide_tree_solver(42, std::ref(initial_propensities));
+
+    std::vector<Update> updates;
+    for (int step = 0; step < 2000; step++)
+    {
+        updates.clear();
+        for (int j = 0; j < 1 + step % 13; j++)
+        {
+            updates.push_back(Update{
+                .index = static_cast<unsigned long int>((31 * step + 17 * j) % number_of_reactions),
+                .propensity = ((step + j) % 4 == 0) ? 0.0 : 0.1 * ((step * j) % 9)});
+        }
+
+        for (Update update : updates)
+        {
+            tree_solver.update(update);
+            wide_tree_solver.update(update);
+        }
+        batched_tree_solver.update(updates);
+        batched_wide_tree_solver.update(updates);
+
+        Event tree_event = tree_solver.event().value();
+        EXPECT_EQ(tree_event.index, batched_tree_solver.event().value().index);
+        Event wide_tree_event = wide_tree_solver.event().value();
+        EXPECT_EQ(wide_tree_event.index, batched_wide_tree_solver.event().value().index);
+    }
+
+    EXPECT_EQ(tree_solver.get_propensity_sum(), batched_tree_solver.get_propensity_sum());
+    EXPECT_EQ(wide_tree_solver.get_propensity_sum(), batched_wide_tree_solver.get_propensity_sum());
+    for (int i = 0; i < number_of_reactions; i++)
+    {
+        EXPECT_EQ(tree_solver.get_propensity(i), batched_tree_solver.get_propensity(i));
+        EXPECT_EQ(wide_tree_solver.get_propensity(i), batched_wide_tree_solver.get_propensity(i));
+    }
+}
+
+TEST(GMC_solvers, philox_sampler)
+{
+    // known answers from the Random123 distribution
+    uint32_t key[2] = {0, 0};
+    uint32_t words[4 * philox_lanes];
+    philox4x32_10(key, 0, 0, 0, words);
+    EXPECT_EQ(words[0], 0x6627e8d5u);
+    EXPECT_EQ(words[1], 0xe169c58du);
+    EXPECT_EQ(words[2], 0xbc57ac4cu);
+    EXPECT_EQ(words[3], 0x9b00dbd8u);
+
+    for (double x : {0x1p-53, 1e-300, 1e-10, 0.1, 0.5, 0.70710678, 0.7071068, 0.99, 1.0, 3.0})
+        EXPECT_NEAR(sampler_log(x), std::log(x), 4e-16 * std::abs(std::log(x)) + 1e-300);
+
+    sampler_backend = philox_sampler;
+
+    // a draw is a function of the seed, the step and its index within
+    // the step, so a sampler started at step k draws what one stepped
+    // there from step 0 does, however many draws each step took
+    Sampler first(42);
+    Sampler second(42);
+    for (int i = 0; i < 100; i++)
+    {
+        for (int j = 0; j < i % 4; j++)
+        {
+            EXPECT_EQ(first.generate(), second.generate());
+            EXPECT_EQ(first.exponential(), second.exponential());
+        }
+        first.next_step();
+        second.next_step();
+    }
+
+    Sampler resumed(sampler_seed(42, 100));
+    for (int j = 0; j < 3; j++)
+    {
+        EXPECT_EQ(first.generate(), resumed.generate());
+        EXPECT_EQ(first.exponential(), resumed.exponential());
+    }
+    EXPECT_NE(Sampler(sampler_seed(42, 100)).generate(),
+              Sampler(sampler_seed(42, 101)).generate());
+
+    int number_of_draws = 1000000;
+    double uniform_sum = 0.0;
+    double exponential_sum = 0.0;
+    for (int i = 0; i < number_of_draws; i++)
+    {
+        double u = first.generate();
+        EXPECT_GT(u, 0.0);
+        EXPECT_LT(u, 1.0);
+        uniform_sum += u;
+        exponential_sum += first.exponential();
+    }
+
+    EXPECT_NEAR(uniform_sum / number_of_draws, 0.5, 5 * std::sqrt(1.0 / 12 / number_of_draws));
+    EXPECT_NEAR(exponential_sum / number_of_draws, 1.0, 5 / std::sqrt(number_of_draws));
+
+    // solvers driven by philox pick events in proportion to propensity
+    std::vector<double> initial_propensities = {0.1, 0, 2.0, 0.4, 7.5};
+    TreeSolver tree_solver(7, std::ref(initial_propensities));
+    std::vector<int> counts(initial_propensities.size(), 0);
+    int number_of_events = 200000;
+    for (int i = 0; i < number_of_events; i++)
+        counts[tree_solver.event().value().index]++;
+
+    sampler_backend = gsl_sampler;
+
+    double propensity_sum = tree_solver.get_propensity_sum();
+    for (unsigned long int i = 0; i < initial_propensities.size(); i++)
+    {
+        double p = initial_propensities[i] / propensity_sum;
+        EXPECT_NEAR(counts[i], number_of_events * p,
+                    5 * std::sqrt(number_of_events * p * (1 - p)) + 1);
+    }
+}
@@ -123,3 +123,157 @@ TEST(lattice_reaction_network_test, dependents)
    EXPECT_EQ(static_LGMC_.dependents[4][2], 3);
    EXPECT_EQ(static_LGMC_.dependents[4][3], 8);
 }
+
+TEST(lattice_reaction_network_test, propensity_slots)
+{
+   LatticePropensities props;
+
+   // a pair gets the same slot in either order, and its sites decode
+   // with the larger one first
+   uint32_t pair = props.slot(3, 12);
+   EXPECT_EQ(props.slot(12, 3), pair);
+   EXPECT_EQ(LatticePropensities::first_site(props.key(pair)), 12);
+   EXPECT_EQ(LatticePropensities::second_site(props.key(pair)), 3);
+
+   uint32_t homogeneous = props.slot(7, SITE_HOMOGENEOUS);
+   EXPECT_NE(homogeneous, pair);
+   EXPECT_EQ(LatticePropensities::first_site(props.key(homogeneous)), 7);
+   EXPECT_EQ(LatticePropensities::second_site(props.key(homogeneous)), SITE_HOMOGENEOUS);
+
+   // grow both slots past their first chunks, interleaved so that they
+   // move around the pool
+   for (int i = 0; i < 20; i++)
+   {
+      props.add(pair, 1.0, i);
+      props.add(homogeneous, 0.5, 100 + i);
+   }
+
+   EXPECT_EQ(props.size(pair), 20u);
+   EXPECT_DOUBLE_EQ(props.sum(pair), 20.0);
+   EXPECT_DOUBLE_EQ(props.sum(homogeneous), 10.0);
+
+   for (uint32_t i = 0; i < props.size(pair); i++)
+   {
+      EXPECT_EQ(props.entries(pair)[i].reaction_id, int(i));
+      EXPECT_EQ(props.entries(homogeneous)[i].reaction_id, 100 + int(i));
+   }
+
+   props.clear(pair);
+   EXPECT_EQ(props.size(pair), 0u);
+   EXPECT_DOUBLE_EQ(props.sum(pair), 0.0);
+   EXPECT_EQ(props.number_of_slots(), 2u);
+
+   // looking a pair up finds its slot in either order, and doesn't
+   // create one for a pair without
+   EXPECT_EQ(props.find(12, 3).value(), pair);
+   EXPECT_EQ(props.find(7, SITE_HOMOGENEOUS).value(), homogeneous);
+   EXPECT_FALSE(props.find(3, 4).has_value());
+   EXPECT_EQ(props.number_of_slots(), 2u);
+}
+
+TEST(lattice_reaction_network_test, propensity_tree)
+{
+   PropensityTree tree;
+   tree.resize(3);
+   tree.set(0, 1.0);
+   tree.set(1, 0.0);
+   tree.set(2, 2.0);
+   tree.refresh();
+   EXPECT_DOUBLE_EQ(tree.total(), 3.0);
+
+   double value = 0.5;
+   EXPECT_EQ(tree.find(value), 0u);
+   value = 1.5;
+   EXPECT_EQ(tree.find(value), 2u);
+   EXPECT_DOUBLE_EQ(value, 0.5);
+
+   // an empty leaf is skipped even when the point lands on its edge
+   value = 1.0;
+   EXPECT_EQ(tree.find(value), 0u);
+
+   // growing keeps the values
+   tree.resize(9);
+   tree.add(8, 4.0);
+   tree.refresh();
+   EXPECT_DOUBLE_EQ(tree.total(), 7.0);
+   EXPECT_DOUBLE_EQ(tree.get(2), 2.0);
+   value = 6.5;
+   EXPECT_EQ(tree.find(value), 8u);
+
+   // selection from the slots of a LatticePropensities goes through its
+   // tree and then the entries of one slot
+   LatticePropensities props;
+   uint32_t first = props.slot(1, SITE_HOMOGENEOUS);
+   uint32_t second = props.slot(5, 4);
+   props.add(first, 1.0, 10);
+   props.add(second, 1.0, 20);
+   props.add(second, 0.0, 21);
+   props.add(second, 2.0, 22);
+   props.refresh();
+   EXPECT_DOUBLE_EQ(props.total(), 4.0);
+
+   uint32_t slot, entry;
+   props.select(0.5, slot, entry);
+   EXPECT_EQ(slot, first);
+   props.select(2.5, slot, entry);
+   EXPECT_EQ(slot, second);
+   EXPECT_EQ(props.entries(slot)[entry].reaction_id, 22);
+
+   props.clear(first);
+   props.refresh();
+   EXPECT_DOUBLE_EQ(props.total(), 3.0);
+   props.select(0.0, slot, entry);
+   EXPECT_EQ(slot, second);
+}
+
+// test the adsorbable sites of an EdgeSet and the adsorption channels
+// picking one of them
+TEST(lattice_reaction_network_test, adsorption_channels)
+{
+   EdgeSet edges;
+   edges.set(3, 'a');
+   edges.set(8, 'a');
+   edges.set(5, 'd');
+   edges.set(9, 'a');
+   EXPECT_EQ(edges.size(), 4);
+   EXPECT_EQ(edges.number_of_adsorbable(), 3);
+   EXPECT_EQ(edges.new_adsorbable().size(), 3u);
+
+   // a site which stops being adsorbable is replaced by the last one
+   edges.set(3, 'd');
+   edges.erase(5);
+   EXPECT_EQ(edges.size(), 3);
+   ASSERT_EQ(edges.number_of_adsorbable(), 2);
+   EXPECT_EQ(edges.adsorbable(0), 9);
+   EXPECT_EQ(edges.adsorbable(1), 8);
+   EXPECT_EQ(edges[3], 'd');
+   EXPECT_FALSE(edges.contains(5));
+
+   edges.clear_new_adsorbable();
+   edges.set(5, 'a');
+   ASSERT_EQ(edges.new_adsorbable().size(), 1u);
+   EXPECT_EQ(edges.new_adsorbable()[0], 5);
+
+   LatticePropensities props;
+   props.set_adsorption(4, 0.0);
+   props.set_adsorption(6, 1.0);
+   props.set_adsorption(7, 0.5);
+   props.set_adsorbable_sites(edges.number_of_adsorbable());
+   EXPECT_DOUBLE_EQ(props.adsorption_total(), 4.5);
+
+   int reaction_id, site_index;
+   props.select_adsorption(2.5, reaction_id, site_index);
+   EXPECT_EQ(reaction_id, 6);
+   EXPECT_EQ(site_index, 2);
+   props.select_adsorption(3.2, reaction_id, site_index);
+   EXPECT_EQ(reaction_id, 7);
+   EXPECT_EQ(site_index, 0);
+
+   // rounding past the total stays on the last site of the last channel
+   props.select_adsorption(4.6, reaction_id, site_index);
+   EXPECT_EQ(reaction_id, 7);
+   EXPECT_EQ(site_index, 2);
+
+   props.set_adsorption(6, 0.0);
+   EXPECT_DOUBLE_EQ(props.adsorption_total(), 1.5);
+}
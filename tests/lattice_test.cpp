@@ -93,3 +93,86 @@ TEST(lattice_test, CopyConstructor)
 
    delete new_lattice;
 }
+
+// test that deleting a site leaves a gap and is seen by its neighbors
+TEST(lattice_test, DeleteSiteGap)
+{
+   Lattice *lattice = new Lattice(1, 3, 5, 7);
+   int nsites = lattice->get_nsites();
+
+   std::tuple<uint32_t, uint32_t, uint32_t> key = {1, 1, 7};
+   int id = lattice->loc_map[key];
+   key = {1, 1, 6};
+   int below = lattice->loc_map[key];
+
+   lattice->delete_site(id);
+
+   EXPECT_FALSE(lattice->sites.contains(id));
+   EXPECT_FALSE(lattice->edges.contains(id));
+   key = {1, 1, 7};
+   EXPECT_EQ(lattice->loc_map.find(key), -1);
+   EXPECT_FALSE(lattice->loc_map.contains(key));
+   EXPECT_EQ(lattice->loc_map.size(), lattice->sites.size());
+   EXPECT_EQ(lattice->idneigh.size(), lattice->sites.size());
+
+   ASSERT_EQ(int(lattice->numneigh[below]), 5);
+   for (uint32_t n = 0; n < lattice->numneigh[below]; n++)
+   {
+      EXPECT_NE(int(lattice->idneigh[below][n]), id);
+   }
+
+   // ids are not reused
+   lattice->add_site(1, 1, 7, true, true, true);
+   key = {1, 1, 7};
+   EXPECT_EQ(lattice->loc_map[key], nsites);
+   EXPECT_EQ(lattice->get_nsites(), nsites + 1);
+   EXPECT_EQ(int(lattice->numneigh[below]), 6);
+
+   delete lattice;
+}
+
+// test that layer rates start uncomputed, keep their values as layers
+// are added and are emptied when the conditions change
+TEST(lattice_test, MissingSite)
+{
+   Lattice *lattice = new Lattice(1, 3, 5, 7);
+
+   // positions outside the grid, including k - 1 of a site at k = 0,
+   // have no site
+   std::tuple<uint32_t, uint32_t, uint32_t> key = {0, 0, 0};
+   uint32_t below = std::get<2>(key) - 1;
+   EXPECT_TRUE(lattice->loc_map.contains(key));
+   EXPECT_FALSE(lattice->loc_map.contains({0, 0, below}));
+   EXPECT_EQ(lattice->loc_map.find({0, 0, below}), -1);
+
+   // looking up a missing site or a negative id is an error rather than
+   // a read out of bounds
+   EXPECT_DEATH(lattice->loc_map[std::make_tuple(0u, 0u, below)], "");
+   EXPECT_DEATH(lattice->sites[-1], "");
+
+   delete lattice;
+}
+
+TEST(lattice_test, LayerRates)
+{
+   Lattice *lattice = new Lattice(1, 3, 5, 7);
+   EXPECT_EQ(lattice->get_maxk(), 7);
+
+   LayerRates &rates = lattice->layer_rates;
+   EXPECT_TRUE(std::isnan(rates.get(2, 0, 4, -2.1, 300)));
+   rates.get(2, 0, 4, -2.1, 300) = 5.0;
+   rates.get(3, 7, 4, -2.1, 300) = 6.0;
+
+   EXPECT_DOUBLE_EQ(rates.get(2, 0, 4, -2.1, 300), 5.0);
+   EXPECT_DOUBLE_EQ(rates.get(3, 7, 4, -2.1, 300), 6.0);
+   EXPECT_TRUE(std::isnan(rates.get(2, 3, 4, -2.1, 300)));
+
+   // a copy of the lattice has the same rates
+   Lattice copy = *lattice;
+   EXPECT_DOUBLE_EQ(copy.layer_rates.get(2, 0, 4, -2.1, 300), 5.0);
+
+   EXPECT_TRUE(std::isnan(rates.get(2, 0, 4, -1.5, 300)));
+   EXPECT_TRUE(std::isnan(rates.get(3, 7, 4, -1.5, 300)));
+
+   delete lattice;
+}
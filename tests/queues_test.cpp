@@ -0,0 +1,236 @@
+/* ----------------------------------------------------------------------
+Unit tests for the queues shared by the simulator threads and the dispatcher
+All tests use googletest unit test framework
+---------------------------------------------------------------------- */
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../core/queues.h"
+#include "../core/RNMC_types.h"
+
+TEST(HistoryQueueTest, SingleThread)
+{
+    HistoryQueue<HistoryPacket<int>> history_queue;
+
+    EXPECT_TRUE(history_queue.empty());
+    EXPECT_FALSE(history_queue.get_history().has_value());
+
+    for (unsigned long int i = 0; i < 10; i++)
+        history_queue.insert_history(HistoryPacket<int>{.seed = i, .history = {(int)i}});
+
+    EXPECT_FALSE(history_queue.empty());
+
+    // packets come out in the order they went in, and the vectors are
+    // moved through the queue
+    for (unsigned long int i = 0; i < 10; i++)
+    {
+        std::optional<HistoryPacket<int>> maybe_packet = history_queue.get_history();
+        ASSERT_TRUE(maybe_packet.has_value());
+        EXPECT_EQ(maybe_packet.value().seed, i);
+        EXPECT_EQ(maybe_packet.value().history[0], (int)i);
+    }
+
+    EXPECT_TRUE(history_queue.empty());
+}
+
+TEST(HistoryQueueTest, FullQueue)
+{
+    HistoryQueue<HistoryPacket<int>> history_queue(1);
+
+    // capacity is rounded up to the minimum
+    HistoryPacket<int> packet{.seed = 0, .history = {}};
+    for (unsigned long int i = 0; i < minimum_history_queue_capacity; i++)
+        EXPECT_TRUE(history_queue.try_insert_history(packet));
+
+    EXPECT_FALSE(history_queue.try_insert_history(packet));
+
+    history_queue.get_history();
+    EXPECT_TRUE(history_queue.try_insert_history(packet));
+}
+
+TEST(HistoryQueueTest, MaxBytesInFlight)
+{
+    HistoryQueue<HistoryPacket<int>> history_queue;
+    history_queue.max_bytes_in_flight = 10 * sizeof(int);
+
+    HistoryPacket<int> packet{.seed = 0, .history = std::vector<int>(6)};
+    EXPECT_TRUE(history_queue.try_insert_history(packet));
+
+    // a second packet of 6 ints would take the queue over 10 ints
+    HistoryPacket<int> second_packet{.seed = 1, .history = std::vector<int>(6)};
+    EXPECT_FALSE(history_queue.try_insert_history(second_packet));
+    EXPECT_EQ(second_packet.history.size(), 6ul);
+
+    // an empty packet still fits
+    HistoryPacket<int> empty_packet{.seed = 2, .history = {}};
+    EXPECT_TRUE(history_queue.try_insert_history(empty_packet));
+
+    // once the first packet is taken out there is room again
+    history_queue.get_history();
+    EXPECT_TRUE(history_queue.try_insert_history(second_packet));
+
+    // a packet larger than the limit is accepted when nothing else is
+    // holding memory
+    history_queue.get_history();
+    history_queue.get_history();
+    EXPECT_EQ(history_queue.bytes_in_flight.load(), 0ul);
+
+    HistoryPacket<int> large_packet{.seed = 3, .history = std::vector<int>(100)};
+    EXPECT_TRUE(history_queue.try_insert_history(large_packet));
+}
+
+TEST(HistoryQueueTest, HeldBytesBlockProducers)
+{
+    // the dispatcher takes packets out with take_history and only
+    // releases their bytes once the writer is done with them. While the
+    // writer is blocked, producers must not refill the emptied queue.
+    HistoryQueue<HistoryPacket<int>> history_queue;
+    history_queue.max_bytes_in_flight = 10 * sizeof(int);
+    unsigned long int number_of_packets = 20;
+
+    unsigned long int packet_bytes = 4 * sizeof(int);
+    std::atomic<unsigned long int> inserted = 0;
+
+    std::thread producer([&]
+                         {
+        for (unsigned long int i = 0; i < number_of_packets; i++)
+        {
+            history_queue.insert_history(HistoryPacket<int>{
+                .seed = i,
+                .history = std::vector<int>(4, (int)i)});
+            inserted++;
+        } });
+
+    unsigned long int received = 0;
+    unsigned long int held_packets = 0;
+    unsigned long int held_bytes = 0;
+
+    while (received < number_of_packets)
+    {
+        unsigned long int ticket = history_queue.consumer_ticket();
+        unsigned long int bytes = 0;
+        std::optional<HistoryPacket<int>> maybe_packet = history_queue.take_history(bytes);
+
+        if (maybe_packet)
+        {
+            EXPECT_EQ(maybe_packet.value().seed, received);
+            received++;
+            held_packets++;
+            held_bytes += bytes;
+            EXPECT_LE(history_queue.bytes_in_flight.load(),
+                      history_queue.max_bytes_in_flight);
+            continue;
+        }
+
+        if (held_packets == 0)
+        {
+            history_queue.wait_for_history(ticket);
+            continue;
+        }
+
+        // the writer is busy with everything taken so far. Give the
+        // producer time to refill the queue, then check that the queued
+        // and held packets together stay under the cap.
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        unsigned long int queued_bytes = (inserted.load() - received) * packet_bytes;
+        EXPECT_LE(queued_bytes + held_packets * packet_bytes,
+                  history_queue.max_bytes_in_flight);
+        EXPECT_LE(history_queue.bytes_in_flight.load(), history_queue.max_bytes_in_flight);
+
+        history_queue.release_bytes(held_bytes);
+        held_packets = 0;
+        held_bytes = 0;
+    }
+
+    producer.join();
+    history_queue.release_bytes(held_bytes);
+
+    EXPECT_TRUE(history_queue.empty());
+    EXPECT_EQ(history_queue.bytes_in_flight.load(), 0ul);
+}
+
+TEST(HistoryQueueTest, ManyProducers)
+{
+    // far more packets than slots, so producers block on a full queue
+    // and the consumer sleeps on an empty one
+    int number_of_producers = 16;
+    unsigned long int packets_per_producer = 2000;
+
+    HistoryQueue<HistoryPacket<int>> history_queue(1);
+    std::vector<std::thread> producers;
+
+    for (int p = 0; p < number_of_producers; p++)
+    {
+        producers.push_back(std::thread([&, p]
+                                        {
+            for (unsigned long int i = 0; i < packets_per_producer; i++)
+                history_queue.insert_history(HistoryPacket<int>{
+                    .seed = (unsigned long int)p,
+                    .history = {(int)i}}); }));
+    }
+
+    // packets from a single producer must arrive in order
+    std::vector<int> next_packet(number_of_producers, 0);
+    unsigned long int received = 0;
+
+    while (received < number_of_producers * packets_per_producer)
+    {
+        unsigned long int ticket = history_queue.consumer_ticket();
+        std::optional<HistoryPacket<int>> maybe_packet = history_queue.get_history();
+
+        if (!maybe_packet)
+        {
+            history_queue.wait_for_history(ticket);
+            continue;
+        }
+
+        HistoryPacket<int> &packet = maybe_packet.value();
+        EXPECT_EQ(packet.history[0], next_packet[packet.seed]);
+        next_packet[packet.seed]++;
+        received++;
+    }
+
+    for (std::thread &producer : producers)
+        producer.join();
+
+    EXPECT_TRUE(history_queue.empty());
+    for (int p = 0; p < number_of_producers; p++)
+        EXPECT_EQ(next_packet[p], (int)packets_per_producer);
+}
+
+TEST(SeedStateStoreTest, TakeOnce)
+{
+    SeedStateStore<std::vector<int>> store;
+    std::atomic<int> defaults_made = 0;
+    store.set_default([&defaults_made]()
+                      { defaults_made++; return std::vector<int>{1, 2, 3}; });
+
+    // a checkpointed seed starts from the default and is then edited
+    store[5][0] = 7;
+    EXPECT_EQ(defaults_made, 1);
+
+    std::vector<int> state = store.take(5);
+    EXPECT_EQ(state, (std::vector<int>{7, 2, 3}));
+
+    // once taken, the stored state is gone and nothing else was stored
+    EXPECT_EQ(store.take(5), (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(defaults_made, 2);
+
+    // seeds the checkpoint never mentioned are made when they are taken
+    std::vector<std::thread> threads;
+    std::vector<std::vector<int>> taken(8);
+    for (int i = 0; i < 8; i++)
+        threads.push_back(std::thread([&store, &taken, i]()
+                                      { taken[i] = store.take(100 + i); }));
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    for (std::vector<int> &taken_state : taken)
+        EXPECT_EQ(taken_state, (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(defaults_made, 10);
+}
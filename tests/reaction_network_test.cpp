@@ -7,7 +7,12 @@ All tests use googletest unit test framework
 
 #include "../core/sql.h"
 #include "../GMC/gillespie_reaction_network.h"
+#include "../GMC/energy_reaction_network.h"
 #include "../GMC/tree_solver.h"
+#include "../GMC/partial_propensity_solver.h"
+#include "../core/reaction_network_simulation.h"
+#include "../core/tau_leaping_simulation.h"
+#include "../core/slow_scale_simulation.h"
 #include "gtest/gtest.h"
 
 class ReactionNetworkTest : public ::testing::Test
@@ -125,6 +130,162 @@ TEST_F(ReactionNetworkTest, ComputeDependents)
    EXPECT_EQ(reaction_network_.dependents[6][0], 4);
 }
 
+TEST_F(ReactionNetworkTest, ComputeAffected)
+{
+   EXPECT_EQ(int(reaction_network_.affected.size()), 7);
+
+   // 0 -> 2 changes species 0 and 2
+   std::vector<int> expected_affected_0 = {0, 1, 3, 5};
+   std::vector<int> affected_0(reaction_network_.affected[0].begin(),
+                               reaction_network_.affected[0].end());
+   EXPECT_EQ(affected_0, expected_affected_0);
+
+   // 2 + 1 -> 3 + 4 reaches reaction 3 through both 1 and 2, but it
+   // is only listed once
+   std::vector<int> expected_affected_3 = {1, 2, 3, 5, 6};
+   std::vector<int> affected_3(reaction_network_.affected[3].begin(),
+                               reaction_network_.affected[3].end());
+   EXPECT_EQ(affected_3, expected_affected_3);
+
+   // the rows of dependents add up to more than the merged graph, so a
+   // budget of exactly its size is only met by counting the merged rows
+   std::vector<int> entries = reaction_network_.affected.entries;
+   unsigned long int bytes = 8 * sizeof(unsigned long int) + entries.size() * sizeof(int);
+
+   reaction_network_.compute_affected(bytes);
+   EXPECT_EQ(reaction_network_.affected.entries, entries);
+
+   reaction_network_.compute_affected(bytes - 1, 2);
+   EXPECT_EQ(int(reaction_network_.affected.size()), 0);
+
+   reaction_network_.compute_affected(bytes, 2);
+   EXPECT_EQ(reaction_network_.affected.entries, entries);
+
+   // without room for the graph, the same reactions are visited from
+   // the species dependents
+   reaction_network_.compute_affected(0);
+   EXPECT_EQ(int(reaction_network_.affected.size()), 0);
+
+   std::vector<int> visited;
+   reaction_network_.for_each_affected(3, [&](int reaction_index)
+                                       { visited.push_back(reaction_index); });
+   std::sort(visited.begin(), visited.end());
+   visited.erase(std::unique(visited.begin(), visited.end()), visited.end());
+   EXPECT_EQ(visited, expected_affected_3);
+}
+
+TEST(ParallelStartupTest, MatchesSerialStartup)
+{
+   SqlConnection model_database = SqlConnection("../examples/GMC/end-to-end-test/rn.sqlite",
+                                                SQLITE_OPEN_READWRITE);
+   SqlConnection initial_state_database = SqlConnection("../examples/GMC/end-to-end-test/initial_state.sqlite",
+                                                        SQLITE_OPEN_READWRITE);
+
+   ReactionNetworkParameters serial_parameters{.isCheckpoint = false};
+   ReactionNetworkParameters parallel_parameters{.isCheckpoint = false,
+                                                 .thread_count = 4};
+
+   GillespieReactionNetwork serial(model_database, initial_state_database,
+                                   serial_parameters);
+   GillespieReactionNetwork parallel(model_database, initial_state_database,
+                                     parallel_parameters);
+
+   // the ranges are stitched back together in reaction order, so every
+   // table comes out exactly as a single thread builds it
+   EXPECT_EQ(parallel.reactions.number_of_reactants, serial.reactions.number_of_reactants);
+   EXPECT_EQ(parallel.reactions.reactants, serial.reactions.reactants);
+   EXPECT_EQ(parallel.reactions.products, serial.reactions.products);
+   EXPECT_EQ(parallel.reactions.rate, serial.reactions.rate);
+
+   EXPECT_EQ(parallel.dependents.offsets, serial.dependents.offsets);
+   EXPECT_EQ(parallel.dependents.entries, serial.dependents.entries);
+   EXPECT_EQ(parallel.affected.offsets, serial.affected.offsets);
+   EXPECT_EQ(parallel.affected.entries, serial.affected.entries);
+
+   std::vector<double> propensities;
+   serial.compute_initial_propensities(serial.initial_state, propensities);
+   EXPECT_EQ(serial.initial_state_propensities, propensities);
+   EXPECT_EQ(parallel.initial_state_propensities, propensities);
+}
+
+TEST(ModelCacheTest, MatchesDatabase)
+{
+   SqlConnection model_database = SqlConnection("../examples/GMC/end-to-end-test/rn.sqlite",
+                                                SQLITE_OPEN_READWRITE);
+   SqlConnection initial_state_database = SqlConnection("../examples/GMC/end-to-end-test/initial_state.sqlite",
+                                                        SQLITE_OPEN_READWRITE);
+
+   std::string cache_path = "test_sqlite_files/GMC/end-to-end-test.model_cache";
+   std::remove(cache_path.c_str());
+
+   ReactionNetworkParameters database_parameters{.isCheckpoint = false};
+   ReactionNetworkParameters cache_parameters{.isCheckpoint = false,
+                                              .model_cache = cache_path};
+
+   GillespieReactionNetwork from_database(model_database, initial_state_database,
+                                          database_parameters);
+
+   // the first run writes the cache and the second reads it back
+   GillespieReactionNetwork writer(model_database, initial_state_database,
+                                   cache_parameters);
+   GillespieReactionNetwork reader(model_database, initial_state_database,
+                                   cache_parameters);
+
+   for (GillespieReactionNetwork *network : {&writer, &reader})
+   {
+      EXPECT_EQ(network->reactions.number_of_reactants, from_database.reactions.number_of_reactants);
+      EXPECT_EQ(network->reactions.number_of_products, from_database.reactions.number_of_products);
+      EXPECT_EQ(network->reactions.reactants, from_database.reactions.reactants);
+      EXPECT_EQ(network->reactions.products, from_database.reactions.products);
+      EXPECT_EQ(network->reactions.rate, from_database.reactions.rate);
+      EXPECT_EQ(network->dependents.offsets, from_database.dependents.offsets);
+      EXPECT_EQ(network->dependents.entries, from_database.dependents.entries);
+      EXPECT_EQ(network->affected.offsets, from_database.affected.offsets);
+      EXPECT_EQ(network->affected.entries, from_database.affected.entries);
+      EXPECT_EQ(network->initial_state_propensities, from_database.initial_state_propensities);
+   }
+
+   uint64_t fingerprint = database_fingerprint(model_database.database_file_path,
+                                               default_max_dependency_graph_bytes);
+   {
+      ModelCacheReader cache;
+      EXPECT_TRUE(cache.open(cache_path, gillespie_model_cache, fingerprint));
+   }
+
+   // a cache for other parameters or another kind of model is not used
+   {
+      ModelCacheReader cache;
+      EXPECT_FALSE(cache.open(cache_path, gillespie_model_cache,
+                              database_fingerprint(model_database.database_file_path, 0)));
+   }
+   {
+      ModelCacheReader cache;
+      EXPECT_FALSE(cache.open(cache_path, energy_model_cache, fingerprint));
+   }
+
+   // a damaged cache fails its checksum and is rebuilt from the database
+   FILE *file = std::fopen(cache_path.c_str(), "r+b");
+   ASSERT_NE(file, nullptr);
+   std::fseek(file, -16, SEEK_END);
+   std::fputc(0x5a, file);
+   std::fclose(file);
+   {
+      ModelCacheReader cache;
+      EXPECT_FALSE(cache.open(cache_path, gillespie_model_cache, fingerprint));
+   }
+
+   GillespieReactionNetwork rebuilt(model_database, initial_state_database,
+                                    cache_parameters);
+   EXPECT_EQ(rebuilt.reactions.rate, from_database.reactions.rate);
+   EXPECT_EQ(rebuilt.affected.entries, from_database.affected.entries);
+   {
+      ModelCacheReader cache;
+      EXPECT_TRUE(cache.open(cache_path, gillespie_model_cache, fingerprint));
+   }
+
+   std::remove(cache_path.c_str());
+}
+
 TEST_F(ReactionNetworkTest, InitializePropensities)
 {
 
@@ -236,5 +397,313 @@ TEST_F(ReactionNetworkTest, UpdatePropensities)
    EXPECT_EQ(tree_solver.get_propensity(1), 40004);
 }
 
+TEST_F(ReactionNetworkTest, PartialPropensitySolver)
+{
+   reaction_network_.compute_reactant_groups();
+
+   // no two reactions in the test network share their reactants
+   EXPECT_EQ(int(reaction_network_.reactant_groups.number_of_groups()), 7);
+
+   std::vector<int> state = reaction_network_.initial_state;
+   PartialPropensitySolver solver(42, reaction_network_.reactant_groups, state);
+
+   auto propensity_sum = [&]()
+   {
+      double sum = 0.0;
+      for (int i = 0; i < 7; i++)
+         sum += reaction_network_.compute_propensity(state, i);
+      return sum;
+   };
+
+   EXPECT_NEAR(solver.get_propensity_sum(), propensity_sum(), 1e-9 * propensity_sum());
+
+   // at a fixed state, reactions are picked in proportion to their
+   // propensities
+   int number_of_events = 200000;
+   std::vector<int> counts(7, 0);
+   for (int i = 0; i < number_of_events; i++)
+      counts[solver.event(state).value().index]++;
+
+   for (int i = 0; i < 7; i++)
+   {
+      double p = reaction_network_.compute_propensity(state, i) / propensity_sum();
+      double sigma = std::sqrt(number_of_events * p * (1 - p));
+      EXPECT_NEAR(counts[i], number_of_events * p, 5 * sigma + 1);
+   }
+
+   // the partial propensities follow the state as reactions fire
+   for (int i = 0; i < 2000; i++)
+   {
+      std::optional<Event> maybe_event = solver.event(state);
+      ASSERT_TRUE(maybe_event.has_value());
+
+      int next_reaction = maybe_event.value().index;
+      EXPECT_GT(reaction_network_.compute_propensity(state, next_reaction), 0);
+
+      reaction_network_.update_state(state, next_reaction);
+
+      int species[4];
+      int number_of_species = reaction_network_.changed_species(next_reaction, species);
+      solver.update(state, species, number_of_species);
+
+      EXPECT_NEAR(solver.get_propensity_sum(), propensity_sum(), 1e-9 * propensity_sum());
+   }
+}
+
+TEST_F(ReactionNetworkTest, TauLeaping)
+{
+   // the test network has small populations, so it only leaps with a
+   // loose error bound
+   reaction_network_.tau_leaping_epsilon = 0.3;
+   reaction_network_.compute_highest_reactant_orders();
+
+   EXPECT_EQ(int(reaction_network_.highest_reactant_order[1]), 2);
+   EXPECT_EQ(int(reaction_network_.highest_reactant_order[3]), 3);
+   EXPECT_EQ(int(reaction_network_.highest_reactant_order[4]), 0);
+
+   HistoryQueue<HistoryPacket<ReactionNetworkLeapHistoryElement>> history_queue;
+   TauLeapingSimulation<TreeSolver> simulation(reaction_network_,
+                                               42,
+                                               0,
+                                               0.0,
+                                               reaction_network_.initial_state,
+                                               1 << 20,
+                                               history_queue);
+   simulation.init();
+   simulation.execute_steps(20000);
+
+   // replaying the recorded counts from the initial state gives the
+   // final state, and the steps count every firing
+   std::vector<int> state = reaction_network_.initial_state;
+   int firings = 0;
+   bool leaped = false;
+   for (ReactionNetworkLeapHistoryElement element : simulation.history)
+   {
+      EXPECT_EQ(element.step, firings);
+      for (int i = 0; i < element.count; i++)
+         reaction_network_.update_state(state, element.reaction_id);
+
+      firings += element.count;
+      leaped = leaped || element.count > 1;
+   }
+
+   EXPECT_TRUE(leaped);
+   EXPECT_EQ(firings, simulation.step);
+   EXPECT_EQ(state, simulation.state);
+   for (int count : simulation.state)
+      EXPECT_GE(count, 0);
+}
+
+TEST_F(ReactionNetworkTest, PhiloxResume)
+{
+   sampler_backend = philox_sampler;
+
+   HistoryQueue<HistoryPacket<ReactionNetworkTrajectoryHistoryElement>> history_queue;
+   ReactionNetworkSimulation<TreeSolver> uninterrupted(reaction_network_,
+                                                       42,
+                                                       0,
+                                                       0.0,
+                                                       reaction_network_.initial_state,
+                                                       1 << 20,
+                                                       history_queue);
+   uninterrupted.init();
+   uninterrupted.execute_steps(2000);
+
+   // stop part way, then pick up from the checkpointed step, time and
+   // state the way a run with checkpointing does
+   ReactionNetworkSimulation<TreeSolver> interrupted(reaction_network_,
+                                                     42,
+                                                     0,
+                                                     0.0,
+                                                     reaction_network_.initial_state,
+                                                     1 << 20,
+                                                     history_queue);
+   interrupted.init();
+   interrupted.execute_steps(700);
+
+   ReactionNetworkSimulation<TreeSolver> resumed(reaction_network_,
+                                                 42,
+                                                 interrupted.step,
+                                                 interrupted.time,
+                                                 interrupted.state,
+                                                 1 << 20,
+                                                 history_queue);
+   resumed.init();
+   resumed.execute_steps(2000);
+
+   sampler_backend = gsl_sampler;
+
+   std::vector<ReactionNetworkTrajectoryHistoryElement> history = interrupted.history;
+   history.insert(history.end(), resumed.history.begin(), resumed.history.end());
+
+   ASSERT_EQ(history.size(), uninterrupted.history.size());
+   ASSERT_GT(interrupted.history.size(), 0u);
+   ASSERT_GT(resumed.history.size(), 0u);
+   for (unsigned long int i = 0; i < history.size(); i++)
+   {
+      EXPECT_EQ(history[i].step, uninterrupted.history[i].step);
+      EXPECT_EQ(history[i].reaction_id, uninterrupted.history[i].reaction_id);
+      EXPECT_DOUBLE_EQ(history[i].time, uninterrupted.history[i].time);
+   }
+   EXPECT_EQ(resumed.state, uninterrupted.state);
+}
+
+TEST(SlowScaleTest, FastPairs)
+{
+   // 0 <-> 1 flips fast, 1 <-> 2 flips too slowly compared with 1 -> 3,
+   // and 2 + 0 -> 4 is slow
+   GillespieReactionNetwork reaction_network;
+   reaction_network.factor_zero = 1.0;
+   reaction_network.factor_two = 1.0;
+   reaction_network.factor_duplicate = 0.5;
+   reaction_network.initial_state = {1000, 0, 0, 0, 0};
+
+   std::vector<GillespieReaction> reactions = {
+      {1, 1, {0, -1}, {1, -1}, 100.0},
+      {1, 1, {1, -1}, {0, -1}, 50.0},
+      {1, 1, {1, -1}, {2, -1}, 0.1},
+      {1, 1, {2, -1}, {1, -1}, 0.2},
+      {1, 1, {1, -1}, {3, -1}, 0.1},
+      {2, 1, {2, 0}, {4, -1}, 1e-4}};
+
+   reaction_network.reactions.resize(reactions.size(), 5);
+   for (unsigned long int i = 0; i < reactions.size(); i++)
+      reaction_network.reactions.set(i, reactions[i]);
+
+   reaction_network.compute_dependents(5);
+   reaction_network.compute_affected(default_max_dependency_graph_bytes);
+   reaction_network.compute_fast_pairs(100.0);
+
+   FastPairs &pairs = reaction_network.fast_pairs;
+   ASSERT_EQ(int(pairs.size()), 1);
+   EXPECT_EQ(pairs.first[0], 0);
+   EXPECT_EQ(pairs.second[0], 1);
+   EXPECT_DOUBLE_EQ(pairs.first_fraction[0], 50.0 / 150.0);
+   EXPECT_EQ(pairs.pair_of_species[2], -1);
+   EXPECT_EQ(pairs.fast_reaction, std::vector<bool>({true, true, false, false, false, false}));
+
+   HistoryQueue<HistoryPacket<ReactionNetworkTrajectoryHistoryElement>> history_queue;
+   SlowScaleSimulation<TreeSolver> simulation(reaction_network,
+                                              42,
+                                              0,
+                                              0.0,
+                                              reaction_network.initial_state,
+                                              1 << 20,
+                                              history_queue);
+   simulation.init();
+   simulation.execute_steps(500);
+
+   // only slow reactions fire, and every molecule is accounted for
+   int total = 0;
+   for (int count : simulation.state)
+   {
+      EXPECT_GE(count, 0);
+      total += count;
+   }
+
+   int dimers = simulation.state[4];
+   EXPECT_EQ(total + dimers, 1000);
+
+   for (ReactionNetworkTrajectoryHistoryElement element : simulation.history)
+      EXPECT_FALSE(pairs.fast_reaction[element.reaction_id]);
+}
+
+TEST(SlowScaleTest, FastPairsDrain)
+{
+   // 0 <-> 1 flips fast, but 1 -> 2 drains 1 faster still, so the pair
+   // can't be assumed to be at equilibrium. 3 <-> 4 is fast, and 4 <-> 5
+   // is slower than it, so it loses 4 to 3 <-> 4. Its flips still stop
+   // 6 <-> 5 from being fast.
+   GillespieReactionNetwork reaction_network;
+   reaction_network.factor_zero = 1.0;
+   reaction_network.factor_two = 1.0;
+   reaction_network.factor_duplicate = 0.5;
+   reaction_network.initial_state = {100, 0, 0, 100, 0, 0, 0};
+
+   std::vector<GillespieReaction> reactions = {
+      {1, 1, {0, -1}, {1, -1}, 100.0},
+      {1, 1, {1, -1}, {0, -1}, 50.0},
+      {1, 1, {1, -1}, {2, -1}, 1000.0},
+      {1, 1, {3, -1}, {4, -1}, 1e6},
+      {1, 1, {4, -1}, {3, -1}, 1e6},
+      {1, 1, {4, -1}, {5, -1}, 1e3},
+      {1, 1, {5, -1}, {4, -1}, 1e3},
+      {1, 1, {5, -1}, {6, -1}, 10.0},
+      {1, 1, {6, -1}, {5, -1}, 10.0}};
+
+   reaction_network.reactions.resize(reactions.size(), 7);
+   for (unsigned long int i = 0; i < reactions.size(); i++)
+      reaction_network.reactions.set(i, reactions[i]);
+
+   reaction_network.compute_dependents(7);
+   reaction_network.compute_affected(default_max_dependency_graph_bytes);
+   reaction_network.compute_fast_pairs(10.0);
+
+   FastPairs &pairs = reaction_network.fast_pairs;
+   ASSERT_EQ(int(pairs.size()), 1);
+   EXPECT_EQ(pairs.first[0], 3);
+   EXPECT_EQ(pairs.second[0], 4);
+   EXPECT_EQ(pairs.pair_of_species[0], -1);
+   EXPECT_EQ(pairs.pair_of_species[1], -1);
+   EXPECT_EQ(pairs.pair_of_species[5], -1);
+   EXPECT_EQ(pairs.pair_of_species[6], -1);
+}
+
+TEST(EnergyReactionNetworkTest, UpdatePropensitiesEnergyBudget)
+{
+   SqlConnection model_database = SqlConnection("../examples/GMC/energy_budget/rn.sqlite",
+                                                SQLITE_OPEN_READWRITE);
+   SqlConnection initial_state_database = SqlConnection("../examples/GMC/energy_budget/initial_state.sqlite",
+                                                        SQLITE_OPEN_READWRITE);
+
+   EnergyReactionNetworkParameters parameters{
+       .energy_budget = 5,
+       .isCheckpoint = false};
+
+   EnergyReactionNetwork energy_reaction_network(model_database,
+                                                 initial_state_database,
+                                                 parameters);
+
+   std::vector<int> state = energy_reaction_network.initial_state.homogeneous;
+   double energy_budget = energy_reaction_network.initial_state.energy_budget;
+
+   std::vector<double> propensities;
+   energy_reaction_network.compute_initial_propensities(state, energy_budget, propensities);
+
+   // fire a run of uphill reactions which fit in the budget, applying the
+   // incremental updates. The result should always match recomputing
+   // every propensity from scratch with the lowered budget.
+   int number_of_uphill_reactions = 0;
+   for (unsigned long int reaction_index = 0;
+        reaction_index < energy_reaction_network.reactions.size() && number_of_uphill_reactions < 5;
+        reaction_index++)
+   {
+      EnergyReaction reaction = energy_reaction_network.reactions[reaction_index];
+      if (reaction.dG <= 0 || propensities[reaction_index] == 0.0)
+         continue;
+
+      number_of_uphill_reactions++;
+
+      energy_reaction_network.update_state(state, reaction_index);
+      double previous_energy_budget = energy_budget;
+      energy_reaction_network.update_energy_budget(energy_budget, reaction_index);
+
+      std::vector<Update> updates;
+      energy_reaction_network.update_propensities(updates, state, reaction_index,
+                                                  previous_energy_budget, energy_budget);
+      for (Update update : updates)
+         propensities[update.index] = update.propensity;
+
+      std::vector<double> expected_propensities;
+      energy_reaction_network.compute_initial_propensities(state, energy_budget, expected_propensities);
+
+      EXPECT_LT(energy_budget, previous_energy_budget);
+      for (unsigned long int i = 0; i < propensities.size(); i++)
+         EXPECT_EQ(propensities[i], expected_propensities[i]);
+   }
+
+   EXPECT_GT(number_of_uphill_reactions, 0);
+}
+
 // checkpoint
 // store_checkpoint
@@ -0,0 +1,159 @@
+/* ----------------------------------------------------------------------
+Unit tests for the binary trajectory files written with --output_format=binary
+All tests use googletest unit test framework
+---------------------------------------------------------------------- */
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "../core/trajectory_file.h"
+#include "../GMC/sql_types.h"
+
+TEST(TrajectoryFileTest, Varint)
+{
+    std::vector<uint64_t> values = {0, 1, 127, 128, 300, 1ul << 35, ~0ul};
+    std::vector<uint8_t> buffer;
+    for (uint64_t value : values)
+        append_varint(buffer, value);
+
+    // small values take a single byte
+    EXPECT_EQ(buffer[0], 0);
+    EXPECT_EQ(buffer[1], 1);
+    EXPECT_EQ(buffer[2], 127);
+
+    const uint8_t *position = buffer.data();
+    const uint8_t *end = buffer.data() + buffer.size();
+    for (uint64_t value : values)
+    {
+        uint64_t decoded;
+        ASSERT_TRUE(read_varint(position, end, decoded));
+        EXPECT_EQ(decoded, value);
+    }
+    EXPECT_EQ(position, end);
+
+    for (int64_t value : {0l, -1l, 1l, -1000000l, 1000000l})
+        EXPECT_EQ(zigzag_decode(zigzag_encode(value)), value);
+}
+
+TEST(TrajectoryFileTest, Times)
+{
+    // increasing times as a simulation produces them, then repeated,
+    // decreasing and extreme values which the width has to jump for
+    std::vector<double> times;
+    double time = 0.0;
+    for (int i = 0; i < 1000; i++)
+    {
+        time += -std::log((i * 7919 % 1000 + 0.5) / 1000.0) / (1.0 + i % 13);
+        times.push_back(time);
+    }
+    for (double value : {time, time, 1.0, 0.0, -2.5, 1.0e-300, 4.9e-324, 1.0e300,
+                         std::numeric_limits<double>::infinity(), 0.0})
+        times.push_back(value);
+
+    std::vector<uint8_t> buffer;
+    append_times(buffer, times);
+    buffer.push_back(0xab); // whatever follows the column
+
+    // the 52 bit mantissas of the steps above are mostly random, but
+    // their high bits are shared
+    EXPECT_LT(buffer.size(), 8 * times.size());
+
+    std::vector<double> decoded(times.size());
+    const uint8_t *position = buffer.data();
+    const uint8_t *end = buffer.data() + buffer.size();
+    ASSERT_TRUE(read_times(position, end, decoded));
+    for (unsigned long int i = 0; i < times.size(); i++)
+        EXPECT_EQ(double_bits(decoded[i]), double_bits(times[i]));
+
+    // the padding is skipped, so the next column starts at a byte
+    ASSERT_EQ(position, end - 1);
+    EXPECT_EQ(*position, 0xab);
+
+    // a truncated column is reported rather than read past its end
+    position = buffer.data();
+    EXPECT_FALSE(read_times(position, buffer.data() + buffer.size() / 2, decoded));
+}
+
+TEST(TrajectoryFileTest, RoundTrip)
+{
+    char directory_template[] = "/tmp/rnmc_trajectory_test_XXXXXX";
+    ASSERT_NE(mkdtemp(directory_template), nullptr);
+
+    TrajectoryFileWriter writer(directory_template);
+
+    // two packets, the second starting again from step 2 as a run
+    // resumed from a checkpoint would
+    std::vector<ReactionNetworkWriteTrajectoriesSql> first_rows = {
+        {.seed = 7, .step = 0, .reaction_id = 12, .time = 0.5},
+        {.seed = 7, .step = 1, .reaction_id = 3, .time = 0.75},
+        {.seed = 7, .step = 2, .reaction_id = -1, .time = 1.0e-9}};
+    std::vector<ReactionNetworkWriteTrajectoriesSql> second_rows = {
+        {.seed = 7, .step = 2, .reaction_id = 100000, .time = 2.0},
+        {.seed = 7, .step = 3, .reaction_id = 0, .time = 3.25}};
+
+    writer.write(7, first_rows);
+    writer.write(7, second_rows);
+
+    std::optional<TrajectoryFileReader> maybe_reader =
+        TrajectoryFileReader::open(writer.file_path(7));
+    ASSERT_TRUE(maybe_reader.has_value());
+
+    TrajectoryFileReader &reader = maybe_reader.value();
+    EXPECT_EQ(reader.seed, 7ul);
+    EXPECT_EQ(reader.number_of_columns, 1);
+    EXPECT_EQ(reader.column_names, "reaction_id");
+
+    std::vector<TrajectoryRecord> records;
+    for (std::vector<ReactionNetworkWriteTrajectoriesSql> *rows : {&first_rows, &second_rows})
+    {
+        ASSERT_TRUE(reader.next_block(records));
+        ASSERT_EQ(records.size(), rows->size());
+        for (unsigned long int i = 0; i < records.size(); i++)
+        {
+            EXPECT_EQ(records[i].step, (*rows)[i].step);
+            EXPECT_EQ(records[i].time, (*rows)[i].time);
+            EXPECT_EQ(records[i].columns[0], (*rows)[i].reaction_id);
+        }
+    }
+
+    EXPECT_FALSE(reader.next_block(records));
+    EXPECT_EQ(reader.position, reader.contents.size());
+
+    std::remove(writer.file_path(7).c_str());
+    rmdir(directory_template);
+}
+
+TEST(TrajectoryFileTest, CorruptRecordCount)
+{
+    char directory_template[] = "/tmp/rnmc_trajectory_test_XXXXXX";
+    ASSERT_NE(mkdtemp(directory_template), nullptr);
+
+    TrajectoryFileWriter writer(directory_template);
+    std::vector<ReactionNetworkWriteTrajectoriesSql> rows = {
+        {.seed = 3, .step = 0, .reaction_id = 1, .time = 0.5}};
+    writer.write(3, rows);
+
+    std::optional<TrajectoryFileReader> maybe_reader =
+        TrajectoryFileReader::open(writer.file_path(3));
+    ASSERT_TRUE(maybe_reader.has_value());
+    TrajectoryFileReader &reader = maybe_reader.value();
+
+    // claim far more records than the block has bytes for. The reader
+    // must give up before allocating them.
+    std::vector<uint8_t> block;
+    append_varint(block, 1ul << 40);
+    append_varint(block, 3);
+    block.insert(block.end(), {0, 0, 0});
+    reader.contents.resize(reader.position);
+    reader.contents.insert(reader.contents.end(), block.begin(), block.end());
+
+    std::vector<TrajectoryRecord> records;
+    EXPECT_FALSE(reader.next_block(records));
+    EXPECT_TRUE(records.empty());
+
+    std::remove(writer.file_path(3).c_str());
+    rmdir(directory_template);
+}
@@ -0,0 +1,137 @@
+/* ----------------------------------------------------------------------
+RNMC - Reaction Network Monte Carlo
+https://blaugroup.github.io/RNMC/
+
+See the README file in the top-level RNMC directory.
+---------------------------------------------------------------------- */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <dirent.h>
+
+#include "../core/trajectory_file.h"
+
+// prints binary trajectory files written with --output_format=binary as
+// seed|step|time|column... lines, one per record, in the same format as
+// sqlite3 prints a query. The column names are printed as a header.
+// Records repeated by a run resumed from a checkpoint are printed once.
+//
+// usage: read_trajectories <trajectory file or directory>...
+
+void print_usage()
+{
+    std::cout << "Usage: read_trajectories <trajectory file or directory>...\n"
+              << "directories are searched for <seed>.trajectory files\n";
+} // print_usage()
+
+/* ---------------------------------------------------------------------- */
+
+// the trajectory files of a directory, ordered by seed
+std::vector<std::string> trajectory_files(std::string directory)
+{
+    std::vector<std::pair<unsigned long int, std::string>> files;
+    std::string suffix = ".trajectory";
+
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+        return {};
+
+    while (struct dirent *entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if (name.size() <= suffix.size() ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+            continue;
+
+        files.push_back({std::strtoul(name.c_str(), nullptr, 10),
+                         directory + "/" + name});
+    }
+    closedir(dir);
+
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::string> paths;
+    for (auto &file : files)
+        paths.push_back(file.second);
+
+    return paths;
+} // trajectory_files()
+
+/* ---------------------------------------------------------------------- */
+
+bool print_trajectory_file(std::string path, bool print_header)
+{
+    std::optional<TrajectoryFileReader> maybe_reader = TrajectoryFileReader::open(path);
+    if (!maybe_reader)
+    {
+        std::cerr << "could not read trajectory file " << path << '\n';
+        return false;
+    }
+
+    TrajectoryFileReader &reader = maybe_reader.value();
+
+    if (print_header)
+    {
+        std::string header = "seed,step,time," + reader.column_names;
+        std::replace(header.begin(), header.end(), ',', '|');
+        printf("%s\n", header.c_str());
+    }
+
+    std::vector<TrajectoryRecord> records;
+    std::unordered_set<int> steps;
+
+    while (reader.next_block(records))
+    {
+        for (TrajectoryRecord &record : records)
+        {
+            // keep the first record of each step, like the duplicate
+            // removal done on the trajectories table
+            if (!steps.insert(record.step).second)
+                continue;
+
+            printf("%lu|%d|%.17g", reader.seed, record.step, record.time);
+            for (int c = 0; c < reader.number_of_columns; c++)
+                printf("|%d", record.columns[c]);
+            printf("\n");
+        }
+    }
+
+    if (reader.position != reader.contents.size())
+        std::cerr << "trajectory file " << path << " ends with a truncated block\n";
+
+    return true;
+} // print_trajectory_file()
+
+/* ---------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        struct stat path_stat;
+        if (stat(argv[i], &path_stat) == 0 && S_ISDIR(path_stat.st_mode))
+        {
+            std::vector<std::string> directory_paths = trajectory_files(argv[i]);
+            paths.insert(paths.end(), directory_paths.begin(), directory_paths.end());
+        }
+        else
+            paths.push_back(argv[i]);
+    }
+
+    bool success = true;
+    for (unsigned long int i = 0; i < paths.size(); i++)
+        success = print_trajectory_file(paths[i], i == 0) && success;
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+} // main()